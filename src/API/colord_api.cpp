@@ -342,8 +342,8 @@ namespace colord
             info.qualityReverseThresholds = decompression_module.GetQualityRevThresholds();
         }
     public:
-        DecompressionStreamImpl(const std::string& inputFilePath, const std::string& refGenomePath) :
-            decompression_module(inputFilePath, refGenomePath, null_logger, false, exception_error_handler, consumer, true)
+        DecompressionStreamImpl(const std::string& inputFilePath, const std::string& refGenomePath, const CReadsRange& range = CReadsRange()) :
+            decompression_module(inputFilePath, refGenomePath, null_logger, false, exception_error_handler, consumer, true, range, std::max(std::thread::hardware_concurrency(), 1u))
         {
             decompression_module.Run();
             
@@ -376,6 +376,12 @@ namespace colord
         pImpl(std::make_unique<DecompressionStreamImpl>(inputFilePath, refGenomePath))
     {
 
+    }
+    DecompressionStream::DecompressionStream(const std::string& inputFilePath, const std::string& refGenomePath, uint64_t firstRead, uint64_t lastRead)
+        :
+        pImpl(std::make_unique<DecompressionStreamImpl>(inputFilePath, refGenomePath, CReadsRange{ firstRead ? firstRead - 1 : 0, lastRead }))
+    {
+
     }
     DecompressionStream::~DecompressionStream() = default;
 
@@ -96,6 +96,8 @@ namespace colord
     public:
         explicit DecompressionStream(const std::string& inputFilePath);
         explicit DecompressionStream(const std::string& inputFilePath, const std::string& refGenomePath);
+        // Decompresses only reads firstRead..lastRead (1-based, inclusive), decoding starts from the nearest restart point stored in the archive index
+        explicit DecompressionStream(const std::string& inputFilePath, const std::string& refGenomePath, uint64_t firstRead, uint64_t lastRead);
         Info GetInfo() const;
         DecompressionRecord NextRecord();
         ~DecompressionStream();
@@ -19,11 +19,22 @@
 #include "archive.h"
 
 #include <iostream>
+#include <cstring>
 
 #ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #define my_fseek	fseek
 #define my_ftell	ftell
 #else
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
 #define my_fseek	_fseeki64
 #define my_ftell	_ftelli64
 #endif
@@ -33,12 +44,19 @@ CArchive::CArchive(bool _input_mode)
 {
 	f = nullptr;
 	input_mode = _input_mode;
+	is_stdout = false;
+	mapped_data = nullptr;
+	mapped_size = 0;
+#ifdef _WIN32
+	h_file = nullptr;
+	h_mapping = nullptr;
+#endif
 }
 
 // ******************************************************************************
 CArchive::~CArchive()
 {
-	if (f)
+	if (f || mapped_data)
 		Close();
 }
 
@@ -47,18 +65,46 @@ bool CArchive::Open(string file_name)
 {
 	lock_guard<mutex> lck(mtx);
 
-	if (f)
+	if (f && !is_stdout)
 		fclose(f);
+	f = nullptr;
+	is_stdout = false;
+	unmap_file();
+
+	if (input_mode && map_file(file_name))
+	{
+		if (!deserialize())
+		{
+			unmap_file();
+			return false;
+		}
+
+		return true;
+	}
 
-	f = fopen(file_name.c_str(), input_mode ? "rb" : "wb");
+	// Parts and the footer are only appended, so the archive may be written to a pipe
+	if (!input_mode && file_name == "-")
+	{
+#ifdef _WIN32
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		f = stdout;
+		is_stdout = true;
+	}
+	else
+		f = fopen(file_name.c_str(), input_mode ? "rb" : "wb");
 
 	if (!f)
 		return false;
 
 	setvbuf(f, nullptr, _IOFBF, 64 << 20);
 
-	if (input_mode)
-		deserialize();
+	if (input_mode && !deserialize())
+	{
+		fclose(f);
+		f = nullptr;
+		return false;
+	}
 
 	f_offset = 0;
 
@@ -70,6 +116,12 @@ bool CArchive::Close()
 {
 	lock_guard<mutex> lck(mtx);
 
+	if (mapped_data)
+	{
+		unmap_file();
+		return true;
+	}
+
 	if (!f)
 		return false;
 
@@ -81,8 +133,14 @@ bool CArchive::Close()
 	else
 	{
 		serialize();
-		fclose(f);
+		bool ok = fflush(f) == 0 && !ferror(f);
+		if (is_stdout)
+			is_stdout = false;
+		else
+			ok &= fclose(f) == 0;
 		f = nullptr;
+
+		return ok;
 	}
 
 	return true;
@@ -122,12 +180,83 @@ size_t CArchive::write(string s)
 }
 
 // ******************************************************************************
-size_t CArchive::read_fixed(size_t& x)
+// Maps the whole file to memory (read only), returns false if it is not possible (e.g. the input is not a regular file)
+bool CArchive::map_file(const string& file_name)
 {
-	if (fread(&x, 8, 1, f))
-		return 8;
-	
-	return 0;
+#ifndef _WIN32
+	int fd = open(file_name.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	void* ptr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (ptr == MAP_FAILED)
+		return false;
+
+	mapped_data = static_cast<const uint8_t*>(ptr);
+	mapped_size = static_cast<size_t>(st.st_size);
+#else
+	HANDLE hf = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (hf == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(hf, &file_size) || file_size.QuadPart == 0)
+	{
+		CloseHandle(hf);
+		return false;
+	}
+
+	HANDLE hm = CreateFileMappingA(hf, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!hm)
+	{
+		CloseHandle(hf);
+		return false;
+	}
+
+	void* ptr = MapViewOfFile(hm, FILE_MAP_READ, 0, 0, 0);
+	if (!ptr)
+	{
+		CloseHandle(hm);
+		CloseHandle(hf);
+		return false;
+	}
+
+	h_file = hf;
+	h_mapping = hm;
+	mapped_data = static_cast<const uint8_t*>(ptr);
+	mapped_size = static_cast<size_t>(file_size.QuadPart);
+#endif
+
+	return true;
+}
+
+// ******************************************************************************
+void CArchive::unmap_file()
+{
+	if (!mapped_data)
+		return;
+
+#ifndef _WIN32
+	munmap(const_cast<uint8_t*>(mapped_data), mapped_size);
+#else
+	UnmapViewOfFile(mapped_data);
+	CloseHandle(h_mapping);
+	CloseHandle(h_file);
+	h_mapping = nullptr;
+	h_file = nullptr;
+#endif
+
+	mapped_data = nullptr;
+	mapped_size = 0;
 }
 
 // ******************************************************************************
@@ -147,23 +276,37 @@ size_t CArchive::read(size_t& x)
 }
 
 // ******************************************************************************
-size_t CArchive::read(string& s)
+size_t CArchive::read(const uint8_t*& ptr, const uint8_t* end, size_t& x)
 {
-	s.clear();
+	if (ptr >= end || *ptr > sizeof(size_t) || end - ptr <= *ptr)
+		return 0;
 
-	while (true)
-	{
-		int c = getc(f);
-		if (c == EOF)
-			return 0;
+	int no_bytes = *ptr++;
 
-		if (c == 0)
-			return s.size() + 1;
+	x = 0;
 
-		s.push_back((char)c);
+	for (int i = 0; i < no_bytes; ++i)
+	{
+		x <<= 8;
+		x += (size_t)*ptr++;
 	}
 
-	return 0;
+	return no_bytes + 1;
+}
+
+// ******************************************************************************
+size_t CArchive::read(const uint8_t*& ptr, const uint8_t* end, string& s)
+{
+	if (ptr >= end)
+		return 0;
+	auto terminator = static_cast<const uint8_t*>(memchr(ptr, 0, end - ptr));
+	if (!terminator)
+		return 0;
+	auto len = terminator - ptr;
+	s.assign(reinterpret_cast<const char*>(ptr), len);
+	ptr += len + 1;
+
+	return len + 1;
 }
 
 // ******************************************************************************
@@ -198,39 +341,77 @@ bool CArchive::serialize()
 }
 
 // ******************************************************************************
+// The footer is parsed from memory: directly from the mapping or after reading it at once from the file
 bool CArchive::deserialize()
 {
+	size_t file_size;
 	size_t footer_size;
+	const uint8_t* ptr;
+	vector<uint8_t> v_footer;
+
+	if (mapped_data)
+	{
+		file_size = mapped_size;
+		if (file_size < 8)
+			return false;
+		memcpy(&footer_size, mapped_data + file_size - 8, 8);
+		if (footer_size > file_size - 8)
+			return false;
+
+		ptr = mapped_data + file_size - 8 - footer_size;
+	}
+	else
+	{
+		my_fseek(f, 0, SEEK_END);
+		file_size = my_ftell(f);
+		if (file_size < 8)
+			return false;
+
+		my_fseek(f, file_size - 8, SEEK_SET);
+		if (fread(&footer_size, 8, 1, f) != 1 || footer_size > file_size - 8)
+			return false;
 
-	my_fseek(f, -8, SEEK_END);
-	read_fixed(footer_size);
+		v_footer.resize(footer_size);
+		my_fseek(f, file_size - 8 - footer_size, SEEK_SET);
+		if (fread(v_footer.data(), 1, footer_size, f) != footer_size)
+			return false;
 
-	my_fseek(f, -(long)(8 + footer_size), SEEK_END);
+		ptr = v_footer.data();
+	}
+
+	// every read is bounded by the end of the footer and the parts must lie before the footer, so a corrupted archive is refused
+	const uint8_t* end = ptr + footer_size;
+	size_t data_size = file_size - 8 - footer_size;
 
 	// Odczytuje informacje o po�o�eniu kawa�k�w strumieni
 	size_t n_streams;
-	read(n_streams);
+	if (!read(ptr, end, n_streams))
+		return false;
 
 	for (size_t i = 0; i < n_streams; ++i)
 	{
 		m_streams[i] = stream_t();
 		auto& stream_second = m_streams[i];
 
-		read(stream_second.stream_name);
-		read(stream_second.cur_id);
-		read(stream_second.raw_size);
+		if (!read(ptr, end, stream_second.stream_name) || !read(ptr, end, stream_second.cur_id) || !read(ptr, end, stream_second.raw_size))
+			return false;
 
+		//each part takes at least 2 bytes of the footer
+		if (stream_second.cur_id > static_cast<size_t>(end - ptr) / 2)
+			return false;
 		stream_second.parts.resize(stream_second.cur_id);
 		for (size_t j = 0; j < stream_second.cur_id; ++j)
 		{
-			read(stream_second.parts[j].offset);
-			read(stream_second.parts[j].size);
+			auto& part = stream_second.parts[j];
+			if (!read(ptr, end, part.offset) || !read(ptr, end, part.size) || part.offset > data_size || part.size > data_size - part.offset)
+				return false;
 		}
 
 		stream_second.cur_id = 0;
 	}
 	
-	my_fseek(f, 0, SEEK_SET);
+	if (!mapped_data)
+		my_fseek(f, 0, SEEK_SET);
 
 	return true;
 }
@@ -327,36 +508,141 @@ size_t CArchive::GetRawSize(int stream_id)
 }
 
 // ******************************************************************************
-bool CArchive::GetPart(int stream_id, vector<uint8_t> &v_data, size_t &metadata)
+// Reads the part (must be called under the mutex if the archive is not memory-mapped)
+bool CArchive::get_part(const part_t& part, CArchivePart& v_part, size_t& metadata)
 {
-	lock_guard<mutex> lck(mtx);
-	
+	if (part.size == 0)
+	{
+		metadata = 0;
+		v_part.data = nullptr;
+		v_part.size = 0;
+		return true;
+	}
+
+	if (mapped_data)
+	{
+		if (part.offset >= mapped_size)
+			return false;
+
+		const uint8_t* ptr = mapped_data + part.offset;
+		if (!read(ptr, mapped_data + mapped_size, metadata))
+			return false;
+
+		if (ptr + part.size > mapped_data + mapped_size)
+			return false;
+
+		v_part.data = ptr;
+		v_part.size = part.size;
+
+		return true;
+	}
+
+	v_part.buffer.resize(part.size);
+
+	my_fseek(f, part.offset, SEEK_SET);
+	read(metadata);
+
+	auto r = fread(v_part.buffer.data(), 1, part.size, f);
+
+	v_part.data = v_part.buffer.data();
+	v_part.size = v_part.buffer.size();
+
+	return r == part.size;
+}
+
+// ******************************************************************************
+bool CArchive::GetPart(int stream_id, CArchivePart& part, size_t& metadata)
+{
+	unique_lock<mutex> lck(mtx);
+
 	auto& p = m_streams[stream_id];
 
 	if (p.cur_id >= p.parts.size())
 		return false;
 
-	v_data.resize(p.parts[p.cur_id].size);
+	auto& desc = p.parts[p.cur_id++];
+
+	// Mapped archive is read-only, so the lock is needed only to get the current part
+	if (mapped_data)
+		lck.unlock();
+
+	return get_part(desc, part, metadata);
+}
+
+// ******************************************************************************
+// Random access to the part, does not change the current part of the stream
+bool CArchive::GetPart(int stream_id, size_t part_id, CArchivePart& part, size_t& metadata)
+{
+	unique_lock<mutex> lck(mtx);
+
+	auto& p = m_streams[stream_id];
+
+	if (part_id >= p.parts.size())
+		return false;
+
+	if (mapped_data)
+		lck.unlock();
+
+	return get_part(p.parts[part_id], part, metadata);
+}
+
+// ******************************************************************************
+bool CArchive::GetPart(int stream_id, vector<uint8_t> &v_data, size_t &metadata)
+{
+	CArchivePart part;
 
-	my_fseek(f, p.parts[p.cur_id].offset, SEEK_SET);
+	if (!GetPart(stream_id, part, metadata))
+		return false;
 
-	if(p.parts[p.cur_id].size != 0)
-		read(metadata);
+	if (part.data == part.buffer.data())
+		v_data = move(part.buffer);
 	else
-	{
-		metadata = 0;
-		p.cur_id++;
-		return true;
-	}
+		v_data.assign(part.data, part.data + part.size);
 
-	auto r = fread(v_data.data(), 1, p.parts[p.cur_id].size, f);
+	return true;
+}
 
-	p.cur_id++;
+// ******************************************************************************
+// Random access to the part, does not change the current part of the stream
+bool CArchive::GetPart(int stream_id, size_t part_id, vector<uint8_t> &v_data, size_t &metadata)
+{
+	CArchivePart part;
 
-	if (r != p.parts[p.cur_id-1].size)
+	if (!GetPart(stream_id, part_id, part, metadata))
 		return false;
 
-	return r == p.parts[p.cur_id-1].size;
+	if (part.data == part.buffer.data())
+		v_data = move(part.buffer);
+	else
+		v_data.assign(part.data, part.data + part.size);
+
+	return true;
+}
+
+// ******************************************************************************
+bool CArchive::SetCurrentPart(int stream_id, size_t part_id)
+{
+	lock_guard<mutex> lck(mtx);
+
+	auto& p = m_streams[stream_id];
+
+	if (part_id > p.parts.size())
+		return false;
+
+	p.cur_id = part_id;
+
+	return true;
+}
+
+// ******************************************************************************
+size_t CArchive::GetNoParts(int stream_id)
+{
+	lock_guard<mutex> lck(mtx);
+
+	if (stream_id < 0 || stream_id >= static_cast<int>(m_streams.size()))
+		return 0;
+
+	return m_streams[stream_id].parts.size();
 }
 
 // EOF
@@ -28,11 +28,29 @@
 
 using namespace std;
 
+// Part read from the archive. If the archive is memory-mapped it points directly into the mapping (valid until the archive is closed),
+// otherwise the data are copied to the buffer
+struct CArchivePart
+{
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	vector<uint8_t> buffer;
+};
+
 class CArchive
 {
 	bool input_mode;
 	FILE* f;
 	size_t f_offset;
+	bool is_stdout;		// output archive written to standard output ("-"), it is never seeked
+
+	// Input file mapped to memory, if mapping is not possible the file is read with stdio
+	const uint8_t* mapped_data;
+	size_t mapped_size;
+#ifdef _WIN32
+	void* h_file;
+	void* h_mapping;
+#endif
 
 	struct part_t{
 		size_t offset;
@@ -59,17 +77,22 @@ class CArchive
 
 	bool serialize();
 	bool deserialize();
+	bool map_file(const string& file_name);
+	void unmap_file();
 	size_t write_fixed(size_t x);
 	size_t write(size_t x);
 	size_t write(string s);
-	size_t read_fixed(size_t& x);
 	size_t read(size_t& x);
-	size_t read(string& s);
+	// Readers of data in memory, they do not go beyond end and return 0 if the data are truncated
+	static size_t read(const uint8_t*& ptr, const uint8_t* end, size_t& x);
+	static size_t read(const uint8_t*& ptr, const uint8_t* end, string& s);
+	bool get_part(const part_t& part, CArchivePart& v_part, size_t& metadata);
 
 public:
 	CArchive(bool _input_mode);
 	~CArchive();
 
+	// In output mode file_name "-" means standard output
 	bool Open(string file_name);
 	bool Close();
 
@@ -101,6 +124,16 @@ public:
 	bool AddPartComplete(int stream_id, int part_id, vector<uint8_t>& v_data, size_t metadata = 0);
 
 	bool GetPart(int stream_id, vector<uint8_t> &v_data, size_t &metadata);
+	bool GetPart(int stream_id, size_t part_id, vector<uint8_t> &v_data, size_t &metadata);
+	bool GetPart(int stream_id, CArchivePart& part, size_t& metadata);
+	bool GetPart(int stream_id, size_t part_id, CArchivePart& part, size_t& metadata);
+
+	bool IsMapped() const
+	{
+		return mapped_data != nullptr;
+	}
+	bool SetCurrentPart(int stream_id, size_t part_id);
+	size_t GetNoParts(int stream_id);
 	void SetRawSize(int stream_id, size_t raw_size);
 	size_t GetRawSize(int stream_id);
 
@@ -0,0 +1,242 @@
+/*******************************************************************************
+ 
+ CoLoRd 
+ Copyright (C) 2021, M. Kokot, S. Deorowicz, and A. Gudys
+ https://github.com/refresh-bio/CoLoRd
+
+ This program is free software: you can redistribute it and/or modify it under 
+ the terms of the GNU General Public License as published by the Free Software 
+ Foundation; either version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY 
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR 
+ A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along with this 
+ program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#include "archive_index.h"
+#include "utils.h"
+
+#include <algorithm>
+
+// ******************************************************************************
+void CArchiveIndex::AddPart(const std::string& stream_name, uint64_t n_reads, uint64_t n_symbols, bool restart)
+{
+	std::lock_guard<std::mutex> lck(mtx);
+
+	auto& parts = m_streams[stream_name];
+	uint64_t first_read = parts.empty() ? 0 : parts.back().first_read + parts.back().n_reads;
+
+	parts.push_back(part_desc_t{ first_read, n_reads, n_symbols, restart });
+}
+
+// ******************************************************************************
+void CArchiveIndex::Store(CArchive& archive) const
+{
+	std::lock_guard<std::mutex> lck(mtx);
+
+	std::vector<uint8_t> v_data;
+
+	StoreLittleEndian(v_data, static_cast<uint32_t>(m_streams.size()));
+	for (const auto& [stream_name, parts] : m_streams)
+	{
+		for (auto c : stream_name)
+			v_data.push_back(static_cast<uint8_t>(c));
+		v_data.push_back(0);
+
+		StoreLittleEndian(v_data, static_cast<uint64_t>(parts.size()));
+		for (const auto& part : parts)
+		{
+			StoreLittleEndian(v_data, part.n_reads);
+			StoreLittleEndian(v_data, part.n_symbols);
+			v_data.push_back(static_cast<uint8_t>(part.restart));
+		}
+	}
+
+	int s_index = archive.RegisterStream("index");
+	archive.AddPart(s_index, v_data, 0);
+}
+
+// ******************************************************************************
+bool CArchiveIndex::Load(CArchive& archive)
+{
+	std::lock_guard<std::mutex> lck(mtx);
+
+	int s_index = archive.GetStreamId("index");
+	if (s_index == -1)
+		return false;
+
+	std::vector<uint8_t> v_data;
+	size_t meta;
+	if (!archive.GetPart(s_index, v_data, meta))
+		return false;
+
+	//the index is validated against its size and the parts of the archive, so a corrupted index is reported instead of being used
+	auto fail = [this] {
+		m_streams.clear();
+		corrupted = true;
+		return false;
+	};
+
+	const uint8_t* ptr = v_data.data();
+	const uint8_t* end = ptr + v_data.size();
+	const size_t part_desc_size = 2 * sizeof(uint64_t) + 1;
+
+	uint32_t n_streams;
+	if (end - ptr < static_cast<ptrdiff_t>(sizeof(n_streams)))
+		return fail();
+	LoadLittleEndian(ptr, n_streams);
+	ptr += sizeof(n_streams);
+
+	for (uint32_t i = 0; i < n_streams; ++i)
+	{
+		auto name_end = std::find(ptr, end, 0);
+		if (name_end == end)
+			return fail();
+		std::string stream_name(ptr, name_end);
+		ptr = name_end + 1;
+
+		uint64_t n_parts;
+		if (end - ptr < static_cast<ptrdiff_t>(sizeof(n_parts)))
+			return fail();
+		LoadLittleEndian(ptr, n_parts);
+		ptr += sizeof(n_parts);
+
+		if (n_parts > static_cast<uint64_t>(end - ptr) / part_desc_size || m_streams.count(stream_name))
+			return fail();
+
+		//each part of the index describes one part of the stream
+		int stream_id = archive.GetStreamId(stream_name);
+		if (stream_id != -1 && n_parts != archive.GetNoParts(stream_id))
+			return fail();
+
+		auto& parts = m_streams[stream_name];
+		parts.resize(n_parts);
+
+		uint64_t first_read = 0;
+		for (auto& part : parts)
+		{
+			part.first_read = first_read;
+			LoadLittleEndian(ptr, part.n_reads);
+			ptr += sizeof(part.n_reads);
+			LoadLittleEndian(ptr, part.n_symbols);
+			ptr += sizeof(part.n_symbols);
+			part.restart = *ptr++ != 0;
+
+			if (part.n_reads > UINT64_MAX - first_read)
+				return fail();
+			first_read += part.n_reads;
+		}
+	}
+
+	loaded = true;
+
+	return true;
+}
+
+// ******************************************************************************
+const std::vector<CArchiveIndex::part_desc_t>* CArchiveIndex::GetParts(const std::string& stream_name) const
+{
+	std::lock_guard<std::mutex> lck(mtx);
+
+	auto p = m_streams.find(stream_name);
+	if (p == m_streams.end())
+		return nullptr;
+
+	return &p->second;
+}
+
+// ******************************************************************************
+size_t CArchiveIndex::FindPart(const std::string& stream_name, uint64_t read_id) const
+{
+	auto parts = GetParts(stream_name);
+	if (!parts)
+		return 0;
+
+	auto p = std::upper_bound(parts->begin(), parts->end(), read_id, [](uint64_t read_id, const part_desc_t& part) {
+		return read_id < part.first_read + part.n_reads;
+	});
+
+	return static_cast<size_t>(p - parts->begin());
+}
+
+// ******************************************************************************
+size_t CArchiveIndex::FindRestartPart(const std::string& stream_name, uint64_t read_id) const
+{
+	auto parts = GetParts(stream_name);
+	if (!parts)
+		return 0;
+
+	size_t part_id = std::min(FindPart(stream_name, read_id), parts->size());
+
+	while (part_id > 0 && (part_id == parts->size() || !(*parts)[part_id].restart))
+		--part_id;
+
+	return part_id;
+}
+
+// ******************************************************************************
+uint64_t CArchiveIndex::GetFirstRead(const std::string& stream_name, size_t part_id) const
+{
+	auto parts = GetParts(stream_name);
+	if (!parts || part_id >= parts->size())
+		return 0;
+
+	return (*parts)[part_id].first_read;
+}
+
+// ******************************************************************************
+size_t CArchiveIndex::GetMaxBlockParts(const std::string& stream_name) const
+{
+	auto parts = GetParts(stream_name);
+	if (!parts)
+		return 0;
+
+	size_t max_block_parts = 0;
+	size_t block_parts = 0;
+	for (const auto& part : *parts)
+	{
+		if (part.restart)
+			block_parts = 0;
+		max_block_parts = std::max(max_block_parts, ++block_parts);
+	}
+
+	return max_block_parts;
+}
+
+// ******************************************************************************
+// Parses range given as FROM-TO (1-based, inclusive)
+bool parseReadsRange(const std::string& str, CReadsRange& range)
+{
+	auto dash = str.find('-');
+	if (dash == std::string::npos || dash == 0 || dash + 1 == str.size())
+		return false;
+
+	try
+	{
+		size_t pos;
+		uint64_t from = std::stoull(str.substr(0, dash), &pos);
+		if (pos != dash)
+			return false;
+
+		uint64_t to = std::stoull(str.substr(dash + 1), &pos);
+		if (pos != str.size() - dash - 1)
+			return false;
+
+		if (from == 0 || to < from)
+			return false;
+
+		range.from = from - 1;
+		range.to = to;
+	}
+	catch (...)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+// EOF
@@ -0,0 +1,116 @@
+/*******************************************************************************
+ 
+ CoLoRd 
+ Copyright (C) 2021, M. Kokot, S. Deorowicz, and A. Gudys
+ https://github.com/refresh-bio/CoLoRd
+
+ This program is free software: you can redistribute it and/or modify it under 
+ the terms of the GNU General Public License as published by the Free Software 
+ Foundation; either version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY 
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR 
+ A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along with this 
+ program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#pragma once
+
+#include "archive.h"
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Per-part index of the dna, qual and header streams.
+// For each part it keeps the ordinal of its first read, the number of reads and symbols (bases for dna and qual, header characters for header)
+// and whether decoding of the stream can be started at this part (restart point).
+// The index is stored in the archive as a separate stream, so archives without it are still readable (and vice versa).
+class CArchiveIndex
+{
+public:
+	struct part_desc_t
+	{
+		uint64_t first_read;
+		uint64_t n_reads;
+		uint64_t n_symbols;
+		bool restart;
+	};
+
+private:
+	std::map<std::string, std::vector<part_desc_t>> m_streams;
+	mutable std::mutex mtx;
+	bool loaded = false;
+	bool corrupted = false;
+
+public:
+	void AddPart(const std::string& stream_name, uint64_t n_reads, uint64_t n_symbols, bool restart);
+
+	void Store(CArchive& archive) const;
+
+	// False if the archive has no index or the index is corrupted (see IsCorrupted)
+	bool Load(CArchive& archive);
+
+	bool IsLoaded() const
+	{
+		return loaded;
+	}
+
+	bool IsCorrupted() const
+	{
+		return corrupted;
+	}
+
+	const std::vector<part_desc_t>* GetParts(const std::string& stream_name) const;
+
+	// Id of the part containing read_id, number of parts if read_id is beyond the stream
+	size_t FindPart(const std::string& stream_name, uint64_t read_id) const;
+
+	// Id of the last restart point not after the part containing read_id
+	size_t FindRestartPart(const std::string& stream_name, uint64_t read_id) const;
+
+	// Ordinal of the first read in the part, 0 if there is no such part
+	uint64_t GetFirstRead(const std::string& stream_name, size_t part_id) const;
+
+	// Maximal number of parts between consecutive restart points
+	size_t GetMaxBlockParts(const std::string& stream_name) const;
+};
+
+// Range of reads [from, to) to be decompressed, numbered from 0
+struct CReadsRange
+{
+	uint64_t from = 0;
+	uint64_t to = UINT64_MAX;
+
+	bool IsFull() const
+	{
+		return from == 0 && to == UINT64_MAX;
+	}
+
+	// Removes from the pack (which starts at read first_read) the reads outside the range
+	template<typename T>
+	void Trim(std::vector<T>& pack, uint64_t first_read) const
+	{
+		uint64_t pack_end = first_read + pack.size();
+
+		if (pack_end <= from || first_read >= to)
+		{
+			pack.clear();
+			return;
+		}
+
+		if (pack_end > to)
+			pack.resize(to - first_read);
+
+		if (first_read < from)
+			pack.erase(pack.begin(), pack.begin() + (from - first_read));
+	}
+};
+
+bool parseReadsRange(const std::string& str, CReadsRange& range);
+
+// EOF
@@ -0,0 +1,210 @@
+/*******************************************************************************
+ 
+ CoLoRd 
+ Copyright (C) 2021, M. Kokot, S. Deorowicz, and A. Gudys
+ https://github.com/refresh-bio/CoLoRd
+
+ This program is free software: you can redistribute it and/or modify it under 
+ the terms of the GNU General Public License as published by the Free Software 
+ Foundation; either version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY 
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR 
+ A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along with this 
+ program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <new>
+#include <algorithm>
+
+// Monotonic memory arena for temporaries of a single encoder thread (hash tables, Bloom filters).
+// Allocations only move a pointer forward and deallocations are no-ops, the memory is given back at once by Rewind or Reset.
+// The chunks are kept between reads, so after the first few reads there are no allocations and no fresh pages to touch.
+// The kept chunk is shrunk when the usage stays well below it for a number of reads, so a single long read does not pin its memory.
+class CArena
+{
+	static constexpr size_t chunk_align = 64; // cache line, so the alignment of the usual requests costs no padding
+
+	struct chunk_deleter_t
+	{
+		void operator()(uint8_t* p) const
+		{
+			::operator delete(p, std::align_val_t(chunk_align));
+		}
+	};
+
+	struct chunk_t
+	{
+		std::unique_ptr<uint8_t, chunk_deleter_t> data;
+		size_t size;
+
+		explicit chunk_t(size_t size) :
+			data(static_cast<uint8_t*>(::operator new(size, std::align_val_t(chunk_align)))),
+			size(size)
+		{
+		}
+	};
+
+	static constexpr size_t min_chunk_size = 1ull << 20;
+	static constexpr uint32_t shrink_check_resets = 64;
+
+	std::vector<chunk_t> chunks;
+	size_t cur_chunk{};
+	size_t cur_pos{};
+	size_t used{};			//total size of chunks up to the current one (excluding it) plus the position in it
+	size_t peak_used{};		//since the last Reset
+	size_t window_peak_used{};	//since the last shrink check
+	uint32_t n_resets{};
+
+public:
+	struct mark_t
+	{
+		size_t chunk;
+		size_t pos;
+		size_t used;
+	};
+
+	CArena() = default;
+	CArena(const CArena&) = delete;
+	CArena& operator=(const CArena&) = delete;
+
+	void* Allocate(size_t n_bytes, size_t align)
+	{
+		while (cur_chunk < chunks.size())
+		{
+			//the address (not only the offset) is aligned, so alignments above chunk_align are also kept
+			uintptr_t base = reinterpret_cast<uintptr_t>(chunks[cur_chunk].data.get());
+			size_t pos = ((base + cur_pos + align - 1) & ~static_cast<uintptr_t>(align - 1)) - base;
+			if (pos + n_bytes <= chunks[cur_chunk].size)
+			{
+				used += pos + n_bytes - cur_pos;
+				cur_pos = pos + n_bytes;
+				if (used > peak_used)
+					peak_used = used;
+				return chunks[cur_chunk].data.get() + pos;
+			}
+			//the rest of the chunk is skipped until the memory is given back
+			used += chunks[cur_chunk].size - cur_pos;
+			++cur_chunk;
+			cur_pos = 0;
+		}
+
+		size_t size = chunks.empty() ? min_chunk_size : 2 * chunks.back().size;
+		if (size < n_bytes + align)
+			size = n_bytes + align;
+		chunks.emplace_back(size);
+		cur_chunk = chunks.size() - 1;
+		cur_pos = 0;
+		return Allocate(n_bytes, align);
+	}
+
+	mark_t Mark() const
+	{
+		return mark_t{ cur_chunk, cur_pos, used };
+	}
+
+	void Rewind(const mark_t& mark)
+	{
+		cur_chunk = mark.chunk;
+		cur_pos = mark.pos;
+		used = mark.used;
+	}
+
+	// Gives back all the memory, if more than a single chunk was needed they are replaced by one chunk large enough for the peak usage.
+	// Every shrink_check_resets calls the chunk is shrunk to the peak usage of these calls if it is more than twice as large.
+	void Reset()
+	{
+		window_peak_used = std::max(window_peak_used, peak_used);
+		size_t new_size = 0;
+		if (chunks.size() > 1)
+			new_size = window_peak_used;
+		else if (++n_resets == shrink_check_resets)
+		{
+			if (!chunks.empty() && chunks.front().size > 2 * std::max(window_peak_used, min_chunk_size))
+				new_size = std::max(window_peak_used, min_chunk_size);
+			n_resets = 0;
+			window_peak_used = 0;
+		}
+
+		if (new_size)
+		{
+			chunks.clear();
+			chunks.emplace_back(new_size);
+		}
+		cur_chunk = 0;
+		cur_pos = 0;
+		used = 0;
+		peak_used = 0;
+	}
+};
+
+// Gives back the memory allocated in the arena since the construction
+class CArenaScope
+{
+	CArena& arena;
+	CArena::mark_t mark;
+public:
+	explicit CArenaScope(CArena& arena) : arena(arena), mark(arena.Mark())
+	{
+	}
+	CArenaScope(const CArenaScope&) = delete;
+	CArenaScope& operator=(const CArenaScope&) = delete;
+	~CArenaScope()
+	{
+		arena.Rewind(mark);
+	}
+};
+
+// STL allocator using the arena, without an arena it uses the global new and delete
+template<typename T>
+class arena_allocator
+{
+	template<typename U> friend class arena_allocator;
+	CArena* arena{};
+
+public:
+	using value_type = T;
+	using propagate_on_container_copy_assignment = std::true_type;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+
+	arena_allocator() = default;
+	explicit arena_allocator(CArena& arena) : arena(&arena)
+	{
+	}
+	template<typename U>
+	arena_allocator(const arena_allocator<U>& other) : arena(other.arena)
+	{
+	}
+
+	T* allocate(size_t n)
+	{
+		if (arena)
+			return static_cast<T*>(arena->Allocate(n * sizeof(T), alignof(T)));
+		return static_cast<T*>(::operator new(n * sizeof(T)));
+	}
+
+	void deallocate(T* p, size_t)
+	{
+		if (!arena)
+			::operator delete(p);
+	}
+
+	template<typename U>
+	bool operator==(const arena_allocator<U>& other) const
+	{
+		return arena == other.arena;
+	}
+	template<typename U>
+	bool operator!=(const arena_allocator<U>& other) const
+	{
+		return arena != other.arena;
+	}
+};
@@ -26,8 +26,12 @@
 #include "CLI11.hpp"
 #include "compression.h"
 #include "decompression.h"
+#include "archive_index.h"
 #include "info.h"
 #include <string>
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
 
 struct CDefaultQualBinThr
 {
@@ -100,6 +104,7 @@ CCompressorParams compr_ONT_ratio_set_defaults()
     params.maxKmerCount = 120;
     params.filterHashModulo = 8;
     params.maxCandidates = 10;
+    params.minimizerWindow = 1;
     params.editScriptCostMultiplier = 1.0;
     params.maxRecurence = 6;
     params.minPartLenToConsiderAltRead = 48;
@@ -133,6 +138,7 @@ CCompressorParams compr_ONT_balanced_set_defaults()
     params.maxKmerCount = 100;
     params.filterHashModulo = 9;
     params.maxCandidates = 8;
+    params.minimizerWindow = 1;
     params.editScriptCostMultiplier = 1.0;
     params.maxRecurence = 5;
     params.minPartLenToConsiderAltRead = 48;
@@ -165,6 +171,7 @@ CCompressorParams compr_ONT_memory_set_defaults()
     params.maxKmerCount = 80;
     params.filterHashModulo = 12;
     params.maxCandidates = 5;
+    params.minimizerWindow = 4;
     params.editScriptCostMultiplier = 1.0;
     params.maxRecurence = 3;
     params.minPartLenToConsiderAltRead = 64;
@@ -182,6 +189,40 @@ CCompressorParams compr_ONT_memory_set_defaults()
 
     return params;
 }
+
+// Speed priority: fewer candidates and reference reads, sampled k-mers in the graph, a single level of alternative reads.
+// Simulated ONT-like reads (8% errors, 25x coverage of 1 Mbp genome): about 1.25x faster than memory priority, archive about 15% larger.
+CCompressorParams compr_ONT_speed_set_defaults()
+{
+    CCompressorParams params;
+    params.dataSource = DataSource::ONT;
+    params.priority = CompressionPriority::Speed;
+
+    params.compressionLevel = 1;
+
+    params.kmerLen = 0;
+    params.anchorLen = 0;
+    params.minKmerCount = 4;
+    params.maxKmerCount = 80;
+    params.filterHashModulo = 16;
+    params.maxCandidates = 3;
+    params.minimizerWindow = 4;
+    params.editScriptCostMultiplier = 1.0;
+    params.maxRecurence = 1;
+    params.minPartLenToConsiderAltRead = 64;
+    params.minFractionOfMmersInEncode = 0.5;
+    params.minFractionOfMmersInEncodeToAlwaysEncode = 0.9;
+    params.maxMatchesMultiplier = 10;
+    params.nThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    params.qualityComprMode = QualityComprMode::QuadAverage;
+    params.headerComprMode = HeaderComprMode::Original;
+    params.referenceReadsMode = ReferenceReadsMode::Sparse;
+    params.sparseMode_range_symbols = 0.5;
+    params.sparseMode_exponent = 1.0;
+    params.minAnchors = 1;
+
+    return params;
+}
 /*------------------------------------------------------*/
 
 /********************************************************/
@@ -201,6 +242,7 @@ CCompressorParams compr_PBRaw_ratio_set_defaults()
     params.maxKmerCount = 120;
     params.filterHashModulo = 8;
     params.maxCandidates = 10;
+    params.minimizerWindow = 1;
     params.editScriptCostMultiplier = 1.0;
     params.maxRecurence = 6;
     params.minPartLenToConsiderAltRead = 48;
@@ -232,6 +274,7 @@ CCompressorParams compr_PBRaw_balanced_set_defaults()
     params.maxKmerCount = 100;
     params.filterHashModulo = 9;
     params.maxCandidates = 8;
+    params.minimizerWindow = 1;
     params.editScriptCostMultiplier = 1.0;
     params.maxRecurence = 5;
     params.minPartLenToConsiderAltRead = 48;
@@ -263,6 +306,7 @@ CCompressorParams compr_PBRaw_memory_set_defaults()
     params.maxKmerCount = 80;
     params.filterHashModulo = 12;
     params.maxCandidates = 5;
+    params.minimizerWindow = 4;
     params.editScriptCostMultiplier = 1.0;
     params.maxRecurence = 3;
     params.minPartLenToConsiderAltRead = 64;
@@ -279,6 +323,40 @@ CCompressorParams compr_PBRaw_memory_set_defaults()
 
     return params;
 }
+
+// PBRaw speed priority, the same DNA related settings as for ONT.
+// Simulated CLR-like reads (8% errors, 25x coverage of 1 Mbp genome): about 1.2x faster than memory priority, archive about 15% larger.
+CCompressorParams compr_PBRaw_speed_set_defaults()
+{
+    CCompressorParams params;
+    params.dataSource = DataSource::PBRaw;
+    params.priority = CompressionPriority::Speed;
+
+    params.compressionLevel = 1;
+
+    params.kmerLen = 0;
+    params.anchorLen = 0;
+    params.minKmerCount = 4;
+    params.maxKmerCount = 80;
+    params.filterHashModulo = 16;
+    params.maxCandidates = 3;
+    params.minimizerWindow = 4;
+    params.editScriptCostMultiplier = 1.0;
+    params.maxRecurence = 1;
+    params.minPartLenToConsiderAltRead = 64;
+    params.minFractionOfMmersInEncode = 0.5;
+    params.minFractionOfMmersInEncodeToAlwaysEncode = 0.9;
+    params.maxMatchesMultiplier = 10;
+    params.nThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    params.qualityComprMode = QualityComprMode::None;
+    params.headerComprMode = HeaderComprMode::Original;
+    params.referenceReadsMode = ReferenceReadsMode::Sparse;
+    params.sparseMode_range_symbols = 0.5;
+    params.sparseMode_exponent = 1.0;
+    params.minAnchors = 1;
+
+    return params;
+}
 /*------------------------------------------------------*/
 
 /********************************************************/
@@ -298,6 +376,7 @@ CCompressorParams compr_PBHiFi_ratio_set_defaults()
     params.maxKmerCount = 150;
     params.filterHashModulo = 20;
     params.maxCandidates = 12;
+    params.minimizerWindow = 1;
     params.editScriptCostMultiplier = 1.0;
     params.maxRecurence = 6;
     params.minPartLenToConsiderAltRead = 48;
@@ -329,6 +408,7 @@ CCompressorParams compr_PBHiFi_balanced_set_defaults()
     params.maxKmerCount = 120;
     params.filterHashModulo = 30;
     params.maxCandidates = 10;
+    params.minimizerWindow = 1;
     params.editScriptCostMultiplier = 1.0;
     params.maxRecurence = 5;
     params.minPartLenToConsiderAltRead = 48;
@@ -361,6 +441,7 @@ CCompressorParams compr_PBHiFi_memory_set_defaults()
     params.maxKmerCount = 100;
     params.filterHashModulo = 40;
     params.maxCandidates = 8;
+    params.minimizerWindow = 4;
     params.editScriptCostMultiplier = 1.0;
     params.maxRecurence = 5;
     params.minPartLenToConsiderAltRead = 48;
@@ -406,9 +487,88 @@ CCompressorParams compr_PBHiFi_memory_set_defaults()
 
     return params;*/
 }
+
+// HiFi reads profit more from alternative reads than from many candidates, so a level of alternative reads is kept and the number of reference reads is reduced instead.
+// Simulated HiFi-like reads (1% errors, 25x coverage of 1 Mbp genome): about 1.5x faster than memory priority, archive about 40% larger.
+CCompressorParams compr_PBHiFi_speed_set_defaults()
+{
+    CCompressorParams params;
+    params.dataSource = DataSource::PBHiFi;
+    params.priority = CompressionPriority::Speed;
+
+    params.compressionLevel = 1;
+
+    params.kmerLen = 0;
+    params.anchorLen = 0;
+    params.minKmerCount = 4;
+    params.maxKmerCount = 80;
+    params.filterHashModulo = 60;
+    params.maxCandidates = 4;
+    params.minimizerWindow = 4;
+    params.editScriptCostMultiplier = 1.0;
+    params.maxRecurence = 1;
+    params.minPartLenToConsiderAltRead = 48;
+    params.minFractionOfMmersInEncode = 0.5;
+    params.minFractionOfMmersInEncodeToAlwaysEncode = 0.9;
+    params.maxMatchesMultiplier = 10;
+    params.nThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    params.qualityComprMode = QualityComprMode::QuinaryAverage;
+    params.headerComprMode = HeaderComprMode::Original;
+    params.referenceReadsMode = ReferenceReadsMode::Sparse;
+    params.sparseMode_range_symbols = 1;
+    params.sparseMode_exponent = 1.0;
+    params.minAnchors = 1;
+
+    return params;
+}
 /*------------------------------------------------------*/
 
 
+// Replaces @list entries with the paths listed in the file (one per line, like KMC does) and checks if all the inputs exist
+void expand_input_paths(std::vector<std::string>& paths)
+{
+    std::vector<std::string> res;
+    for (const auto& path : paths)
+    {
+        if (path.size() > 1 && path[0] == '@')
+        {
+            std::ifstream in(path.substr(1));
+            if (!in)
+            {
+                std::cerr << "Error: cannot open file " << path.substr(1) << "\n";
+                exit(1);
+            }
+            std::string line;
+            while (std::getline(in, line))
+            {
+                if (line.size() && line.back() == '\r')
+                    line.pop_back();
+                if (line != "")
+                    res.push_back(line);
+            }
+        }
+        else
+            res.push_back(path);
+    }
+
+    if (res.empty())
+    {
+        std::cerr << "Error: no input files\n";
+        exit(1);
+    }
+    if (std::count(res.begin(), res.end(), "-") > 1)
+    {
+        std::cerr << "Error: standard input (-) may be given only once\n";
+        exit(1);
+    }
+    for (const auto& path : res)
+        if (path != "-" && !std::filesystem::is_regular_file(path))
+        {
+            std::cerr << "Error: input file " << path << " does not exist\n";
+            exit(1);
+        }
+    paths = std::move(res);
+}
 
 template<typename T>
 void adjust_quality_mode_and_thresholds(CCompressorParams& params, const T& defaults, const std::string& mode_name)
@@ -452,7 +612,7 @@ void adjust_quality_mode_and_thresholds(CCompressorParams& params, const T& defa
 
 void addPriorityParam(CLI::App& app, std::string& str)
 {
-    std::set<std::string> q_p{ "ratio", "balanced", "memory" };
+    std::set<std::string> q_p{ "ratio", "balanced", "memory", "speed" };
     str = "memory"; //memory is default
     app.add_set("-p,--priority", str, q_p, "compression quality");
 }
@@ -464,12 +624,28 @@ void set_compression_params(CLI::App* app, CInfo& info, const std::string& comma
         compParser->group("");
 
     //positionals    
-    compParser->add_option("input", comParams.inputFilePath, "input FASTQ/FASTA path (gzipped or not)")->required(true)->check(CLI::ExistingFile);
-    compParser->add_option("output", comParams.outputFilePath, "archive path")->required(true);
+    //the number of inputs is not limited, so the archive path is taken as the last one (a separate positional would be consumed by the inputs)
+    compParser->add_option("input", comParams.inputFilePaths, "input FASTQ/FASTA (gzipped or not) or unaligned BAM path(s) (- for standard input, @list for a file with input paths, one per line) "
+        "followed by the archive path (- for standard output); all the inputs go into a single archive")->required(true)->expected(2, -1);
 
     // options
     toHideIfNoHelp.push_back(compParser->add_option("-k,--kmer-len", comParams.kmerLen, "k-mer length (default: auto adjust)")->check(CLI::Range(15, 28))); //TODO: maybe max should be lower (27, 28?)
     toHideIfNoHelp.push_back(compParser->add_option("-t,--threads", comParams.nThreads, "number of threads", true));
+    toHideIfNoHelp.push_back(compParser->add_option("-m,--max-memory", comParams.maxMemory, "memory limit in GB, the queues depths, reference reads mode, sparse exponent and sparse range are adjusted to fit in it, compression is refused if it is not possible (default: no limit)")->check(CLI::Range(1.0, 1024.0)));
+    toHideIfNoHelp.push_back(compParser->add_option("--tmp-dir", comParams.tmpDirPath, "directory for temporary files (default: directory of the output file, system temporary directory if output is -)")->check(CLI::ExistingDirectory));
+
+    comParams.internal.spool_mode = inputSpoolModeToString(comParams.inputSpoolMode);
+    std::set<std::string> spool_p{ "auto", "none", "disk", "memory" };
+    toHideIfNoHelp.push_back(compParser->add_set("--spool", comParams.internal.spool_mode, spool_p, "keep the records parsed while counting k-mers, so the input is read and parsed only once \n"
+        " * none - read the input twice, \n"
+        " * disk - keep the records (2-bit packed bases) in a temporary file, \n"
+        " * memory - keep the records in memory, \n"
+        " * auto - disk for gzipped input, none otherwise; not used for BAM input.",
+        true));
+
+    auto saveIndexOpt = compParser->add_option("--save-index", comParams.saveIndexPath, "store the filtered k-mers and the input stats in the given file, so next compressions of the same input (e.g. with different priority or quality settings) may skip k-mer counting; candidates of similar reads are not stored, they are searched again");
+    toHideIfNoHelp.push_back(saveIndexOpt);
+    toHideIfNoHelp.push_back(compParser->add_option("--load-index", comParams.loadIndexPath, "load the filtered k-mers and the input stats stored with --save-index instead of counting k-mers, the input and k-mer related settings must be the same (the input is verified while it is compressed)")->check(CLI::ExistingFile)->excludes(saveIndexOpt));
   
     addPriorityParam(*compParser, comParams.internal.priority);
 
@@ -517,13 +693,15 @@ void set_compression_params(CLI::App* app, CInfo& info, const std::string& comma
     toHideIfNoHelp.push_back(compParser->add_option("-H,--Highest-count", comParams.maxKmerCount, "maximal k-mer count", true));
     toHideIfNoHelp.push_back(compParser->add_option("-f,--filter-modulo", comParams.filterHashModulo, "k-mers for which hash(k-mer) mod f != 0 will be filtered out before graph building", true));
     toHideIfNoHelp.push_back(compParser->add_option("-c,--max-candidates", comParams.maxCandidates, "maximal number of reference reads considered as reference", true)->check(CLI::PositiveNumber));
+    toHideIfNoHelp.push_back(compParser->add_option("--minimizer-window", comParams.minimizerWindow, "if greater than 1 only minimizers of windows of this number of consecutive k-mers (left by -f) are used to find similar reads, it reduces memory at the cost of slightly lower ratio", true)->check(CLI::PositiveNumber));
     toHideIfNoHelp.push_back(compParser->add_option("-e,--edit-script-mult", comParams.editScriptCostMultiplier, "multipier for predicted cost of storing read part as edit script", true)->check(CLI::PositiveNumber));
     toHideIfNoHelp.push_back(compParser->add_option("-r,--max-recurence-level", comParams.maxRecurence, "maximal level of recurence when considering alternative reference reads", true)->check(CLI::NonNegativeNumber));
     toHideIfNoHelp.push_back(compParser->add_option("--min-to-alt", comParams.minPartLenToConsiderAltRead, "minimum length of encoding part to consider using alternative read", true)->check(CLI::PositiveNumber));
     toHideIfNoHelp.push_back(compParser->add_option("--min-mmer-frac", comParams.minFractionOfMmersInEncode, "if A is set of m-mers in encode read R then read is refused from encoding if |A| < min-mmer-frac * len(R)", true)->check(CLI::NonNegativeNumber));
     toHideIfNoHelp.push_back(compParser->add_option("--min-mmer-force-enc", comParams.minFractionOfMmersInEncodeToAlwaysEncode, "if A is set of m-mers in encode read R then read is accepted to encoding always if |A| > min-mmer-force-enc * len(R)", true)->check(CLI::NonNegativeNumber));
     toHideIfNoHelp.push_back(compParser->add_option("--max-matches-mult", comParams.maxMatchesMultiplier, "if the number of matches between encode read R and reference read is r, then read is refused from encoding if r > max-matches-mult * len(R)", true)->check(CLI::NonNegativeNumber));
-    toHideIfNoHelp.push_back(compParser->add_option("--fill-factor-filtered-kmers", comParams.fillFactorFilteredKmers, "fill factor of filtered k-mers hash table", true)->check(CLI::Range(0.1, 0.99)));
+    toHideIfNoHelp.push_back(compParser->add_option("--max-effort", comParams.maxEncodeEffort, "the work spent on encoding read R (scanned candidate symbols and alignment words) is limited to max-effort * len(R), after that the remaining candidates are skipped and the remainder of R is stored plain (0 - no limit)", true)->check(CLI::NonNegativeNumber));
+    toHideIfNoHelp.push_back(compParser->add_option("--fill-factor-filtered-kmers", comParams.internal.fill_factor_filtered_kmers, "deprecated, has no effect (filtered k-mers are no longer kept in a hash table)")->check(CLI::Range(0.1, 0.99)));
     toHideIfNoHelp.push_back(compParser->add_option("--fill-factor-kmers-to-reads", comParams.fillFactorKmersToReads, "fill factor of k-mers to reads hash table", true)->check(CLI::Range(0.1, 0.99)));
   
    
@@ -542,10 +720,19 @@ void set_compression_params(CLI::App* app, CInfo& info, const std::string& comma
     toHideIfNoHelp.push_back(compParser->add_option("-g,--sparse-range", comParams.sparseMode_range_symbols, "sparse mode range. The propability of reference read acceptance is 1/pow(id/range_reads, exponent), where range_reads is determined based on the number of symbols, which in turn is determined by the number of trusted unique k-mers (estimated genome length) multiplied by the value of this parameter", true));
     toHideIfNoHelp.push_back(compParser->add_option("-x,--sparse-exponent", comParams.sparseMode_exponent, "sparse mode exponent", true));
 
+    toHideIfNoHelp.push_back(compParser->add_option("--dna-block-size", comParams.dnaBlockSize, "split DNA stream into independently decodable blocks of (at least) this number of reads, which allows parallel decompression and faster access to reads range; reads are predicted only from reference reads of the same block, so compression ratio drops for small blocks (0 - single block)", true));
+    toHideIfNoHelp.push_back(compParser->add_option("--qual-block-size", comParams.qualBlockSize, "split quality stream into independently decodable blocks of (at least) this number of reads, which allows parallel decompression and faster access to reads range; each block is coded with fresh models (0 - single block)", true));
+
     compParser->callback([&]() {
 
+        comParams.outputFilePath = comParams.inputFilePaths.back();
+        comParams.inputFilePaths.pop_back();
+        expand_input_paths(comParams.inputFilePaths);
+
         comParams.priority = compressionPriorityFromString(comParams.internal.priority);
 
+        comParams.inputSpoolMode = inputSpoolModeFromString(comParams.internal.spool_mode);
+
         comParams.headerComprMode = headerComprModeFromString(comParams.internal.header_mode);
         
         if (comParams.internal.qual_mode == "none")
@@ -621,12 +808,23 @@ void set_compression_params(CLI::App* app, CInfo& info, const std::string& comma
             }
         }
 
+        if (comParams.internal.fill_factor_filtered_kmers)
+            std::cerr << "Warning: --fill-factor-filtered-kmers is deprecated and has no effect\n";
+
         if (comParams.storeRefGenome && comParams.refGenomePath == "")
         {
             std::cerr << "Warning: -s has not effect if reference genome (-G) is not specified\n";
             comParams.storeRefGenome = false;
         }
 
+        if (comParams.tmpDirPath == "")
+        {
+            if (comParams.outputFilePath == "-")
+                comParams.tmpDirPath = std::filesystem::temp_directory_path().string();
+            else
+                comParams.tmpDirPath = std::filesystem::path(comParams.outputFilePath).remove_filename().string();
+        }
+
         runCompression(comParams, info);
     });
 }
@@ -724,6 +922,8 @@ CompressionPriority compressionPriorityFromString(const std::string& str)
         return CompressionPriority::Balanced;
     else if (str == "memory")
         return CompressionPriority::Memory;
+    else if (str == "speed")
+        return CompressionPriority::Speed;
     else
     {
         std::cerr << "Internal error\n";
@@ -740,6 +940,42 @@ std::string compressionPriorityToString(CompressionPriority compressionPriority)
         return "balanced";
     case CompressionPriority::Memory:
         return "memory";
+    case CompressionPriority::Speed:
+        return "speed";
+    default:
+        std::cerr << "Internal Error\n";
+        exit(1);
+    }
+}
+
+InputSpoolMode inputSpoolModeFromString(const std::string& str)
+{
+    if (str == "auto")
+        return InputSpoolMode::Auto;
+    else if (str == "none")
+        return InputSpoolMode::None;
+    else if (str == "disk")
+        return InputSpoolMode::Disk;
+    else if (str == "memory")
+        return InputSpoolMode::Memory;
+    else
+    {
+        std::cerr << "Internal error\n";
+        exit(1);
+    }
+}
+std::string inputSpoolModeToString(InputSpoolMode inputSpoolMode)
+{
+    switch (inputSpoolMode)
+    {
+    case InputSpoolMode::Auto:
+        return "auto";
+    case InputSpoolMode::None:
+        return "none";
+    case InputSpoolMode::Disk:
+        return "disk";
+    case InputSpoolMode::Memory:
+        return "memory";
     default:
         std::cerr << "Internal Error\n";
         exit(1);
@@ -847,7 +1083,12 @@ int parse_params(int argc, char** argv)
         comParamsONT = compr_ONT_memory_set_defaults();
         comParamsPBRaw = compr_PBRaw_memory_set_defaults();
         comParamsPBHiFi = compr_PBHiFi_memory_set_defaults();
-        break;    
+        break;
+    case CompressionPriority::Speed:
+        comParamsONT = compr_ONT_speed_set_defaults();
+        comParamsPBRaw = compr_PBRaw_speed_set_defaults();
+        comParamsPBHiFi = compr_PBHiFi_speed_set_defaults();
+        break;
     }
 
     std::vector<CLI::Option*> toHideIfNoHelp;
@@ -859,6 +1100,13 @@ int parse_params(int argc, char** argv)
     CLI::App* decompParser = app.add_subcommand("decompress", "decompression mode");
 
     decompParser->callback([&decomParams]() {
+        if (decomParams.internal.reads_range != "")
+        {
+            CReadsRange range;
+            parseReadsRange(decomParams.internal.reads_range, range);
+            decomParams.readsFrom = range.from;
+            decomParams.readsTo = range.to;
+        }
         runDecompression(decomParams);
     });
 
@@ -869,6 +1117,15 @@ int parse_params(int argc, char** argv)
     decompParser->add_option("-G,--reference-genome", decomParams.refGenomePath,
         "optional reference genome path (multi-FASTA gzipped or not), required for reference-based archives with no reference genome embedded (`-G` compression without `-s` switch)")->check(CLI::ExistingFile);
 
+    decompParser->add_option("--reads", decomParams.internal.reads_range,
+        "decompress only reads FROM-TO (1-based, inclusive), decoding starts from the nearest restart point stored in the archive index; "
+        "DNA (qualities) can be decoded from the middle only if the archive was compressed with --dna-block-size (--qual-block-size), otherwise decoding starts from the first read and only the output is limited")->check([](const std::string& str) {
+            CReadsRange range;
+            return parseReadsRange(str, range) ? std::string() : std::string("expected FROM-TO with 1 <= FROM <= TO");
+        });
+
+    decompParser->add_option("-t,--threads", decomParams.nThreads, "number of threads (used for archives with DNA or quality blocks)", true)->check(CLI::PositiveNumber);
+
     decompParser->add_flag("-v,--verbose", decomParams.verbose, "verbose");
 
     CInfoParams infoParams;
@@ -0,0 +1,238 @@
+/*******************************************************************************
+ 
+ CoLoRd 
+ Copyright (C) 2021, M. Kokot, S. Deorowicz, and A. Gudys
+ https://github.com/refresh-bio/CoLoRd
+
+ This program is free software: you can redistribute it and/or modify it under 
+ the terms of the GNU General Public License as published by the Free Software 
+ Foundation; either version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY 
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR 
+ A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along with this 
+ program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#pragma once
+#include "utils.h"
+#include "edit_script.h"
+#include <vector>
+
+// Global (NW) alignment restricted to a band of diagonals, used for long fragments between two anchors.
+// The band follows the diagonal from the end of the left anchor to the start of the right anchor and is wide enough for alignments with at most max_edit_dist edits.
+// The columns are computed with Myers' bit-vectors (the ref is split into 64-symbol blocks), but only for the blocks crossing the band.
+// The cells outside of the band are never underestimated, so each cell of an alignment within the limit is computed exactly
+// and the traceback (preferring up, left, diagonal as edlib does) gives the same edit script as the full computation.
+class CBandedAligner
+{
+	static constexpr uint32_t inf = ~0u >> 2;
+
+	//the blocks of all columns are kept for the traceback, so the band is limited (longer alignments are left to edlib)
+	static constexpr uint64_t max_band_blocks = 1ull << 20;
+	//buffers grown above this number of elements are released after the alignment, so a single long gap does not pin its memory
+	static constexpr uint64_t max_kept_size = 1ull << 16;
+	//Pv, Mv and score of a block, and the offset and first block of a column (each column has at least one block)
+	static constexpr uint64_t bytes_per_block = 2 * sizeof(uint64_t) + 3 * sizeof(uint32_t);
+
+	std::vector<uint64_t> peq;				//4 words per block of ref
+	std::vector<uint64_t> Pv, Mv;			//vertical deltas of the current column
+	std::vector<uint32_t> score;			//values in the last rows of blocks of the current column
+	std::vector<uint64_t> col_Pv, col_Mv;	//blocks of all columns, column j (1-based) starts at col_offset[j - 1]
+	std::vector<uint32_t> col_score;
+	std::vector<uint32_t> col_offset, col_first_block;
+	std::vector<unsigned char> alignment;
+	int64_t diag_lo{}, diag_hi{};
+	uint32_t n{}, m{};
+
+	// Score of cell in row i (0 - before the first symbol of ref) and column j (0 - before the first symbol of enc)
+	uint32_t cell(uint32_t i, uint32_t j) const
+	{
+		if (i == 0)
+			return j;
+		if (j == 0)
+			return i;
+		uint32_t b = (i - 1) / 64;
+		uint32_t first = col_first_block[j - 1];
+		uint32_t off = col_offset[j - 1];
+		if (b < first || off + b - first >= col_offset[j])
+			return inf;
+		uint64_t idx = off + b - first;
+		uint32_t shift = i - 64 * b;
+		uint64_t below = shift == 64 ? 0 : ~0ull << shift;
+		return col_score[idx] - bit_parallel_popcount(col_Pv[idx] & below) + bit_parallel_popcount(col_Mv[idx] & below);
+	}
+
+	// One column of a block, hin is the difference between the cells above the block in the current and the previous column
+	static int calc_block(uint64_t& P, uint64_t& M, uint64_t Eq, int hin)
+	{
+		uint64_t hin_neg = hin < 0;
+		uint64_t Xv = Eq | M;
+		Eq |= hin_neg;
+		uint64_t Xh = (((Eq & P) + P) ^ P) | Eq;
+		uint64_t Ph = M | ~(Xh | P);
+		uint64_t Mh = P & Xh;
+		int hout = static_cast<int>(Ph >> 63) - static_cast<int>(Mh >> 63);
+		Ph = (Ph << 1) | static_cast<uint64_t>(hin > 0);
+		Mh = (Mh << 1) | hin_neg;
+		P = Mh | ~(Xv | Ph);
+		M = Ph & Xv;
+		return hout;
+	}
+
+	template<typename T>
+	static void release_if_oversized(std::vector<T>& vec)
+	{
+		if (vec.capacity() > max_kept_size)
+			std::vector<T>().swap(vec);
+	}
+
+	void release_oversized()
+	{
+		release_if_oversized(peq);
+		release_if_oversized(Pv);
+		release_if_oversized(Mv);
+		release_if_oversized(score);
+		release_if_oversized(col_Pv);
+		release_if_oversized(col_Mv);
+		release_if_oversized(col_score);
+		release_if_oversized(col_offset);
+		release_if_oversized(col_first_block);
+		release_if_oversized(alignment);
+	}
+
+	bool align(read_view ref, read_view enc, uint32_t max_edit_dist, EditDistRes& res)
+	{
+		n = static_cast<uint32_t>(ref.size());
+		m = static_cast<uint32_t>(enc.size());
+
+		//a path leaving the diagonals range [min(0, m - n), max(0, m - n)] by x costs at least |m - n| + 2x edits
+		int64_t len_diff = static_cast<int64_t>(m) - n;
+		int64_t margin = (max_edit_dist - (len_diff < 0 ? -len_diff : len_diff)) / 2;
+		diag_lo = std::min<int64_t>(0, len_diff) - margin;
+		diag_hi = std::max<int64_t>(0, len_diff) + margin;
+
+		const uint32_t n_blocks = (n + 63) / 64;
+		peq.assign(4ull * n_blocks, 0);
+		for (uint32_t i = 0; i < n; ++i)
+			peq[4 * (i / 64) + ref[i]] |= 1ull << (i % 64);
+
+		//blocks with rows of the band in column j (1-based), the rows (1-based) are in [j - diag_hi, j - diag_lo]
+		auto first_block = [&](uint32_t j) { return static_cast<uint32_t>((std::max<int64_t>(1, j - diag_hi) - 1) / 64); };
+		auto last_block = [&](uint32_t j) { return static_cast<uint32_t>((std::min<int64_t>(n, j - diag_lo) - 1) / 64); };
+
+		//column 0
+		uint32_t last = last_block(1);
+		Pv.assign(n_blocks, ~0ull);
+		Mv.assign(n_blocks, 0);
+		score.resize(n_blocks);
+		for (uint32_t b = 0; b <= last; ++b)
+			score[b] = 64 * (b + 1);
+
+		col_Pv.clear();
+		col_Mv.clear();
+		col_score.clear();
+		col_offset.assign(1, 0);
+		col_first_block.clear();
+
+		for (uint32_t j = 1; j <= m; ++j)
+		{
+			uint32_t first = first_block(j);
+			uint32_t new_last = last_block(j);
+			//a block entering the band starts from the values growing by one below the block above (it is not less than the exact values)
+			for (uint32_t b = last + 1; b <= new_last; ++b)
+			{
+				Pv[b] = ~0ull;
+				Mv[b] = 0;
+				score[b] = score[b - 1] + 64;
+			}
+			last = new_last;
+
+			const uint64_t* Eq = peq.data() + enc[j - 1];
+			int hout = 1; //the cell above the first block is assumed to grow by one
+			for (uint32_t b = first; b <= last; ++b)
+			{
+				hout = calc_block(Pv[b], Mv[b], Eq[4 * b], hout);
+				score[b] += hout;
+			}
+
+			col_first_block.push_back(first);
+			col_Pv.insert(col_Pv.end(), Pv.begin() + first, Pv.begin() + last + 1);
+			col_Mv.insert(col_Mv.end(), Mv.begin() + first, Mv.begin() + last + 1);
+			col_score.insert(col_score.end(), score.begin() + first, score.begin() + last + 1);
+			col_offset.push_back(static_cast<uint32_t>(col_score.size()));
+		}
+
+		uint32_t cur = cell(n, m);
+		if (cur > max_edit_dist)
+			return false;
+		res.editDist = cur;
+
+		//traceback in edlib convention (ref is the query)
+		alignment.clear();
+		uint32_t i = n, j = m;
+		while (i > 0 && j > 0)
+		{
+			uint32_t up = cell(i - 1, j);
+			if (up + 1 == cur)
+			{
+				alignment.push_back(EDLIB_EDOP_INSERT);
+				--i;
+				cur = up;
+				continue;
+			}
+			uint32_t left = cell(i, j - 1);
+			if (left + 1 == cur)
+			{
+				alignment.push_back(EDLIB_EDOP_DELETE);
+				--j;
+				cur = left;
+				continue;
+			}
+			uint32_t diag = cell(i - 1, j - 1);
+			alignment.push_back(diag == cur ? EDLIB_EDOP_MATCH : EDLIB_EDOP_MISMATCH);
+			--i;
+			--j;
+			cur = diag;
+		}
+		alignment.insert(alignment.end(), i, EDLIB_EDOP_INSERT);
+		alignment.insert(alignment.end(), j, EDLIB_EDOP_DELETE);
+		std::reverse(alignment.begin(), alignment.end());
+
+		res.editScript = edit_script_from_alignment(alignment.data(), static_cast<int>(alignment.size()), ref, enc, false);
+		return true;
+	}
+
+public:
+	// Returns the number of 64-cell blocks computed in the band for the given limit of edits (0 if the limit is lower than the difference of lengths)
+	static uint64_t BandBlocks(uint32_t ref_len, uint32_t enc_len, uint32_t max_edit_dist)
+	{
+		uint32_t len_diff = ref_len > enc_len ? ref_len - enc_len : enc_len - ref_len;
+		if (max_edit_dist < len_diff)
+			return 0;
+		uint64_t width = len_diff + 2 * ((max_edit_dist - len_diff) / 2) + 1;
+		uint64_t n_blocks = (ref_len + 63) / 64;
+		return enc_len * std::min<uint64_t>(n_blocks, width / 64 + 2);
+	}
+
+	// Upper bound of the memory used by an aligner, the buffers above max_kept_size exist only during a single alignment
+	static uint64_t MaxMemoryUsage()
+	{
+		return max_band_blocks * bytes_per_block;
+	}
+
+	// Returns false if the edit distance exceeds max_edit_dist (the band is too narrow) or the band is too large to keep it for the traceback,
+	// the sequences may not be empty
+	bool Align(read_view ref, read_view enc, uint32_t max_edit_dist, EditDistRes& res)
+	{
+		uint64_t n_band_blocks = BandBlocks(static_cast<uint32_t>(ref.size()), static_cast<uint32_t>(enc.size()), max_edit_dist);
+		if (!n_band_blocks || n_band_blocks > max_band_blocks)
+			return false;
+
+		bool aligned = align(ref, enc, max_edit_dist, res);
+		release_oversized();
+		return aligned;
+	}
+};
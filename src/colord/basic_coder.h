@@ -61,28 +61,57 @@ constexpr uint64_t no_bytes(uint64_t x)
 
 // *******************************************************************************************
 // Class for storage of range coder compressed data
+// Compressed input stored outside of the coder (e.g. part of memory-mapped archive)
+struct input_view_t
+{
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+};
+
+// *******************************************************************************************
 class CVectorIOStream
 {
 	vector<uint8_t>& v;
+	const input_view_t* ext_input;
+	const uint8_t* in_data;
+	size_t in_size;
 	size_t read_pos;
 
+	// Reading is from the external input if it is set, otherwise from the vector
+	void bind_input()
+	{
+		if (ext_input && ext_input->data)
+		{
+			in_data = ext_input->data;
+			in_size = ext_input->size;
+		}
+		else
+		{
+			in_data = v.data();
+			in_size = v.size();
+		}
+	}
+
 public:
-	CVectorIOStream(vector<uint8_t>& _v) : v(_v), read_pos(0)
-	{}
+	CVectorIOStream(vector<uint8_t>& _v, const input_view_t* _ext_input = nullptr) : v(_v), ext_input(_ext_input), read_pos(0)
+	{
+		bind_input();
+	}
 
 	void RestartRead()
 	{
 		read_pos = 0;
+		bind_input();
 	}
 
 	bool Eof() const
 	{
-		return read_pos >= v.size();
+		return read_pos >= in_size;
 	}
 
 	uint8_t GetByte()
 	{
-		return v[read_pos++];
+		return in_data[read_pos++];
 	}
 
 	void PutByte(uint8_t x)
@@ -98,6 +127,8 @@ public:
 
 	size_t Size()
 	{
+		if (ext_input && ext_input->data)
+			return ext_input->size;
 		return v.size();
 	}
 };
@@ -112,6 +143,7 @@ protected:
 
 	CVectorIOStream* v_vios_io;
 	vector<uint8_t> v_io;
+	input_view_t in_view;
 
 	template<typename T, typename V>
 	V* find_rc_context(T& m_ctx_rc, context_t ctx, V* tpl)
@@ -164,6 +196,15 @@ public:
 	void SetInput(vector<uint8_t>& _v_io)
 	{
 		v_io = move(_v_io);
+		in_view = input_view_t();
+	}
+
+	// Setting compressed input without copying (before Init or Restart), the data must be valid until the part is decoded
+	void SetInput(const uint8_t* data, size_t size)
+	{
+		v_io.clear();
+		in_view.data = data;
+		in_view.size = size;
 	}
 };
 
@@ -0,0 +1,152 @@
+/*******************************************************************************
+ 
+ CoLoRd 
+ Copyright (C) 2021, M. Kokot, S. Deorowicz, and A. Gudys
+ https://github.com/refresh-bio/CoLoRd
+
+ This program is free software: you can redistribute it and/or modify it under 
+ the terms of the GNU General Public License as published by the Free Software 
+ Foundation; either version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY 
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR 
+ A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along with this 
+ program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#pragma once
+#include <cstdint>
+#include <cassert>
+#include <vector>
+#include <algorithm>
+#include "edlib.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Myers' bit-vector alignment of a short query (at most 64 symbols, a single machine word) to a target.
+// It is used instead of edlib for short fragments, where the edlib setup (alphabet transformation, Peq, bands, allocations) dominates.
+// The alignment is the same as the one returned by edlibAlign with EDLIB_TASK_PATH (the same tie resolving in the traceback),
+// so the edit scripts do not depend on which of them was used.
+constexpr uint32_t bit_parallel_max_query_len = 64;
+
+inline uint32_t bit_parallel_popcount(uint64_t x)
+{
+#ifdef _MSC_VER
+	return static_cast<uint32_t>(__popcnt64(x));
+#else
+	return static_cast<uint32_t>(__builtin_popcountll(x));
+#endif
+}
+
+// query, target - symbols 0..3, query_len in [1, bit_parallel_max_query_len], target_len >= 1
+// mode - EDLIB_MODE_NW or EDLIB_MODE_SHW (the end of target is free, the first best end location is used as edlib does)
+// alignment - edlib operation codes (EDLIB_EDOP_*), end_location - the last aligned symbol of target (-1 if no symbol of target is aligned)
+// returns the edit distance
+inline uint32_t bit_parallel_align(const uint8_t* query, uint32_t query_len, const uint8_t* target, uint32_t target_len, EdlibAlignMode mode,
+	std::vector<unsigned char>& alignment, int& end_location)
+{
+	assert(query_len >= 1 && query_len <= bit_parallel_max_query_len && target_len >= 1);
+	assert(mode == EDLIB_MODE_NW || mode == EDLIB_MODE_SHW);
+
+	//vertical deltas of each column (+1 in Pv, -1 in Mv), kept between calls
+	thread_local std::vector<uint64_t> Pvs, Mvs;
+	if (Pvs.size() < target_len)
+	{
+		Pvs.resize(target_len);
+		Mvs.resize(target_len);
+	}
+
+	uint64_t Peq[4]{};
+	for (uint32_t i = 0; i < query_len; ++i)
+	{
+		assert(query[i] < 4);
+		Peq[query[i]] |= 1ull << i;
+	}
+
+	const uint64_t high_bit = 1ull << (query_len - 1);
+	uint64_t Pv = ~0ull;
+	uint64_t Mv = 0;
+	uint32_t score = query_len;
+	//number of aligned target symbols, edlib considers also the empty prefix of target in SHW mode, but only if the query is padded (shorter than a word)
+	uint32_t best_score = query_len < 64 ? query_len : ~0u;
+	uint32_t best_len = 0;
+
+	for (uint32_t j = 0; j < target_len; ++j)
+	{
+		assert(target[j] < 4);
+		uint64_t Eq = Peq[target[j]];
+		uint64_t Xv = Eq | Mv;
+		uint64_t Xh = (((Eq & Pv) + Pv) ^ Pv) | Eq;
+		uint64_t Ph = Mv | ~(Xh | Pv);
+		uint64_t Mh = Pv & Xh;
+		if (Ph & high_bit)
+			++score;
+		else if (Mh & high_bit)
+			--score;
+		Ph = (Ph << 1) | 1; //the first row grows by one in each column
+		Mh <<= 1;
+		Pv = Mh | ~(Xv | Ph);
+		Mv = Ph & Xv;
+		Pvs[j] = Pv;
+		Mvs[j] = Mv;
+
+		if (mode == EDLIB_MODE_SHW && score < best_score)
+		{
+			best_score = score;
+			best_len = j + 1;
+		}
+	}
+	if (mode == EDLIB_MODE_NW)
+	{
+		best_score = score;
+		best_len = target_len;
+	}
+	end_location = static_cast<int>(best_len) - 1;
+
+	//score of cell in row i (0 - before the first symbol of query) and column j (0 - before the first symbol of target)
+	auto cell = [&](uint32_t i, uint32_t j) -> uint32_t {
+		if (j == 0)
+			return i;
+		uint64_t mask = i == 64 ? ~0ull : (1ull << i) - 1;
+		return j + bit_parallel_popcount(Pvs[j - 1] & mask) - bit_parallel_popcount(Mvs[j - 1] & mask);
+	};
+
+	//traceback, the moves are preferred in the same order as in edlib: up, left, diagonal
+	alignment.clear();
+	uint32_t i = query_len;
+	uint32_t j = best_len;
+	uint32_t cur = best_score;
+	while (i > 0 && j > 0)
+	{
+		uint32_t up = cell(i - 1, j);
+		if (up + 1 == cur)
+		{
+			alignment.push_back(EDLIB_EDOP_INSERT);
+			--i;
+			cur = up;
+			continue;
+		}
+		uint32_t left = cell(i, j - 1);
+		if (left + 1 == cur)
+		{
+			alignment.push_back(EDLIB_EDOP_DELETE);
+			--j;
+			cur = left;
+			continue;
+		}
+		uint32_t diag = cell(i - 1, j - 1);
+		alignment.push_back(diag == cur ? EDLIB_EDOP_MATCH : EDLIB_EDOP_MISMATCH);
+		--i;
+		--j;
+		cur = diag;
+	}
+	alignment.insert(alignment.end(), i, EDLIB_EDOP_INSERT);
+	alignment.insert(alignment.end(), j, EDLIB_EDOP_DELETE);
+	std::reverse(alignment.begin(), alignment.end());
+
+	return best_score;
+}
@@ -0,0 +1,54 @@
+/*******************************************************************************
+ 
+ CoLoRd 
+ Copyright (C) 2021, M. Kokot, S. Deorowicz, and A. Gudys
+ https://github.com/refresh-bio/CoLoRd
+
+ This program is free software: you can redistribute it and/or modify it under 
+ the terms of the GNU General Public License as published by the Free Software 
+ Foundation; either version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY 
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR 
+ A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along with this 
+ program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#pragma once
+#include <cstdint>
+
+// Splits the stream of reads packs into independently decodable blocks (of DNA or quality stream).
+// Block always consists of whole packs, the next block is started by the first pack after the current block has at least block_size reads.
+// For DNA it must give the same decisions in the similarity graph (which restricts candidates to the current block) and in the entropy coder.
+class CBlockSplitter
+{
+	uint64_t block_size;
+	uint64_t n_reads_in_block{};
+	bool is_first_pack = true;
+public:
+	// block_size == 0 means the whole stream is a single block
+	explicit CBlockSplitter(uint64_t block_size) :
+		block_size(block_size)
+	{
+	}
+
+	bool IsEnabled() const
+	{
+		return block_size != 0;
+	}
+
+	// Returns true if the pack of n_reads (the next one in the stream) starts a new block
+	bool NextPack(uint64_t n_reads)
+	{
+		bool starts_block = is_first_pack || (block_size && n_reads_in_block >= block_size);
+		is_first_pack = false;
+
+		if (starts_block)
+			n_reads_in_block = 0;
+		n_reads_in_block += n_reads;
+
+		return starts_block;
+	}
+};
@@ -0,0 +1,120 @@
+/*******************************************************************************
+ 
+ CoLoRd 
+ Copyright (C) 2021, M. Kokot, S. Deorowicz, and A. Gudys
+ https://github.com/refresh-bio/CoLoRd
+
+ This program is free software: you can redistribute it and/or modify it under 
+ the terms of the GNU General Public License as published by the Free Software 
+ Foundation; either version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY 
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR 
+ A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along with this 
+ program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#pragma once
+#include "murmur64_hash.h"
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+// ************************************************************************
+// Counts hits of reference reads (candidates) for a single read.
+// Open addressing with linear probing, the slots are invalidated in O(1) by changing the generation stamp,
+// so the counter may be reused for consecutive reads without clearing the memory
+class CCandidatesCounter
+{
+	struct slot_t
+	{
+		uint32_t stamp;
+		uint32_t ref_id;
+		uint32_t cand_id;	//position in candidates
+	};
+
+	std::vector<slot_t> slots;
+	uint32_t mask{};
+	uint32_t stamp = 1;
+
+	std::vector<std::pair<uint32_t, uint32_t>> candidates; //(reference read id, number of hits) in the order of the first hits
+
+	void resize(size_t n_slots)
+	{
+		slots.assign(n_slots, slot_t{ 0, 0, 0 });
+		mask = static_cast<uint32_t>(n_slots - 1);
+		stamp = 1;
+		for (uint32_t i = 0; i < candidates.size(); ++i)
+			slots[findSlot(candidates[i].first)] = slot_t{ stamp, candidates[i].first, i };
+	}
+
+	uint32_t findSlot(uint32_t ref_id) const
+	{
+		uint32_t pos = static_cast<uint32_t>(MurMur32Hash{}(ref_id)) & mask;
+		while (slots[pos].stamp == stamp && slots[pos].ref_id != ref_id)
+			pos = (pos + 1) & mask;
+		return pos;
+	}
+
+public:
+	CCandidatesCounter()
+	{
+		resize(1024);
+	}
+
+	void Clear()
+	{
+		candidates.clear();
+		if (++stamp == 0) //stamps wrapped around, all slots must be really cleared
+			resize(slots.size());
+	}
+
+	// Returns the position of the reference read in candidates
+	uint32_t Add(uint32_t ref_id)
+	{
+		uint32_t pos = findSlot(ref_id);
+		if (slots[pos].stamp == stamp)
+		{
+			++candidates[slots[pos].cand_id].second;
+			return slots[pos].cand_id;
+		}
+
+		uint32_t cand_id = static_cast<uint32_t>(candidates.size());
+		candidates.emplace_back(ref_id, 1);
+		slots[pos] = slot_t{ stamp, ref_id, cand_id };
+
+		if (2 * candidates.size() > slots.size()) //keep the load factor at most 0.5
+			resize(2 * slots.size());
+		return cand_id;
+	}
+
+	const std::vector<std::pair<uint32_t, uint32_t>>& GetCandidates() const
+	{
+		return candidates;
+	}
+
+	// Selects at most max_candidates positions (in candidates) of the reference reads with the highest numbers of hits,
+	// ties are resolved by lower read id, the result is sorted in this order
+	void GetTop(uint32_t max_candidates, std::vector<uint32_t>& top) const
+	{
+		top.resize(candidates.size());
+		for (uint32_t i = 0; i < top.size(); ++i)
+			top[i] = i;
+
+		auto better = [this](uint32_t x, uint32_t y) {
+			if (candidates[x].second != candidates[y].second)
+				return candidates[x].second > candidates[y].second;
+			return candidates[x].first < candidates[y].first;
+		};
+
+		if (top.size() > max_candidates)
+		{
+			std::nth_element(top.begin(), top.begin() + max_candidates, top.end(), better);
+			top.resize(max_candidates);
+		}
+		std::sort(top.begin(), top.end(), better);
+	}
+};
@@ -20,6 +20,7 @@
 #include "compression.h"
 #include "count_kmers.h"
 #include "in_reads.h"
+#include "input_spool.h"
 #include "reads_sim_graph.h"
 #include "encoder.h"
 #include "parallel_queue.h"
@@ -29,37 +30,63 @@
 #include "entr_qual.h"
 #include "entr_header.h"
 #include "archive.h"
+#include "archive_index.h"
 #include "ref_reads_accepter.h"
 #include "reference_genome.h"
+#include "md5_wrapper.h"
 #include <thread>
 #include <memory>
 #include <iostream>
 #include <filesystem>
+#include <algorithm>
 #include "timer.h"
 
 static std::mutex mtx_cerr;
 
-void adjustKmerAndAnchorLen(uint32_t& kmerLen, uint32_t& anchorLen, bool is_gzip_input, bool is_fastq, const std::string& filePath)
+void adjustKmerAndAnchorLen(uint32_t& kmerLen, uint32_t& anchorLen, bool is_fastq, const std::vector<std::string>& filePaths, const std::vector<uint8_t>& stdin_head, bool stdin_size_known)
 {
 	if (kmerLen && anchorLen) 
 		return;
 
-	ifstream tmp(filePath, ios::binary);
-	const auto begin = tmp.tellg();
-	tmp.seekg(0, ios::end);
-	uint64_t base_count = static_cast<uint64_t>(tmp.tellg() - begin);
-
-	if (is_gzip_input)
-		if (is_fastq)
-			base_count = static_cast<uint64_t>(2.08 * base_count);
+	uint64_t base_count = 0;
+	bool size_unknown = false;
+	for (const auto& filePath : filePaths)
+	{
+		uint64_t file_size;
+		bool is_gzip;
+		if (filePath == "-") //the size of the standard input is known only if it is shorter than its read ahead beginning
+		{
+			size_unknown |= !stdin_size_known;
+			file_size = stdin_head.size();
+			is_gzip = CInputFile::IsGzip(stdin_head.data(), stdin_head.size());
+		}
 		else
-			base_count = static_cast<uint64_t>(3.98 * base_count);
-	else
-		if (is_fastq)
-			base_count = static_cast<uint64_t>(0.49 * base_count);
+		{
+			ifstream tmp(filePath, ios::binary);
+			const auto begin = tmp.tellg();
+			tmp.seekg(0, ios::end);
+			file_size = static_cast<uint64_t>(tmp.tellg() - begin);
+			is_gzip = izGzipFile(filePath);
+		}
+
+		if (is_gzip)
+			if (is_fastq)
+				base_count += static_cast<uint64_t>(2.08 * file_size);
+			else
+				base_count += static_cast<uint64_t>(3.98 * file_size);
 		else
-			base_count = static_cast<uint64_t>(0.98 * base_count);
+			if (is_fastq)
+				base_count += static_cast<uint64_t>(0.49 * file_size);
+			else
+				base_count += static_cast<uint64_t>(0.98 * file_size);
+	}
 
+	if (size_unknown)
+	{
+		//too short k-mers for a large input cost more (many random hits) than too long ones for a small input
+		base_count = std::max<uint64_t>(base_count, 4'000'000'000ull);
+		std::cerr << "Warning: size of the standard input is unknown, k-mer and anchor lengths are chosen for at least 4G bases, they may be set with -k and -a\n";
+	}
 
 	if (base_count < 1'000'000'000ull)
 	{
@@ -166,8 +193,14 @@ void PrintParams(const CCompressorParams& params, uint32_t kmerLen, uint32_t anc
 {
 	std::cerr << " * * * * * * * * * * * * Parameters * * * * * * * * * * * * \n";
 	//std::cerr << "compression level: " << params.compressionLevel <<"\n";
-	std::cerr << "\t" << "input file path: " << params.inputFilePath << "\n";
+	for (const auto& path : params.inputFilePaths)
+		std::cerr << "\t" << "input file path: " << path << "\n";
 	std::cerr << "\t" << "output file path: " << params.outputFilePath << "\n";
+	std::cerr << "\t" << "tmp directory path: " << params.tmpDirPath << "\n";
+	if (!params.saveIndexPath.empty())
+		std::cerr << "\t" << "save index path: " << params.saveIndexPath << "\n";
+	if (!params.loadIndexPath.empty())
+		std::cerr << "\t" << "load index path: " << params.loadIndexPath << "\n";
 
 	std::cerr << "\t" << "number of threads: " << params.nThreads << "\n";
 
@@ -180,15 +213,20 @@ void PrintParams(const CCompressorParams& params, uint32_t kmerLen, uint32_t anc
 	std::cerr << "\t" << "header compression mode: " << headerComprModeToString(params.headerComprMode) << "\n";
 				 
 	std::cerr << "\t" << "max candidates: " << params.maxCandidates << "\n";
+	std::cerr << "\t" << "minimizer window: " << params.minimizerWindow << "\n";
 	std::cerr << "\t" << "min k-mer count: " << params.minKmerCount << "\n";
 	std::cerr << "\t" << "max k-mer count: " << params.maxKmerCount << "\n";
 	std::cerr << "\t" << "max matches multiplier: " << params.maxMatchesMultiplier << "\n";
+	std::cerr << "\t" << "max encode effort: " << params.maxEncodeEffort << "\n";
 	std::cerr << "\t" << "max recurence: " << params.maxRecurence << "\n";
 	std::cerr << "\t" << "min anchors: " << params.minAnchors << "\n";
 	std::cerr << "\t" << "min fraction of m-mers in encode: " << params.minFractionOfMmersInEncode << "\n";
 	std::cerr << "\t" << "min fraction of m-mers in encode to always encode: " << params.minFractionOfMmersInEncodeToAlwaysEncode << "\n";	
 	std::cerr << "\t" << "min part length to consider alternative reference read: " << params.minPartLenToConsiderAltRead << "\n";	
 	std::cerr << "\t" << "compression priority: " << compressionPriorityToString(params.priority) << "\n";
+	std::cerr << "\t" << "input spool mode: " << inputSpoolModeToString(params.inputSpoolMode) << "\n";
+	if (params.maxMemory)
+		std::cerr << "\t" << "max memory: " << params.maxMemory << "GB\n";
 	std::cerr << "\t" << "quality compression mode: " << qualityComprModeToString(params.qualityComprMode) << "\n";
 	std::cerr << "\t" << "quality thresholds: " << vec_to_string(params.qualityFwdThresholds) << "\n";
 	std::cerr << "\t" << "quality values: " << vec_to_string(params.qualityRevThresholds) << "\n";
@@ -196,8 +234,9 @@ void PrintParams(const CCompressorParams& params, uint32_t kmerLen, uint32_t anc
 	std::cerr << "\t" << "sparse mode exponent: " << params.sparseMode_exponent << "\n";
 	std::cerr << "\t" << "sparse mode range: " << params.sparseMode_range_symbols << "\n";
 
-	std::cerr << "\t" << "fill factor filtered k-mers: " << params.fillFactorFilteredKmers << "\n";
 	std::cerr << "\t" << "fill factor k-mers to reads: " << params.fillFactorKmersToReads << "\n";
+	std::cerr << "\t" << "DNA block size: " << params.dnaBlockSize << "\n";
+	std::cerr << "\t" << "quality block size: " << params.qualBlockSize << "\n";
 
 	if (params.refGenomePath != "")
 	{
@@ -225,21 +264,27 @@ ApproxSizes getApproxSizes(const CCompressorParams& params,
 	uint64_t tot_n_reads,
 	uint32_t n_ref_genome_pseudo_reads,
 	uint64_t mean_read_len,
+	ReferenceReadsMode reference_reads_mode,
 	uint32_t sparseMode_range,
 	double sparseMode_exponent,
 	double fill_factor_kmers_to_reads)
 {
 	ApproxSizes res;
-	auto approx_ref_reads = CalcApproxNRefReads(tot_n_reads, n_ref_genome_pseudo_reads, sparseMode_range, sparseMode_exponent);
+	uint64_t approx_ref_reads = tot_n_reads + n_ref_genome_pseudo_reads;
+	if (reference_reads_mode == ReferenceReadsMode::Sparse)
+		approx_ref_reads = CalcApproxNRefReads(tot_n_reads, n_ref_genome_pseudo_reads, sparseMode_range, sparseMode_exponent);
 
 	auto ref_reads_expected_size_bytes = approx_ref_reads * ((mean_read_len + 3) / 4 + 1 + sizeof(std::vector<read_t>)); //+ 1 for guard
 
-	uint32_t n_hash_tables = filtered_kmers.GetNHashTables();
+	uint32_t n_hash_tables = filtered_kmers.GetNPrefixes();
 
 	uint64_t kmers_to_reads_expected_size_bytes = 0;
+
+	//expected density of random minimizers is 2 / (w + 1)
+	double minimizers_fraction = params.minimizerWindow > 1 ? 2.0 / (params.minimizerWindow + 1) : 1.0;
 	
 #ifdef ESTIMATE_MEMORY_WITH_COUNTS_PER_PREFIX
-	auto n_reads_factor = double(approx_ref_reads) / (tot_n_reads + n_ref_genome_pseudo_reads);
+	auto n_reads_factor = minimizers_fraction * approx_ref_reads / (tot_n_reads + n_ref_genome_pseudo_reads);
 	for (uint32_t i = 0; i < n_hash_tables; ++i)
 	{
 		auto kmers_to_reads_expected_elems = filtered_kmers.GetCountsPerPrefix(i) * n_reads_factor;
@@ -248,7 +293,7 @@ ApproxSizes getApproxSizes(const CCompressorParams& params,
 	}
 #else
 	uint64_t tot_kmers_counts = filtered_kmers.GetTotalKmers();
-	auto kmers_to_reads_expected_elems = tot_kmers_counts * double(approx_ref_reads) / (tot_n_reads + n_ref_genome_pseudo_reads);
+	auto kmers_to_reads_expected_elems = tot_kmers_counts * minimizers_fraction * approx_ref_reads / (tot_n_reads + n_ref_genome_pseudo_reads);
 	kmers_to_reads_expected_elems = round_to_pow_of_2(kmers_to_reads_expected_elems * (1.0 / fill_factor_kmers_to_reads));
 	kmers_to_reads_expected_size_bytes = sizeof(kmers_to_reads_compacted_t::value_type) * kmers_to_reads_expected_elems;
 #endif
@@ -260,26 +305,64 @@ ApproxSizes getApproxSizes(const CCompressorParams& params,
 	return res;
 }
 
-uint64_t calcQueuesSize(bool is_fastq, uint32_t edit_script_for_qual_queue_size, uint32_t compressed_queue_size, uint32_t n_compression_threads, uint64_t mean_read_len, uint32_t maxCandidates, bool verbose)
+// Capacities of the queues between compression stages, may be reduced to fit in the memory limit
+struct QueuesDepths
 {
-	uint64_t reads_queue_bytes = (reads_queue_size // queue size
+	uint32_t reads = reads_queue_size;
+	uint32_t quals = quals_queue_size;
+	uint32_t headers = headers_queue_size;
+	uint32_t compress = compress_queue_size;
+	uint32_t edit_script_for_qual;
+	uint32_t compressed;
+
+	explicit QueuesDepths(uint32_t n_compression_threads) :
+		edit_script_for_qual(2 * n_compression_threads),
+		compressed(2 * n_compression_threads)
+	{
+	}
+
+	// Halves the depths, returns false if they are already minimal
+	bool Reduce()
+	{
+		const uint32_t min_depth = 2;
+		bool reduced = false;
+		for (uint32_t* depth : { &reads, &quals, &headers, &compress, &edit_script_for_qual, &compressed })
+			if (*depth > min_depth)
+			{
+				*depth = std::max(min_depth, *depth / 2);
+				reduced = true;
+			}
+		return reduced;
+	}
+};
+
+uint64_t calcQueuesSize(bool is_fastq, const QueuesDepths& depths, uint32_t n_compression_threads, uint64_t mean_read_len, uint32_t maxCandidates, bool verbose)
+{
+	uint64_t reads_queue_bytes = (depths.reads // queue size
 		+ 1 // one pack in reader
-		+ 1 // one pack in consumer -> similarity finder
+		+ 1 // one pack in consumer -> k-mers extraction in similarity finder
+		+ accepted_kmers_queue_size // packs with extracted k-mers
+		+ 1 // one pack processed by similarity finder
 		) * reads_pack_size;
 
-	uint64_t quals_queue_bytes = (quals_queue_size // queue size
+	uint64_t accepted_kmers_bytes = (1 // one pack in k-mers extraction in similarity finder
+		+ accepted_kmers_queue_size // packs with extracted k-mers
+		+ 1 // one pack processed by similarity finder
+		) * reads_pack_size * sizeof(kmer_type); //at most one accepted k-mer per base
+
+	uint64_t quals_queue_bytes = (depths.quals // queue size
 		+ 1 // one pack in readers
 		+ 1 // one pack in consumer -> qual entr
 		) * reads_pack_size; //pack size for reads and quals is the same
 
 
-	uint64_t headers_queue_bytes = (headers_queue_size //queue size
+	uint64_t headers_queue_bytes = (depths.headers //queue size
 		+ 1 // one pack in reader
 		+ 1 // one pack in consumer -> header entr
 		) * headers_pack_size;
 
 
-	uint64_t compress_queue_bytes = (compress_queue_size // queue size
+	uint64_t compress_queue_bytes = (depths.compress // queue size
 		+ 1 // one pack in similarity finder
 		+ n_compression_threads // n_compression_threads in CEncoder
 		) * (sizeof(CCompressPack) + sizeof(CCompressElem) + sizeof(uint32_t) * maxCandidates + reads_pack_size);
@@ -287,14 +370,14 @@ uint64_t calcQueuesSize(bool is_fastq, uint32_t edit_script_for_qual_queue_size,
 	//I assume a tuple size is 1.25 bytes, and for single read we need read_len tuples. It is not very accurate because there are anchors, skips etc.
 	double avg_compressed_pack_size = 1.25;
 
-	uint64_t es_queue_bytes = (compressed_queue_size + // queue size
+	uint64_t es_queue_bytes = (depths.compressed + // queue size
 		+ n_compression_threads // n_compression_threads in CEncoder
 		+ 1 // one in consumer -> read entr
 		) * avg_compressed_pack_size * reads_pack_size;
 
 	uint64_t es_queue_for_qual = 0;
 	if(is_fastq)
-		es_queue_for_qual = (edit_script_for_qual_queue_size + // queue size
+		es_queue_for_qual = (depths.edit_script_for_qual + // queue size
 			+n_compression_threads // n_compression_threads in CEncoder
 			+ 1 // one in consumer -> read entr
 			) * avg_compressed_pack_size * reads_pack_size;
@@ -302,6 +385,7 @@ uint64_t calcQueuesSize(bool is_fastq, uint32_t edit_script_for_qual_queue_size,
 	if (verbose)
 	{
 		std::cerr << "reads queue approx. size: " << reads_queue_bytes / 1024 << "KiB\n";
+		std::cerr << "accepted k-mers approx. size: " << accepted_kmers_bytes / 1024 << "KiB\n";
 		std::cerr << "quals queue approx. size: " << quals_queue_bytes / 1024 << "KiB\n";
 		std::cerr << "headers queue approx. size: " << headers_queue_bytes / 1024 << "KiB\n";
 		std::cerr << "compress queue approx. size: " << compress_queue_bytes / 1024 << "KiB\n";
@@ -309,38 +393,179 @@ uint64_t calcQueuesSize(bool is_fastq, uint32_t edit_script_for_qual_queue_size,
 		std::cerr << "es queue for qual approx. size: " << es_queue_for_qual / 1024 << "KiB\n";
 	}
 
-	return reads_queue_bytes + quals_queue_bytes + headers_queue_bytes + compress_queue_bytes + es_queue_bytes + es_queue_for_qual;
+	return reads_queue_bytes + accepted_kmers_bytes + quals_queue_bytes + headers_queue_bytes + compress_queue_bytes + es_queue_bytes + es_queue_for_qual;
 }
 
-void adjustMemorySparseMode(
+// Estimates the memory needed for compression, if the memory limit is given the settings are adjusted to fit in it
+// The adjustments are applied in the order of their impact on the compression ratio: shorter queues, denser k-mers to reads hash tables,
+// sparse reference reads mode, higher sparse mode exponent, shorter sparse mode range. If it is still not enough the compression is refused.
+void adjustMemorySettings(
 	const CCompressorParams& params,
+	bool is_fastq,
 	const CKmerFilter& filtered_kmers,
-	uint64_t tot_kmers_counts,
 	uint64_t tot_n_reads,
 	uint32_t n_ref_genome_pseudo_reads,
 	uint64_t mean_read_len,
-	uint64_t queuesApproxSize,
-	
+	uint32_t n_compression_threads,
+	QueuesDepths& queues_depths,
+	ReferenceReadsMode& reference_reads_mode,
 	uint32_t& sparseMode_range, double& sparseMode_exponent,
 	double& fill_factor_kmers_to_reads)
 {
 	uint64_t filtered_kmers_bytes = filtered_kmers.GetMemoryUsage();
-	
-	ApproxSizes ref_reads_and_graph = getApproxSizes(params, filtered_kmers, tot_n_reads, n_ref_genome_pseudo_reads, mean_read_len, sparseMode_range, sparseMode_exponent, fill_factor_kmers_to_reads);
+	//banded aligners of the encoders may hold their largest band during an alignment
+	uint64_t aligners_bytes = n_compression_threads * CBandedAligner::MaxMemoryUsage();
+
+	auto calc_total = [&](uint64_t& queues_bytes, ApproxSizes& ref_reads_and_graph) {
+		queues_bytes = calcQueuesSize(is_fastq, queues_depths, n_compression_threads, mean_read_len, params.maxCandidates, false);
+		ref_reads_and_graph = getApproxSizes(params, filtered_kmers, tot_n_reads, n_ref_genome_pseudo_reads, mean_read_len,
+			reference_reads_mode, sparseMode_range, sparseMode_exponent, fill_factor_kmers_to_reads);
+		return queues_bytes + filtered_kmers_bytes + ref_reads_and_graph.ref_reads_bytes + ref_reads_and_graph.kmers_to_reads_bytes + aligners_bytes;
+	};
+
+	uint64_t queuesApproxSize;
+	ApproxSizes ref_reads_and_graph;
+	uint64_t approx_total_memory = calc_total(queuesApproxSize, ref_reads_and_graph);
+
+	if (params.maxMemory)
+	{
+		const double max_fill_factor_kmers_to_reads = 0.9;
+		//with exponent 2 the number of reference reads no longer grows with the input size (the series converges)
+		const double max_sparseMode_exponent = 2.0;
+		//some margin is left for the structures not included in the estimation (threads stacks, compression buffers, etc.)
+		uint64_t budget = static_cast<uint64_t>(0.9 * params.maxMemory * (1ull << 30));
 
-	uint64_t approx_total_memory = queuesApproxSize + filtered_kmers_bytes + ref_reads_and_graph.ref_reads_bytes + ref_reads_and_graph.kmers_to_reads_bytes;
+		while (approx_total_memory > budget)
+		{
+			if (queues_depths.Reduce())
+				;	//shorter queues do not affect the compression ratio
+			else if (fill_factor_kmers_to_reads < max_fill_factor_kmers_to_reads)
+				fill_factor_kmers_to_reads = max_fill_factor_kmers_to_reads;
+			else if (reference_reads_mode == ReferenceReadsMode::All)
+				reference_reads_mode = ReferenceReadsMode::Sparse;
+			else if (sparseMode_exponent < max_sparseMode_exponent)
+				sparseMode_exponent = std::min(max_sparseMode_exponent, sparseMode_exponent + 0.25);
+			else if (sparseMode_range > 1)
+				sparseMode_range = std::max(1u, static_cast<uint32_t>(sparseMode_range * 3ull / 4));
+			else
+			{
+				std::cerr << "Error: compression requires approx. " << approx_total_memory / 1024 / 1024 << "MiB of memory, which exceeds the limit (--max-memory " << params.maxMemory << ")\n";
+				exit(1);
+			}
+			approx_total_memory = calc_total(queuesApproxSize, ref_reads_and_graph);
+		}
+	}
 
 	if (params.verbose)
 	{
+		calcQueuesSize(is_fastq, queues_depths, n_compression_threads, mean_read_len, params.maxCandidates, true);
 		std::cerr << "queues approx size: " << queuesApproxSize / 1024 / 1024 << "MiB\n";
 		std::cerr << "filtered kmers size: " << filtered_kmers_bytes / 1024 / 1024 << "MiB\n";
 		std::cerr << "ref reads expected size: " << ref_reads_and_graph.ref_reads_bytes / 1024 / 1024 << "MiB\n";
 		std::cerr << "kmers to reads expected size: " << ref_reads_and_graph.kmers_to_reads_bytes / 1024 / 1024 << "MiB\n";
+		std::cerr << "banded aligners max size: " << aligners_bytes / 1024 / 1024 << "MiB\n";
 		std::cerr << "approx total memory: " << approx_total_memory / 1024 / 1024 << "MiB\n";
 	}
-
 }
 
+// Header of the index stored with --save-index, the filtered k-mers follow it.
+// Candidates of similar reads are not stored, they are searched again in each compression
+struct KmersIndexHeader
+{
+	static constexpr char magic[] = "CoLoRd-index";
+	static constexpr uint32_t version = 3;
+	static constexpr uint32_t digest_size = 16;
+	static constexpr uint32_t max_inputs = 1u << 20; // sanity limit for a corrupted header
+
+	// settings and input the index was built for
+	uint32_t kmer_len{};
+	uint32_t min_kmer_count{};
+	uint32_t max_kmer_count{};
+	uint32_t filter_hash_modulo{};
+	uint64_t ref_genome_len{}; // 0 if reference genome is not used
+	std::vector<uint64_t> input_sizes;
+	std::vector<std::vector<uint8_t>> input_digests; // md5 of the (decompressed) inputs, calculated while they are read
+	std::vector<uint8_t> ref_genome_digest; // md5 of the reference genome sequences, if it is used
+	std::streamoff input_digests_pos{}; // position of the input digests in the stored index, they are known only after the input is read
+
+	// stats of the input from the k-mer counter (reference genome included)
+	uint32_t tot_n_reads{};
+	uint64_t tot_kmers{};
+	uint64_t n_uniq_counted_kmers{};
+
+	void Store(std::ostream& out)
+	{
+		out.write(magic, sizeof(magic));
+		StoreLittleEndian(out, version);
+		StoreLittleEndian(out, kmer_len);
+		StoreLittleEndian(out, min_kmer_count);
+		StoreLittleEndian(out, max_kmer_count);
+		StoreLittleEndian(out, filter_hash_modulo);
+		StoreLittleEndian(out, ref_genome_len);
+		StoreLittleEndian(out, static_cast<uint32_t>(input_sizes.size()));
+		for (auto size : input_sizes)
+			StoreLittleEndian(out, size);
+		StoreLittleEndian(out, static_cast<uint32_t>(input_digests.size()));
+		input_digests_pos = out.tellp();
+		for (const auto& digest : input_digests)
+			out.write(reinterpret_cast<const char*>(digest.data()), digest_size);
+		if (ref_genome_len)
+			out.write(reinterpret_cast<const char*>(ref_genome_digest.data()), digest_size);
+		StoreLittleEndian(out, tot_n_reads);
+		StoreLittleEndian(out, tot_kmers);
+		StoreLittleEndian(out, n_uniq_counted_kmers);
+	}
+
+	bool Load(std::istream& in)
+	{
+		char stored_magic[sizeof(magic)];
+		uint32_t stored_version;
+		in.read(stored_magic, sizeof(magic));
+		LoadLittleEndian(in, stored_version);
+		if (!in || memcmp(stored_magic, magic, sizeof(magic)) || stored_version != version)
+			return false;
+		LoadLittleEndian(in, kmer_len);
+		LoadLittleEndian(in, min_kmer_count);
+		LoadLittleEndian(in, max_kmer_count);
+		LoadLittleEndian(in, filter_hash_modulo);
+		LoadLittleEndian(in, ref_genome_len);
+		uint32_t n_inputs;
+		LoadLittleEndian(in, n_inputs);
+		if (!in)
+			return false;
+		if (n_inputs > max_inputs)
+			return false;
+		input_sizes.resize(n_inputs);
+		for (auto& size : input_sizes)
+			LoadLittleEndian(in, size);
+		uint32_t n_digests;
+		LoadLittleEndian(in, n_digests);
+		if (!in || n_digests != n_inputs)
+			return false;
+		input_digests.assign(n_digests, std::vector<uint8_t>(digest_size));
+		for (auto& digest : input_digests)
+			in.read(reinterpret_cast<char*>(digest.data()), digest_size);
+		ref_genome_digest.clear();
+		if (ref_genome_len)
+		{
+			ref_genome_digest.resize(digest_size);
+			in.read(reinterpret_cast<char*>(ref_genome_digest.data()), digest_size);
+		}
+		LoadLittleEndian(in, tot_n_reads);
+		LoadLittleEndian(in, tot_kmers);
+		LoadLittleEndian(in, n_uniq_counted_kmers);
+		return static_cast<bool>(in);
+	}
+
+	// Input digests are not compared, the inputs are verified while they are read for the compression
+	bool SameSettingsAndInputSizes(const KmersIndexHeader& rhs) const
+	{
+		return kmer_len == rhs.kmer_len && min_kmer_count == rhs.min_kmer_count && max_kmer_count == rhs.max_kmer_count &&
+			filter_hash_modulo == rhs.filter_hash_modulo && ref_genome_len == rhs.ref_genome_len && input_sizes == rhs.input_sizes &&
+			ref_genome_digest == rhs.ref_genome_digest;
+	}
+};
+
 void runCompression(const CCompressorParams& params, CInfo& info)
 {
 	info.version_major = version_major;
@@ -359,22 +584,84 @@ void runCompression(const CCompressorParams& params, CInfo& info)
 	
 	int s_meta = archive.RegisterStream("meta");
 
-	bool is_gzip_input = izGzipFile(params.inputFilePath);
-	bool is_fastq = isFastq(params.inputFilePath);
+	//standard input and spooled records are kept in a separate tmp dir, as k-mer counter tmp dir is removed just after k-mers are filtered
+	std::string input_tmp_dir_path;
+	auto get_input_tmp_dir = [&input_tmp_dir_path, &params] {
+		if (input_tmp_dir_path == "")
+			input_tmp_dir_path = create_tmp_dir(params.tmpDirPath);
+		return input_tmp_dir_path;
+	};
+
+	std::vector<std::string> input_paths = params.inputFilePaths;
+
+	//the beginning of the standard input is read ahead to recognize its format
+	std::vector<uint8_t> stdin_head;
+	bool stdin_size_known = false;
+	bool has_stdin = std::find(input_paths.begin(), input_paths.end(), "-") != input_paths.end();
+	if (has_stdin)
+		stdin_size_known = CInputFile::ReadStdinHead(stdin_head);
+
+	auto recognize_format = [&stdin_head](const std::string& path, bool& is_gzip, bool& is_bgzf, bool& is_bam, bool& is_fastq) {
+		if (path == "-")
+		{
+			auto head = CInputFile::PeekInflated(stdin_head, 4);
+			is_gzip = CInputFile::IsGzip(stdin_head.data(), stdin_head.size());
+			is_bgzf = is_gzip && CInputFile::IsBgzf(stdin_head.data(), stdin_head.size());
+			is_bam = head.size() == 4 && memcmp(head.data(), "BAM\1", 4) == 0;
+			is_fastq = is_bam || (!head.empty() && head[0] == '@');
+		}
+		else
+		{
+			is_gzip = izGzipFile(path);
+			is_bgzf = is_gzip && CInputFile::IsBgzfFile(path);
+			is_bam = isBam(path);
+			is_fastq = is_bam || isFastq(path);
+		}
+	};
+
+	//BAM records are compressed as FASTQ
+	bool is_gzip_input = false, is_bgzf_input = false;
+	bool is_bam = false, is_fastq = false;
+	for (size_t i = 0; i < input_paths.size(); ++i)
+	{
+		bool is_gzip, is_bgzf, is_bam_file, is_fastq_file;
+		recognize_format(input_paths[i], is_gzip, is_bgzf, is_bam_file, is_fastq_file);
+		is_gzip_input |= is_gzip;
+		is_bgzf_input |= is_bgzf;
+		if (i == 0)
+		{
+			is_bam = is_bam_file;
+			is_fastq = is_fastq_file;
+		}
+		else if (is_bam_file != is_bam || is_fastq_file != is_fastq)
+		{
+			std::cerr << "Error: all input files must be in the same format (FASTQ, FASTA or BAM), " << input_paths[i] << " differs from " << input_paths.front() << "\n";
+			exit(1);
+		}
+	}
 
 	if (params.verbose)
 	{
-		if (is_gzip_input)
+		if (is_bam)
+			std::cerr << "input is BAM\n";
+		else if (is_bgzf_input)
+			std::cerr << "input is gzipped (BGZF)\n";
+		else if (is_gzip_input)
 			std::cerr << "input is gzipped\n";
 		else
 			std::cerr << "input is not gzipped\n";
 	}
 	uint32_t input_reader_threads = is_gzip_input;
+	//blocks of BGZF input are inflated in parallel
+	uint32_t input_inflate_threads = is_bgzf_input ? std::max(1u, std::min(params.nThreads / 4, 8u)) : 1;
+	//parsing of the input is split between a few threads only for a large number of threads, otherwise a single parser is enough to keep up with the compression
+	uint32_t input_parser_threads = std::max(1u, std::min(params.nThreads / 8, 4u));
 	uint32_t entropy_compr_threads = 1 + (is_fastq && params.qualityComprMode != QualityComprMode::None);
 
 	uint32_t similarity_threads = 1; 
 
-	int n_compression_threads = params.nThreads - input_reader_threads - entropy_compr_threads - similarity_threads;
+	//the reader thread inflates BGZF blocks together with input_inflate_threads - 1 workers
+	int n_compression_threads = params.nThreads - input_reader_threads - (input_inflate_threads - 1) - (input_parser_threads - 1) - entropy_compr_threads - similarity_threads;
 	if (n_compression_threads < 1)
 		n_compression_threads = 1;
 
@@ -387,53 +674,200 @@ void runCompression(const CCompressorParams& params, CInfo& info)
 	}
 
 
+	//with loaded index k-mers are not counted, so neither k-mer counter inputs nor spool are needed
+	bool load_index = !params.loadIndexPath.empty();
+	bool save_index = !params.saveIndexPath.empty();
+
+	//records parsed while k-mers are counted are kept, so the input is not read and parsed again
+	InputSpoolMode spool_mode = load_index ? InputSpoolMode::None : params.inputSpoolMode;
+	//standard input can be read only once, with the spool it is passed directly to the k-mer counter
+	if (spool_mode == InputSpoolMode::Auto)
+		spool_mode = (is_gzip_input || has_stdin) && !is_bam ? InputSpoolMode::Disk : InputSpoolMode::None;
+	if (spool_mode != InputSpoolMode::None && is_bam)
+	{
+		//k-mer counter decodes BAM in its own way, the records are not passed to the observer
+		std::cerr << "Warning: --spool is not supported for BAM input, the input will be read twice\n";
+		spool_mode = InputSpoolMode::None;
+	}
+	if (spool_mode == InputSpoolMode::Memory && params.maxMemory)
+	{
+		std::cerr << "Warning: --spool memory is not used with --max-memory, disk will be used instead\n";
+		spool_mode = InputSpoolMode::Disk;
+	}
+
+	//k-mer counter gets the limit (in full GBs) without the spool parser running concurrently with it,
+	//the compression structures are created after it finishes
+	uint32_t kmc_max_ram_gb = 0;
+	if (params.maxMemory)
+	{
+		double spool_parser_gb = spool_mode != InputSpoolMode::None ? static_cast<double>(CInputParser::EstimateMemory(input_parser_threads)) / (1ull << 30) : 0.0;
+		if (spool_mode != InputSpoolMode::None && params.maxMemory - spool_parser_gb < 1.0)
+		{
+			if (params.inputSpoolMode != InputSpoolMode::Auto)
+				std::cerr << "Warning: --max-memory is too low to spool the input while counting k-mers, the input will be read twice\n";
+			spool_mode = InputSpoolMode::None;
+			spool_parser_gb = 0.0;
+		}
+		//k-mer counter keeps the beginning of the standard input it reads for the signatures statistics to read it again
+		double stdin_replay_gb = has_stdin && spool_mode != InputSpoolMode::None ? 0.25 : 0.0;
+		kmc_max_ram_gb = std::max(1u, static_cast<uint32_t>(params.maxMemory - spool_parser_gb - stdin_replay_gb));
+	}
+
+	//without the spool (or with the index saved, as its input sizes are needed) the standard input is stored in a file
+	if (has_stdin && (spool_mode == InputSpoolMode::None || save_index))
+	{
+		for (auto& path : input_paths)
+			if (path == "-")
+				path = CInputFile::StoreStdin(get_input_tmp_dir(), stdin_head);
+		has_stdin = false;
+		std::vector<uint8_t>().swap(stdin_head);
+	}
+
 	uint32_t kmerLen = params.kmerLen;
 	uint32_t anchorLen = params.anchorLen;
 
-	adjustKmerAndAnchorLen(kmerLen, anchorLen, is_gzip_input, is_fastq, params.inputFilePath);
+	adjustKmerAndAnchorLen(kmerLen, anchorLen, is_fastq, input_paths, stdin_head, stdin_size_known);
 	if (params.verbose)	
 		PrintParams(params, kmerLen, anchorLen);	
 
-	auto tmp_dir_path = create_tmp_dir(std::filesystem::path(params.outputFilePath).remove_filename().string());
+	auto tmp_dir_path = create_tmp_dir(params.tmpDirPath);
 
-	std::string kmersDbPath = (std::filesystem::path(tmp_dir_path) / std::filesystem::path(params.inputFilePath).filename()).string() + "." + std::to_string(kmerLen) + "mers";
+	std::string kmersDbName = input_paths.front() == "-" ? "stdin" : std::filesystem::path(input_paths.front()).filename().string();
+	std::string kmersDbPath = (std::filesystem::path(tmp_dir_path) / kmersDbName).string() + "." + std::to_string(kmerLen) + "mers";
 	
 	bool ref_genome_available = params.refGenomePath != "";
 	
-	std::string kmcInputPath = params.inputFilePath;
+	std::vector<std::string> kmc_input_paths = input_paths;
 	std::unique_ptr<CReferenceGenome> ref_genome;
 	
 	uint32_t ref_genome_overlap_size = (kmerLen - 1) * 10;
 	uint32_t ref_genome_read_len{};
 	if (ref_genome_available)
 	{
-		bool calc_checksum = !params.storeRefGenome;
+		bool calc_checksum = !params.storeRefGenome || load_index || save_index;
 		ref_genome = std::make_unique<CReferenceGenome>(params.refGenomePath, ref_genome_overlap_size, calc_checksum, params.verbose);
 		std::string refGenomeKmcPath = "refGen.fa";
-		if(is_fastq)
+		if (is_bam)
+			refGenomeKmcPath = "refGen.bam";
+		else if(is_fastq)
 			refGenomeKmcPath = "refGen.fq";
 
 		refGenomeKmcPath = (std::filesystem::path(tmp_dir_path) / std::filesystem::path(refGenomeKmcPath)).string();
-		ref_genome->Store(refGenomeKmcPath, is_fastq);
+		if (!load_index)
+		{
+			if (is_bam) //k-mer counter requires all the inputs in the same format
+				ref_genome->StoreBam(refGenomeKmcPath);
+			else
+				ref_genome->Store(refGenomeKmcPath, is_fastq);
+		}
 		if(params.storeRefGenome)
 			ref_genome->Store(archive);
-		std::string newKmcInputPath = (std::filesystem::path(tmp_dir_path) / std::filesystem::path("kmc_file_list.txt")).string();
-		std::ofstream newKmcInput(newKmcInputPath);
-		if (!newKmcInput)
+		kmc_input_paths.push_back(refGenomeKmcPath);
+	}
+
+	KmersIndexHeader index_header;
+	index_header.kmer_len = kmerLen;
+	index_header.min_kmer_count = params.minKmerCount;
+	index_header.max_kmer_count = params.maxKmerCount;
+	index_header.filter_hash_modulo = params.filterHashModulo;
+	index_header.ref_genome_len = ref_genome_available ? ref_genome->GetTotSeqsLen() : 0;
+	if (load_index || save_index)
+	{
+		for (const auto& path : input_paths)
+			index_header.input_sizes.push_back(std::filesystem::file_size(path));
+		if (ref_genome_available)
+			index_header.ref_genome_digest = ref_genome->GetChecksum();
+	}
+	//digests of the whole inputs, calculated while the inputs are read (by the k-mer counter if the input is spooled)
+	std::vector<std::vector<uint8_t>> input_digests;
+
+	std::ifstream index_in;
+	if (load_index)
+	{
+		index_in = inOpenOrDie(params.loadIndexPath, std::ios::binary);
+		KmersIndexHeader stored_header;
+		if (!stored_header.Load(index_in))
 		{
-			std::cerr << "Error: cannot open file: " << newKmcInputPath << "\n";
+			std::cerr << "Error: " << params.loadIndexPath << " is not a valid index file\n";
 			exit(1);
 		}
-		newKmcInput << kmcInputPath << "\n";
-		newKmcInput << refGenomeKmcPath << "\n";
-		kmcInputPath = "@" + newKmcInputPath;
+		if (!stored_header.SameSettingsAndInputSizes(index_header))
+		{
+			std::cerr << "Error: index " << params.loadIndexPath << " was built for a different input or different k-mer settings (-k, -L, -H, -f, -G)\n";
+			exit(1);
+		}
+		index_header = stored_header;
 	}
 
-	CKmerCounter kmer_counter(kmerLen, params.minKmerCount, params.maxKmerCount, params.nThreads, params.filterHashModulo, kmcInputPath, kmersDbPath, tmp_dir_path, is_fastq, params.verbose);
-	auto tot_n_reads = kmer_counter.GetNReads();
+	std::unique_ptr<CInputSpool> spool;
+	std::unique_ptr<CInputParser> spool_parser;
+	std::function<void(const uint8_t*, uint64_t, bool)> kmc_input_observer;
+	if (spool_mode != InputSpoolMode::None)
+	{
+		bool in_memory = spool_mode == InputSpoolMode::Memory;
+		spool = std::make_unique<CInputSpool>(in_memory, in_memory ? "" : get_input_tmp_dir());
+		spool_parser = std::make_unique<CInputParser>(input_parser_threads, [&spool](CParsedReads& chunk) { spool->Write(chunk); });
+
+		//k-mer counter reads the input files in the given order, with reference genome it gets also the reference genome file (last), which must not be spooled
+		kmc_input_observer = [&spool, &spool_parser, &input_digests, save_index, md5 = CMD5(), n_files_left = input_paths.size()](const uint8_t* data, uint64_t size, bool end_of_file) mutable {
+			if (!n_files_left)
+				return;
+			spool->AddInputBytes(size);
+			spool_parser->Add(data, size);
+			if (save_index)
+				md5.Update(data, size);
+			if (end_of_file)
+			{
+				spool_parser->EndFile();
+				if (save_index)
+				{
+					input_digests.push_back(md5.Get());
+					md5 = CMD5();
+				}
+				--n_files_left;
+			}
+		};
+	}
+
+	//filtered k-mers are passed directly from the k-mer counter, unless the memory is limited (then they are kept in the kmc database on disk)
+	std::unique_ptr<CFilteredKmersBins> filtered_kmers_bins;
+	if (!load_index)
+	{
+		std::string kmcInputPath = kmc_input_paths.front();
+		//"-" would be taken for an option by the k-mer counter
+		if (kmc_input_paths.size() > 1 || has_stdin)
+		{
+			std::string newKmcInputPath = (std::filesystem::path(tmp_dir_path) / std::filesystem::path("kmc_file_list.txt")).string();
+			std::ofstream newKmcInput(newKmcInputPath);
+			if (!newKmcInput)
+			{
+				std::cerr << "Error: cannot open file: " << newKmcInputPath << "\n";
+				exit(1);
+			}
+			for (const auto& path : kmc_input_paths)
+				newKmcInput << path << "\n";
+			kmcInputPath = "@" + newKmcInputPath;
+		}
+
+		if (!params.maxMemory)
+			filtered_kmers_bins = std::make_unique<CFilteredKmersBins>(kmerLen);
+		CKmerCounter kmer_counter(kmerLen, params.minKmerCount, params.maxKmerCount, params.nThreads, params.filterHashModulo, kmcInputPath, kmersDbPath, tmp_dir_path, is_fastq, is_bam, kmc_max_ram_gb, params.verbose, kmc_input_observer, filtered_kmers_bins.get(), std::move(stdin_head));
+		if (spool)
+		{
+			spool_parser->Finish();
+			spool_parser.reset();
+			spool->FinishWriting();
+			if (params.verbose)
+				std::cerr << "input spool size: " << spool->GetSize() / 1024 / 1024 << "MiB\n";
+		}
+		index_header.tot_n_reads = kmer_counter.GetNReads();
+		index_header.tot_kmers = kmer_counter.GetTotKmers();
+		index_header.n_uniq_counted_kmers = kmer_counter.GetNUniqueCounted();
+	}
+	auto tot_n_reads = index_header.tot_n_reads;
 	
-	auto tot_kmers = kmer_counter.GetTotKmers();
-	auto n_uniq_counted_kmers = kmer_counter.GetNUniqueCounted();
+	auto tot_kmers = index_header.tot_kmers;
+	auto n_uniq_counted_kmers = index_header.n_uniq_counted_kmers;
 	std::cerr << "\n";
 	if(params.verbose)
 	{
@@ -461,7 +895,24 @@ void runCompression(const CCompressorParams& params, CInfo& info)
 
 	std::cerr << "Filtering k-mers.\n";
 	timer.Start();
-	CKmerFilter filtered_kmers(kmersDbPath, params.filterHashModulo, kmerLen, n_uniq_counted_kmers, params.fillFactorFilteredKmers, params.verbose);
+	CKmerFilter filtered_kmers = load_index ? CKmerFilter(index_in, params.filterHashModulo, kmerLen, params.verbose) :
+		filtered_kmers_bins ? CKmerFilter(*filtered_kmers_bins, params.filterHashModulo, kmerLen, params.nThreads, params.verbose) :
+		CKmerFilter(kmersDbPath, params.filterHashModulo, kmerLen, params.nThreads, params.verbose);
+	filtered_kmers_bins.reset();
+	index_in.close();
+	if (save_index)
+	{
+		//the input digests are stored when the input is read
+		index_header.input_digests.assign(input_paths.size(), std::vector<uint8_t>(KmersIndexHeader::digest_size));
+		auto index_out = outOpenOrDie(params.saveIndexPath, std::ios::binary);
+		index_header.Store(index_out);
+		filtered_kmers.Serialize(index_out);
+		if (!index_out)
+		{
+			std::cerr << "Error: cannot write index " << params.saveIndexPath << "\n";
+			exit(1);
+		}
+	}
 	std::error_code ec;
 	std::filesystem::remove_all(tmp_dir_path, ec);
 	if (ec)
@@ -472,30 +923,6 @@ void runCompression(const CCompressorParams& params, CInfo& info)
 	if(params.verbose)
 		timer.Log(std::cerr);
 
-	uint32_t edit_script_for_qual_queue_size = 2 * n_compression_threads;
-	uint32_t compressed_queue_size = 2 * n_compression_threads;
-
-	CQueueMonitor queue_monitor(std::cerr, false, true);		// output_stream, single_line, report
-//	CQueueMonitor queue_monitor(std::cerr, false, false);		// output_stream, single_line, report
-
-	queue_monitor.register_queue(0, "reads_queue", reads_queue_size);
-	queue_monitor.register_queue(1, "quals_queue", quals_queue_size);
-	queue_monitor.register_queue(2, "headers_queue", headers_queue_size);
-	queue_monitor.register_queue(3, "edit_script_for_qual_queue", edit_script_for_qual_queue_size);
-	queue_monitor.register_queue(4, "compress_queue", compress_queue_size);
-	queue_monitor.register_queue(5, "compressed_queue", compressed_queue_size);
-
-	CParallelQueue<read_pack_t> reads_queue(reads_queue_size, 1, &queue_monitor, 0);
-	CParallelQueue<qual_pack_t> quals_queue(quals_queue_size, 1, &queue_monitor, 1);
-	CParallelQueue<header_pack_t> headers_queue(headers_queue_size, 1, &queue_monitor, 2);
-
-//	CParallelQueue<std::vector<es_t>> edit_script_for_qual_queue(edit_script_for_qual_queue_size, 1, &queue_monitor, 3);
-	CParallelPriorityQueue<std::vector<es_t>> edit_script_for_qual_queue(edit_script_for_qual_queue_size, n_compression_threads, &queue_monitor, 3);
-
-	CParallelQueuePopWaiting<CCompressPack> compress_queue(compress_queue_size, &queue_monitor, 4);
-	
-	CParallelPriorityQueue<std::vector<es_t>> compressed_queue(compressed_queue_size, n_compression_threads, &queue_monitor, 5);
-
 	uint32_t tot_ref_reads = tot_n_reads;
 	
 	uint32_t sparseMode_range = static_cast<uint32_t>((params.sparseMode_range_symbols * n_uniq_counted_kmers * params.filterHashModulo) / mean_read_len);
@@ -512,27 +939,51 @@ void runCompression(const CCompressorParams& params, CInfo& info)
 
 	tot_ref_reads += n_ref_genome_pseudo_reads;
 
-	if (params.referenceReadsMode == ReferenceReadsMode::Sparse)
+	QueuesDepths queues_depths(n_compression_threads);
+	ReferenceReadsMode reference_reads_mode = params.referenceReadsMode;
+
+	if (reference_reads_mode == ReferenceReadsMode::Sparse || params.maxMemory)
 	{
-		auto queuesApproxSize = calcQueuesSize(is_fastq, edit_script_for_qual_queue_size, compressed_queue_size, n_compression_threads,
-			mean_read_len, params.maxCandidates, params.verbose);
-		adjustMemorySparseMode(params, filtered_kmers, filtered_kmers.GetTotalKmers(), tot_n_reads, n_ref_genome_pseudo_reads, mean_read_len, queuesApproxSize,
-			sparseMode_range, sparseMode_exponent, fill_factor_kmers_to_reads);
-#ifdef ESTIMATE_MEMORY_WITH_COUNTS_PER_PREFIX
-		filtered_kmers.ReleaseCountsPerPrefix();
-#endif
+		adjustMemorySettings(params, is_fastq, filtered_kmers, tot_n_reads, n_ref_genome_pseudo_reads, mean_read_len, n_compression_threads,
+			queues_depths, reference_reads_mode, sparseMode_range, sparseMode_exponent, fill_factor_kmers_to_reads);
 		if (params.verbose)
 		{
 			std::cerr << "adjusted memory related settings:\n";
+			std::cerr << "\tqueues depths (reads, quals, headers, compress, es for qual, compressed): " << queues_depths.reads << ", " << queues_depths.quals << ", "
+				<< queues_depths.headers << ", " << queues_depths.compress << ", " << queues_depths.edit_script_for_qual << ", " << queues_depths.compressed << "\n";
+			std::cerr << "\treference reads mode: " << referenceReadsModeToString(reference_reads_mode) << "\n";
 			std::cerr << "\tfill_factor_kmers_to_reads: " << fill_factor_kmers_to_reads << "\n";
 			std::cerr << "\tsparseMode_range: " << sparseMode_range << "\n";
 			std::cerr << "\tsparseMode_exponent: " << sparseMode_exponent << "\n";
-
 		}
 	}
+#ifdef ESTIMATE_MEMORY_WITH_COUNTS_PER_PREFIX
+	filtered_kmers.ReleaseCountsPerPrefix();
+#endif
+
+	CQueueMonitor queue_monitor(std::cerr, false, true);		// output_stream, single_line, report
+//	CQueueMonitor queue_monitor(std::cerr, false, false);		// output_stream, single_line, report
+
+	queue_monitor.register_queue(0, "reads_queue", queues_depths.reads);
+	queue_monitor.register_queue(1, "quals_queue", queues_depths.quals);
+	queue_monitor.register_queue(2, "headers_queue", queues_depths.headers);
+	queue_monitor.register_queue(3, "edit_script_for_qual_queue", queues_depths.edit_script_for_qual);
+	queue_monitor.register_queue(4, "compress_queue", queues_depths.compress);
+	queue_monitor.register_queue(5, "compressed_queue", queues_depths.compressed);
+
+	CParallelQueue<read_pack_t> reads_queue(queues_depths.reads, 1, &queue_monitor, 0);
+	CParallelQueue<qual_pack_t> quals_queue(queues_depths.quals, 1, &queue_monitor, 1);
+	CParallelQueue<header_pack_t> headers_queue(queues_depths.headers, 1, &queue_monitor, 2);
 
-	CRefReadsAccepter ref_reads_accepter(sparseMode_range, sparseMode_exponent, n_ref_genome_pseudo_reads);
-	if (params.referenceReadsMode == ReferenceReadsMode::Sparse)
+//	CParallelQueue<std::vector<es_t>> edit_script_for_qual_queue(queues_depths.edit_script_for_qual, 1, &queue_monitor, 3);
+	CParallelPriorityQueue<std::vector<es_t>> edit_script_for_qual_queue(queues_depths.edit_script_for_qual, n_compression_threads, &queue_monitor, 3);
+
+	CParallelQueuePopWaiting<CCompressPack> compress_queue(queues_depths.compress, &queue_monitor, 4);
+	
+	CParallelPriorityQueue<std::vector<es_t>> compressed_queue(queues_depths.compressed, n_compression_threads, &queue_monitor, 5);
+
+	CRefReadsAccepter ref_reads_accepter(sparseMode_range, sparseMode_exponent, n_ref_genome_pseudo_reads, params.dnaBlockSize != 0);
+	if (reference_reads_mode == ReferenceReadsMode::Sparse)
 	{
 		if(params.verbose)
 			std::cerr << "sparse mode range in reads: " << sparseMode_range << "\n";
@@ -541,17 +992,28 @@ void runCompression(const CCompressorParams& params, CInfo& info)
 
 	CReferenceReads reference_reads(tot_ref_reads);
 
+	CArchiveIndex archive_index;
+
 	CTimeCollector tc(is_fastq);
 
 	uint64_t total_symb_header;
-	std::thread reader([&params, &reads_queue, &quals_queue, &headers_queue, &tc, &info, &total_symb_header]{
+	std::thread reader([&params, &reads_queue, &quals_queue, &headers_queue, &tc, &info, &total_symb_header, &spool, &input_paths, &input_digests, load_index, save_index, input_parser_threads, input_inflate_threads]{
 #ifdef MEASURE_THREADS_TIMES
 		CThreadWatch tw;
 		tw.startTimer();
 #endif
 
-		CInputReads reads(params.verbose, params.inputFilePath, reads_queue, quals_queue, headers_queue);
-		reads.GetStats(info.total_bytes, info.total_bases, total_symb_header);
+		if (spool)
+		{
+			CInputReads reads(params.verbose, *spool, reads_queue, quals_queue, headers_queue);
+			reads.GetStats(info.total_bytes, info.total_bases, total_symb_header);
+		}
+		else
+		{
+			CInputReads reads(params.verbose, input_paths, reads_queue, quals_queue, headers_queue, input_parser_threads, input_inflate_threads, load_index || save_index);
+			reads.GetStats(info.total_bytes, info.total_bases, total_symb_header);
+			input_digests = reads.GetInputDigests();
+		}
 
 #ifdef MEASURE_THREADS_TIMES
 		tw.stopTimer();
@@ -562,7 +1024,7 @@ void runCompression(const CCompressorParams& params, CInfo& info)
 	
 
 	std::thread similarity_finder([&reads_queue, &compress_queue, &reference_reads, &ref_genome, &filtered_kmers, &params, kmerLen,
-		&ref_reads_accepter, tot_n_reads, tot_ref_reads, &tc, n_compression_threads, &fill_factor_kmers_to_reads]{
+		&ref_reads_accepter, tot_n_reads, tot_ref_reads, &tc, n_compression_threads, &fill_factor_kmers_to_reads, reference_reads_mode]{
 #ifdef MEASURE_THREADS_TIMES
 		CThreadWatch tw;
 		tw.startTimer();
@@ -575,8 +1037,8 @@ void runCompression(const CCompressorParams& params, CInfo& info)
 		//compress_queue.MarkCompleted();
 
 		CReadsSimilarityGraph sim_graph(reads_queue, compress_queue, reference_reads, ref_genome.get(), filtered_kmers, 
-			kmerLen, params.maxCandidates, params.maxKmerCount, params.referenceReadsMode, ref_reads_accepter,
-			(double)tot_ref_reads/tot_n_reads, n_compression_threads, params.dataSource, fill_factor_kmers_to_reads, params.verbose);
+			kmerLen, params.minimizerWindow, params.maxCandidates, params.maxKmerCount, reference_reads_mode, ref_reads_accepter,
+			(double)tot_ref_reads/tot_n_reads, n_compression_threads, params.dataSource, fill_factor_kmers_to_reads, params.dnaBlockSize, params.verbose);
 
 #ifdef MEASURE_THREADS_TIMES
 		tw.stopTimer();
@@ -606,6 +1068,7 @@ void runCompression(const CCompressorParams& params, CInfo& info)
 			params.minFractionOfMmersInEncodeToAlwaysEncode, 
 			params.minFractionOfMmersInEncode,
 			params.maxMatchesMultiplier,
+			params.maxEncodeEffort,
 			params.editScriptCostMultiplier,
 			params.minPartLenToConsiderAltRead,
 			params.maxRecurence,			
@@ -626,7 +1089,7 @@ void runCompression(const CCompressorParams& params, CInfo& info)
 
 
 
-	std::thread entropy_compressor([&reference_reads, &params, &compressed_queue, &archive, tot_n_reads, mean_read_len, n_ref_genome_pseudo_reads, &tc] {
+	std::thread entropy_compressor([&reference_reads, &params, &compressed_queue, &archive, &archive_index, &ref_reads_accepter, tot_n_reads, mean_read_len, n_ref_genome_pseudo_reads, reference_reads_mode, &tc] {
 #ifdef MEASURE_THREADS_TIMES
 		CThreadWatch tw;
 		tw.startTimer();
@@ -638,7 +1101,8 @@ void runCompression(const CCompressorParams& params, CInfo& info)
 		//	;
 
 		CEntrComprReads compr{ compressed_queue, reference_reads, params.verbose, params.maxCandidates,
-			params.compressionLevel, tot_n_reads * mean_read_len, archive, tot_n_reads, n_ref_genome_pseudo_reads };
+			params.compressionLevel, tot_n_reads * mean_read_len, archive, archive_index, tot_n_reads, n_ref_genome_pseudo_reads,
+			reference_reads_mode, ref_reads_accepter, params.dnaBlockSize };
 		compr.Compress();
 
 #ifdef MEASURE_THREADS_TIMES
@@ -651,13 +1115,13 @@ void runCompression(const CCompressorParams& params, CInfo& info)
 	
 	if (is_fastq)
 	{		
-		entr_compr_qual = std::thread([&quals_queue, &archive, &params, &edit_script_for_qual_queue, tot_n_reads, mean_read_len, &tc] {
+		entr_compr_qual = std::thread([&quals_queue, &archive, &archive_index, &params, &edit_script_for_qual_queue, tot_n_reads, mean_read_len, &tc] {
 #ifdef MEASURE_THREADS_TIMES
 			CThreadWatch tw;
 			tw.startTimer();
 #endif
 
-			CEntrComprQuals compr{ quals_queue, archive, params.qualityComprMode, params.qualityFwdThresholds, params.qualityRevThresholds, params.verbose, params.compressionLevel, tot_n_reads * mean_read_len, edit_script_for_qual_queue, params.dataSource };
+			CEntrComprQuals compr{ quals_queue, archive, archive_index, params.qualityComprMode, params.qualityFwdThresholds, params.qualityRevThresholds, params.verbose, params.compressionLevel, tot_n_reads * mean_read_len, edit_script_for_qual_queue, params.dataSource, params.qualBlockSize };
 			compr.Compress();
 
 #ifdef MEASURE_THREADS_TIMES
@@ -668,7 +1132,7 @@ void runCompression(const CCompressorParams& params, CInfo& info)
 	}
 
 	
-	std::thread entr_compr_header([&headers_queue, &archive, &params, &tc] {
+	std::thread entr_compr_header([&headers_queue, &archive, &archive_index, &params, &tc] {
 #ifdef MEASURE_THREADS_TIMES
 		CThreadWatch tw;
 		tw.startTimer();
@@ -679,7 +1143,7 @@ void runCompression(const CCompressorParams& params, CInfo& info)
 		//header_pack_t p;
 		//while (headers_queue.Pop(p))
 		//	;
-		CEntrComprHeaders compr{ headers_queue, archive, params.headerComprMode, params.compressionLevel, params.verbose };
+		CEntrComprHeaders compr{ headers_queue, archive, archive_index, params.headerComprMode, params.compressionLevel, params.verbose, params.dnaBlockSize != 0 || params.qualBlockSize != 0 };
 		compr.Compress();		
 
 #ifdef MEASURE_THREADS_TIMES
@@ -702,6 +1166,32 @@ void runCompression(const CCompressorParams& params, CInfo& info)
 		th.join();
 	entropy_compressor.join();
 
+	if (load_index && input_digests != index_header.input_digests)
+	{
+		std::cerr << "Error: index " << params.loadIndexPath << " was built for a different input of the same size, the archive is not valid\n";
+		exit(1);
+	}
+	if (save_index)
+	{
+		std::fstream index_out(params.saveIndexPath, std::ios::binary | std::ios::in | std::ios::out);
+		index_out.seekp(index_header.input_digests_pos);
+		for (const auto& digest : input_digests)
+			index_out.write(reinterpret_cast<const char*>(digest.data()), KmersIndexHeader::digest_size);
+		if (!index_out)
+		{
+			std::cerr << "Error: cannot write index " << params.saveIndexPath << "\n";
+			exit(1);
+		}
+	}
+
+	spool.reset();
+	if (input_tmp_dir_path != "")
+	{
+		std::filesystem::remove_all(input_tmp_dir_path, ec);
+		if (ec)
+			std::cerr << "Warning: cannot remove tmp dir: " << input_tmp_dir_path << "\n";
+	}
+
 	std::vector<uint8_t> _config;
 	StoreLittleEndian(_config, tot_ref_reads);
 	StoreLittleEndian(_config, params.maxCandidates);
@@ -752,9 +1242,9 @@ void runCompression(const CCompressorParams& params, CInfo& info)
 		}
 	}
 	_config.push_back(static_cast<uint8_t>(params.headerComprMode));
-	_config.push_back(static_cast<uint8_t>(params.referenceReadsMode));
+	_config.push_back(static_cast<uint8_t>(reference_reads_mode));
 
-	if (params.referenceReadsMode == ReferenceReadsMode::Sparse)
+	if (reference_reads_mode == ReferenceReadsMode::Sparse)
 	{
 		StoreLittleEndian(_config, sparseMode_range);
 		StoreLittleEndian(_config, sparseMode_exponent);
@@ -776,13 +1266,22 @@ void runCompression(const CCompressorParams& params, CInfo& info)
 		}
 	}
 
+	StoreLittleEndian(_config, params.dnaBlockSize);
+	StoreLittleEndian(_config, params.qualBlockSize);
+
 	archive.AddPart(s_meta, _config, 0);
 
+	archive_index.Store(archive);
+
 	int s_info = archive.RegisterStream("info");
 	std::vector<uint8_t> _info = info.Serialize();
 	archive.AddPart(s_info, _info, 0ull);
 
-	archive.Close();
+	if (!archive.Close())
+	{
+		std::cerr << "Error: cannot write archive: " << params.outputFilePath << "\n";
+		exit(1);
+	}
 
 #ifdef MEASURE_THREADS_TIMES
 	tw.stopTimer();
@@ -804,6 +1303,8 @@ void runCompression(const CCompressorParams& params, CInfo& info)
 	cerr << "Header size     : " << archive.GetStreamPackedSize(archive.GetStreamId("header")) << endl;
 	cerr << "Meta size       : " << archive.GetStreamPackedSize(archive.GetStreamId("meta")) << endl;
 	cerr << "Info size       : " << archive.GetStreamPackedSize(archive.GetStreamId("info")) << endl;
+	if (params.verbose)
+		cerr << "Index size      : " << archive.GetStreamPackedSize(archive.GetStreamId("index")) << endl;
 	if(params.storeRefGenome)
 		cerr << "Ref genome size : " << archive.GetStreamPackedSize(archive.GetStreamId("ref-genome")) << endl;
 
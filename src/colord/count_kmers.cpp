@@ -25,7 +25,42 @@
 #include <filesystem>
 
 using namespace std;
-CKmerCounter::CKmerCounter(uint32_t k, uint32_t ci, uint32_t cs, uint32_t n_threads, uint32_t modulo, const std::string& inputPath, const std::string& outPath, const std::string& tmpPath, bool is_fastq, bool verbose)
+
+void CFilteredKmersBins::Add(const CFilteredKmersPack& pack)
+{
+	if (bins.empty())
+	{
+		lut_prefix_len = pack.lutPrefixLen;
+		counter_size = pack.counterSize;
+		suffix_size = (kmer_len - lut_prefix_len) / 4;
+	}
+	if (pack.binId < 0)
+	{
+		std::cerr << "Error: wrong bin id of filtered k-mers\n";
+		exit(1);
+	}
+	if (static_cast<uint32_t>(pack.binId) >= bins.size())
+		bins.resize(pack.binId + 1);
+
+	auto& bin = bins[pack.binId];
+	bin.records.insert(bin.records.end(), pack.records, pack.records + pack.recordsSize);
+	bin.lut.insert(bin.lut.end(), pack.lut, pack.lut + pack.lutSize);
+	if (pack.endOfBin)
+	{
+		bin.records.shrink_to_fit();
+		bin.lut.shrink_to_fit();
+	}
+}
+
+uint64_t CFilteredKmersBins::GetMemoryUsage() const
+{
+	uint64_t res = bins.size() * sizeof(bin_t);
+	for (const auto& bin : bins)
+		res += bin.records.capacity() + bin.lut.capacity() * sizeof(uint64_t);
+	return res;
+}
+CKmerCounter::CKmerCounter(uint32_t k, uint32_t ci, uint32_t cs, uint32_t n_threads, uint32_t modulo, const std::string& inputPath, const std::string& outPath, const std::string& tmpPath, bool is_fastq, bool is_bam, uint32_t max_ram_gb, bool verbose,
+	std::function<void(const uint8_t* data, uint64_t size, bool end_of_file)> inputObserver, CFilteredKmersBins* filteredKmersBins, std::vector<uint8_t> stdinHead)
 {
 	std::cerr << "Counting k-mers.\n";
 	//if (fileExists(outPath + ".kmc_pre") && fileExists(outPath + ".kmc_suf"))
@@ -65,6 +100,12 @@ CKmerCounter::CKmerCounter(uint32_t k, uint32_t ci, uint32_t cs, uint32_t n_thre
 	params.tmpPath = tmpPath;
 	params.statsFile = kmc_stats_file;
 	params.is_fasta = !is_fastq;
+	params.is_bam = is_bam;
+	params.maxRamGB = max_ram_gb;
+	params.inputObserver = std::move(inputObserver);
+	params.stdinHead = std::move(stdinHead);
+	if (filteredKmersBins)
+		params.kmersObserver = [filteredKmersBins](const CFilteredKmersPack& pack) { filteredKmersBins->Add(pack); };
 	int stat = run_filtering_kmc(params);	
 	if (stat != 0)
 	{
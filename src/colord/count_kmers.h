@@ -20,6 +20,58 @@
 #include "defs.h"
 #include "params.h"
 #include <string>
+#include <vector>
+#include <functional>
+
+struct CFilteredKmersPack;
+
+// Filtered k-mers passed directly from the k-mer counter, kept in bins in the same form as in the kmc database
+class CFilteredKmersBins
+{
+	struct bin_t
+	{
+		std::vector<uint8_t> records; // k-mers suffixes (big endian) followed by counters (little endian)
+		std::vector<uint64_t> lut; // the numbers of records for consecutive prefixes
+	};
+	std::vector<bin_t> bins;
+	uint32_t lut_prefix_len{};
+	uint32_t counter_size{};
+	uint32_t suffix_size{};
+	uint32_t kmer_len;
+public:
+	explicit CFilteredKmersBins(uint32_t kmer_len) : kmer_len(kmer_len) {}
+
+	// Called by the k-mer counter (from a single thread)
+	void Add(const CFilteredKmersPack& pack);
+
+	uint32_t GetNBins() const
+	{
+		return static_cast<uint32_t>(bins.size());
+	}
+
+	// Calls callback(kmer, count) for all k-mers of a bin, different bins may be read concurrently
+	template<typename CALLBACK>
+	void ForEachKmer(uint32_t bin_no, const CALLBACK& callback) const
+	{
+		const auto& bin = bins[bin_no];
+		uint32_t rec_size = suffix_size + counter_size;
+		const uint8_t* rec = bin.records.data();
+
+		for (uint64_t prefix = 0; prefix < bin.lut.size(); ++prefix)
+			for (uint64_t i = 0; i < bin.lut[prefix]; ++i, rec += rec_size)
+			{
+				kmer_type kmer = prefix;
+				for (uint32_t j = 0; j < suffix_size; ++j)
+					kmer = (kmer << 8) | rec[j];
+				uint32_t count = 0;
+				for (uint32_t j = 0; j < counter_size; ++j)
+					count |= static_cast<uint32_t>(rec[suffix_size + j]) << (8 * j);
+				callback(kmer, count);
+			}
+	}
+
+	uint64_t GetMemoryUsage() const;
+};
 
 class CKmerCounter
 {
@@ -27,7 +79,10 @@ class CKmerCounter
 	uint64_t tot_kmers;
 	uint64_t n_unique_counted_kmers;
 public:
-	explicit CKmerCounter(uint32_t k, uint32_t ci, uint32_t cs, uint32_t n_threads, uint32_t modulo, const std::string& inputPath, const std::string& outPath, const std::string& tmpPath, bool is_fastq, bool verbose);
+	// If filteredKmersBins is given, filtered k-mers are passed to it, otherwise they are stored in the kmc database (outPath).
+	// An input file may be "-" (standard input), stdinHead are its first bytes already read
+	explicit CKmerCounter(uint32_t k, uint32_t ci, uint32_t cs, uint32_t n_threads, uint32_t modulo, const std::string& inputPath, const std::string& outPath, const std::string& tmpPath, bool is_fastq, bool is_bam, uint32_t max_ram_gb, bool verbose,
+		std::function<void(const uint8_t* data, uint64_t size, bool end_of_file)> inputObserver = nullptr, CFilteredKmersBins* filteredKmersBins = nullptr, std::vector<uint8_t> stdinHead = {});
 	uint32_t GetNReads() const { return n_reads; }
 	uint64_t GetTotKmers() const { return tot_kmers; }
 	uint64_t GetNUniqueCounted() const { return n_unique_counted_kmers; }
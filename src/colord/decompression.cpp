@@ -304,12 +304,19 @@ void runDecompression(const CDecompressorParams& params)
 	CExitErrorHandler error_handler;
 	CToFileDecompressedStreamConsumer consumer(params.outputFilePath);
 
+	CReadsRange range;
+	range.from = params.readsFrom;
+	range.to = params.readsTo;
+
 	CDecmpressionModule decmpression_module(params.inputFilePath,
 		params.refGenomePath,
 		logger,
 		params.verbose,
 		error_handler,
-		consumer
+		consumer,
+		false,
+		range,
+		params.nThreads
 	);
 	decmpression_module.Run();
 	decmpression_module.WaitForThreads();
@@ -282,6 +282,26 @@ void CDecmpressionModule::Run()
 		ref_genome->SetReadLen(ref_genome_read_len);
 	}
 
+	// Archives created by earlier versions end here
+	uint32_t dna_block_size = 0;
+	uint32_t qual_block_size = 0;
+	if (ptr_params < _params.data() + _params.size())
+	{
+		LoadLittleEndian(ptr_params, dna_block_size);
+		ptr_params += sizeof(dna_block_size);
+
+		LoadLittleEndian(ptr_params, qual_block_size);
+		ptr_params += sizeof(qual_block_size);
+	}
+	bool dna_blocks = dna_block_size != 0;
+	bool qual_blocks = is_fastq && qual_block_size != 0;
+
+	if (verbose)
+	{
+		std::cerr << "DNA block size: " << dna_block_size << "\n";
+		std::cerr << "quality block size: " << qual_block_size << "\n";
+	}
+
 	ref_reads = std::make_unique<CReferenceReads>(tot_ref_reads);
 
 	if (ref_genome_available)
@@ -291,7 +311,7 @@ void CDecmpressionModule::Run()
 			ref_reads->Add(read);
 	}
 
-	ref_reads_accepter = std::make_unique<CRefReadsAccepter>(sparseRange, sparseExponent, n_ref_genome_pseudo_reads);
+	ref_reads_accepter = std::make_unique<CRefReadsAccepter>(sparseRange, sparseExponent, n_ref_genome_pseudo_reads, dna_blocks);
 
 	if (verbose)
 	{
@@ -300,7 +320,72 @@ void CDecmpressionModule::Run()
 		std::cerr << "approx stream size: " << approx_stream_size << "\n";
 	}
 
-	read_decompr_queue = std::make_unique<CParallelQueue<decomp_read_pack_t>>(read_decompress_queue_size);
+	// Locate the restart points from which the streams must be decoded to reach the first requested read.
+	// Archives without index are decoded from the beginning.
+	size_t dna_start_part = 0;
+	uint64_t dna_first_read = 0;
+	size_t qual_start_part = 0;
+	size_t header_start_part = 0;
+	uint64_t header_first_read = 0;
+
+	if ((dna_blocks || qual_blocks) && !archive_index.Load(archive))
+	{
+		std::ostringstream oss;
+		oss << (archive_index.IsCorrupted() ? "archive index is corrupted" : "archive with DNA or quality blocks has no index");
+		error_handler.LogError(oss.str());
+	}
+
+	if (!range.IsFull())
+	{
+		if (range.from >= info.total_reads)
+		{
+			std::ostringstream oss;
+			oss << "requested reads range starts beyond the number of reads in the archive (" << info.total_reads << ")";
+			error_handler.LogError(oss.str());
+		}
+
+		bool index_loaded = archive_index.IsLoaded() || archive_index.Load(archive);
+		if (archive_index.IsCorrupted())
+		{
+			std::ostringstream oss;
+			oss << "archive index is corrupted";
+			error_handler.LogError(oss.str());
+		}
+
+		if (index_loaded)
+		{
+			if (dna_blocks)
+				dna_start_part = archive_index.FindRestartPart("dna", range.from);
+			if (is_fastq)
+			{
+				qual_start_part = archive_index.FindRestartPart("qual", range.from);
+
+				// Quality decompressor needs the reads of all parts it decodes
+				if (qual_start_part < dna_start_part)
+					dna_start_part = archive_index.FindRestartPart("dna", archive_index.GetFirstRead("qual", qual_start_part));
+			}
+			dna_first_read = archive_index.GetFirstRead("dna", dna_start_part);
+			header_start_part = archive_index.FindRestartPart("header", range.from);
+			header_first_read = archive_index.GetFirstRead("header", header_start_part);
+		}
+		else if (verbose)
+			std::cerr << "archive has no index, decoding from the beginning\n";
+
+		if (verbose)
+		{
+			std::cerr << "reads range: " << range.from + 1 << "-" << range.to << "\n";
+			std::cerr << "DNA start part: " << dna_start_part << "\n";
+			std::cerr << "quality start part: " << qual_start_part << "\n";
+			std::cerr << "header start part: " << header_start_part << "\n";
+		}
+	}
+
+	// Quality block is decoded when all its reads are available, so the writer must not wait for its qualities before all its reads are decoded
+	uint32_t read_queue_size = read_decompress_queue_size;
+	if (qual_blocks)
+		read_queue_size += static_cast<uint32_t>(archive_index.GetMaxBlockParts("qual"));
+
+	read_decompr_queue = std::make_unique<CParallelQueue<decomp_read_pack_t>>(read_queue_size);
 	read_decompr_queues.push_back(read_decompr_queue.get());
 
 	
@@ -313,19 +398,19 @@ void CDecmpressionModule::Run()
 		qual_decompr_queue = std::make_unique<CParallelQueue<decomp_qual_pack_t>>(qual_decompress_queue_size);
 	}
 
-	running_threads.emplace_back([&archive = archive, &read_decompr_queues = read_decompr_queues, verbose = verbose, maxCandidates, referenceReadsMode, &ref_reads = *ref_reads.get(), &ref_reads_accepter = *ref_reads_accepter.get(), compressionLevel = meta_data.compressionLevel, approx_stream_size, n_ref_genome_pseudo_reads, &info = info, hide_progress = hide_progress]{
-		CEntropyDecomprReads decompr{ archive, read_decompr_queues, verbose, maxCandidates, compressionLevel, approx_stream_size, info.total_reads, referenceReadsMode, ref_reads, ref_reads_accepter, n_ref_genome_pseudo_reads, hide_progress };
+	running_threads.emplace_back([&archive = archive, &read_decompr_queues = read_decompr_queues, verbose = verbose, maxCandidates, referenceReadsMode, &ref_reads = *ref_reads.get(), &ref_reads_accepter = *ref_reads_accepter.get(), compressionLevel = meta_data.compressionLevel, approx_stream_size, n_ref_genome_pseudo_reads, &info = info, hide_progress = hide_progress, &range = range, &archive_index = archive_index, dna_blocks, dna_start_part, n_threads = n_threads]{
+		CEntropyDecomprReads decompr{ archive, archive_index, read_decompr_queues, verbose, maxCandidates, compressionLevel, approx_stream_size, info.total_reads, referenceReadsMode, ref_reads, ref_reads_accepter, n_ref_genome_pseudo_reads, dna_blocks, dna_start_part, n_threads, range, hide_progress };
 		decompr.Decompress();
 		});	
 
-	running_threads.emplace_back([&archive = archive, &header_decompr_queue = header_decompr_queue, headerComprMode = meta_data.headerComprMode, compressionLevel = meta_data.compressionLevel, verbose = verbose]{
-		CEntrDecomprHeaders decompr{ archive, *header_decompr_queue.get(), headerComprMode, compressionLevel, verbose };
+	running_threads.emplace_back([&archive = archive, &header_decompr_queue = header_decompr_queue, headerComprMode = meta_data.headerComprMode, compressionLevel = meta_data.compressionLevel, verbose = verbose, independent_parts = dna_blocks || qual_blocks, &range = range, header_start_part, header_first_read]{
+		CEntrDecomprHeaders decompr{ archive, *header_decompr_queue.get(), headerComprMode, compressionLevel, verbose, independent_parts, range, header_start_part, header_first_read };
 		decompr.Decompress();
 		});
 	
 	if (is_fastq)	
-		running_threads.emplace_back([&archive = archive, &read_decompr_queues = read_decompr_queues, &qual_decompr_queue = *qual_decompr_queue.get(), verbose = verbose, qualityComprMode = meta_data.qualityComprMode, dataSource = meta_data.dataSource, &qualityFwdThresholds = qualityFwdThresholds, &qualityRevThresholds = qualityRevThresholds, compressionLevel = meta_data.compressionLevel, approx_stream_size]{
-			CEntrDecomprQuals decompr{ archive, *read_decompr_queues[1], qual_decompr_queue, verbose, qualityComprMode, dataSource, qualityFwdThresholds, qualityRevThresholds, compressionLevel, approx_stream_size };
+		running_threads.emplace_back([&archive = archive, &read_decompr_queues = read_decompr_queues, &qual_decompr_queue = *qual_decompr_queue.get(), verbose = verbose, qualityComprMode = meta_data.qualityComprMode, dataSource = meta_data.dataSource, &qualityFwdThresholds = qualityFwdThresholds, &qualityRevThresholds = qualityRevThresholds, compressionLevel = meta_data.compressionLevel, approx_stream_size, &archive_index = archive_index, qual_blocks, n_threads = n_threads, &range = range, qual_start_part, dna_start_part, dna_first_read]{
+			CEntrDecomprQuals decompr{ archive, archive_index, *read_decompr_queues[1], qual_decompr_queue, verbose, qualityComprMode, dataSource, qualityFwdThresholds, qualityRevThresholds, compressionLevel, approx_stream_size, qual_blocks, n_threads, range, qual_start_part, dna_start_part, dna_first_read };
 			decompr.Decompress();
 			});
 
@@ -22,6 +22,7 @@
 #include "parallel_queue.h"
 #include "utils.h"
 #include "archive.h"
+#include "archive_index.h"
 #include "reference_reads.h"
 #include "reference_genome.h"
 #include "ref_reads_accepter.h"
@@ -65,7 +66,10 @@ class CDecmpressionModule
 	IErrorHandler& error_handler;
 	IDecompressedStreamConsumer& decompressed_stream_consumer;
 	CArchive archive;
+	CArchiveIndex archive_index;
 	bool hide_progress;
+	CReadsRange range;
+	uint32_t n_threads;
 
 	CInfo info;
 	CMetaData meta_data;
@@ -99,7 +103,9 @@ public:
 		bool verbose,
 		IErrorHandler& error_handler,
 		IDecompressedStreamConsumer& decompressed_stream_consumer,
-		bool hide_progress = false)
+		bool hide_progress = false,
+		const CReadsRange& range = CReadsRange(),
+		uint32_t n_threads = 1)
 		:
 		inputFilePath(inputFilePath),
 		refGenomePath(refGenomePath),
@@ -108,7 +114,9 @@ public:
 		error_handler(error_handler),
 		decompressed_stream_consumer(decompressed_stream_consumer),
 		archive(true),
-		hide_progress(hide_progress)
+		hide_progress(hide_progress),
+		range(range),
+		n_threads(n_threads)
 	{
 		//std::cerr << "Running decompression.\n";
 		logger.Log("Running decompression.\n");
@@ -22,8 +22,8 @@
 
 //#define ENABLE_QUEUE_LOGING
 constexpr uint32_t version_major = 1;
-constexpr uint32_t version_minor = 2;
-constexpr uint32_t version_patch = 1;
+constexpr uint32_t version_minor = 3;
+constexpr uint32_t version_patch = 0;
 
 //#define ALLOW_ZERO_COMPRESSION_MODE
 
@@ -41,6 +41,7 @@ constexpr uint32_t quals_queue_size = 128;
 constexpr uint32_t headers_queue_size = 16;
 
 constexpr uint32_t compress_queue_size = 16;
+constexpr uint32_t accepted_kmers_queue_size = 2; //packs with extracted k-mers waiting for the similarity finder
 
 constexpr uint32_t reads_pack_size = 2 << 21;
 constexpr uint32_t headers_pack_size = 2 << 21;
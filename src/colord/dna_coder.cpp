@@ -42,6 +42,9 @@ void CDNACoder::Encode(es_t es)
 	encode_read_flag(tuple_type);
 	encode_read_len(static_cast<uint32_t>(es.size() - 1u));
 
+	if (tuple_type == tuple_types::start_plain || tuple_type == tuple_types::start_plain_with_Ns)
+		n_encoded_symbols += es.size() - 1u;
+
 	if (tuple_type == tuple_types::start_plain)
 	{
 		while (es.load(tuple_type, tuple_val1, tuple_val2))
@@ -227,6 +230,8 @@ void CDNACoder::Encode(es_t es)
 		last_tuple_type = tuple_type;
 	}
 
+	n_encoded_symbols += cur_pos;
+
 	++cur_read_id;
 }
 
@@ -261,7 +266,7 @@ void CDNACoder::Decode(read_t& read, CRefReadsAccepter& ref_read_accepter, bool
 		++cur_read_id;
 
 		if (acceptReadAsRef)
-			ref_reads.Add(read);
+			ref_reads.Set(cur_ref_read_id++, read);
 
 		return;
 	}
@@ -275,7 +280,7 @@ void CDNACoder::Decode(read_t& read, CRefReadsAccepter& ref_read_accepter, bool
 		++cur_read_id;
 
 		if (acceptReadAsRef)
-			ref_reads.Add(read);
+			ref_reads.Set(cur_ref_read_id++, read);
 
 		return;
 	}
@@ -431,7 +436,7 @@ void CDNACoder::Decode(read_t& read, CRefReadsAccepter& ref_read_accepter, bool
 	read_without_flags.emplace_back(255);
 
 	if (acceptReadAsRef)
-		ref_reads.Add(read_without_flags);
+		ref_reads.Set(cur_ref_read_id++, read_without_flags);
 
 	++cur_read_id;
 }
@@ -1246,7 +1251,7 @@ void CDNACoder::Init(bool _is_compressing, int _max_no_alt_refs, int _compressio
 	compression_level = _compression_level;
 	input_stream_size = _input_stream_size;
 
-	v_vios_io = new CVectorIOStream(v_io);
+	v_vios_io = new CVectorIOStream(v_io, &in_view);
 
 	CBasicRangeCoder<CVectorIOStream>* rc;
 
@@ -1346,6 +1351,7 @@ void CDNACoder::Init(bool _is_compressing, int _max_no_alt_refs, int _compressio
 	tpl_ctx_rc_tuple_type = new rcmfs_tuple_type_t(rc, nullptr, is_compressing);
 
 	cur_read_id = start_read_id;
+	cur_ref_read_id = start_read_id;
 }
 
 // *****************************************************************
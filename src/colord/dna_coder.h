@@ -92,7 +92,9 @@ class CDNACoder : public CBasicCoder
 	uint64_t input_stream_size;
 	int max_no_alt_refs;
 	int cur_read_id;
+	uint32_t cur_ref_read_id;
 	int cur_ref_delta;
+	uint64_t n_encoded_symbols{};
 
 	context_t ctx_read_type;
 	context_t ctx_rev_comp;
@@ -215,19 +217,19 @@ public:
 		delete tpl_ctx_rc_skip_len_distant;
 		if(verbose)
 		{
-			cout << "Read type size: " << m_ctx_rc_read_type.get_size() << endl;
-			cout << "Rev. comp. size: " << m_ctx_rc_rev_comp.get_size() << endl;
-			cout << "Seen read id size: " << m_ctx_rc_seen_read_id.get_size() << endl;
-			cout << "Symbols size: " << m_ctx_rc_symbols.get_size() << endl;
-			cout << "Symbols with Ns size: " << m_ctx_rc_symbols_with_Ns.get_size() << endl;
-			cout << "Read len no. bits size: " << m_ctx_rc_read_len_no_bits.get_size() << endl;
-			cout << "Read len data size: " << m_ctx_rc_read_len_data.get_size() << endl;
-			cout << "Read id size: " << m_ctx_rc_read_id.get_size() << endl;
-			cout << "Read id short size: " << m_ctx_rc_read_id_short.get_size() << endl;
-			cout << "Tuple type size: " << m_ctx_rc_tuple_type.get_size() << endl;
-			cout << "Anchor len size: " << m_ctx_rc_anchor_len.get_size() << endl;
-			cout << "Skip len local size: " << m_ctx_rc_skip_len_local.get_size() << endl;
-			cout << "Skip len distant size: " << m_ctx_rc_skip_len_distant.get_size() << endl;
+			cerr << "Read type size: " << m_ctx_rc_read_type.get_size() << endl;
+			cerr << "Rev. comp. size: " << m_ctx_rc_rev_comp.get_size() << endl;
+			cerr << "Seen read id size: " << m_ctx_rc_seen_read_id.get_size() << endl;
+			cerr << "Symbols size: " << m_ctx_rc_symbols.get_size() << endl;
+			cerr << "Symbols with Ns size: " << m_ctx_rc_symbols_with_Ns.get_size() << endl;
+			cerr << "Read len no. bits size: " << m_ctx_rc_read_len_no_bits.get_size() << endl;
+			cerr << "Read len data size: " << m_ctx_rc_read_len_data.get_size() << endl;
+			cerr << "Read id size: " << m_ctx_rc_read_id.get_size() << endl;
+			cerr << "Read id short size: " << m_ctx_rc_read_id_short.get_size() << endl;
+			cerr << "Tuple type size: " << m_ctx_rc_tuple_type.get_size() << endl;
+			cerr << "Anchor len size: " << m_ctx_rc_anchor_len.get_size() << endl;
+			cerr << "Skip len local size: " << m_ctx_rc_skip_len_local.get_size() << endl;
+			cerr << "Skip len distant size: " << m_ctx_rc_skip_len_distant.get_size() << endl;
 		}
 	}
 
@@ -240,6 +242,24 @@ public:
 	// Should be called after (de)compression
 	void Finish();
 
+	// Position in reference reads at which next decoded read accepted as reference will be stored
+	// (by default the same as start_read_id given in Init)
+	void SetRefReadId(uint32_t ref_read_id)
+	{
+		cur_ref_read_id = ref_read_id;
+	}
+
+	uint32_t GetRefReadId() const
+	{
+		return cur_ref_read_id;
+	}
+
+	// Total number of symbols (bases) of the reads encoded so far
+	uint64_t GetNEncodedSymbols() const
+	{
+		return n_encoded_symbols;
+	}
+
 	// Encoding read in an edit script form
 	// Plain reads:
 	//		(start_plain, 0, 0), (plain, symbol, 1), [(plain, symbol, 1)...]
@@ -25,6 +25,7 @@
 #include <iostream>
 #include <cassert>
 #include "edlib.h"
+#include "bit_parallel_align.h"
 
 
 //#define VALIDATE_REFACTOR_EDIT_SCRIPT
@@ -266,6 +267,42 @@ inline EditDistRes get_edit_dist_on_seq_empty(read_view refPart, read_view encPa
 	return ed;
 }
 
+// Converts alignment in edlib format to edit script
+// enc_is_query - if enc was aligned as query (insertion to target means deletion from ref), otherwise ref was aligned as query
+inline std::string edit_script_from_alignment(const unsigned char* alignment, int alignment_length, read_view ref, read_view enc, bool enc_is_query)
+{
+	std::string conversion_required;
+	//0 - match
+	//1 - insertion to target (deletion from query)
+	//2 - insertion to query (deletion from target)
+	//3 - missmatch
+	const unsigned char del_code = enc_is_query ? EDLIB_EDOP_DELETE : EDLIB_EDOP_INSERT;
+	uint32_t pos_ref{}, pos_enc{};
+	conversion_required.reserve(alignment_length);
+	for (int i = 0; i < alignment_length; ++i)
+	{
+		unsigned char c = alignment[i];
+		if (c == EDLIB_EDOP_MATCH)
+		{
+			++pos_ref, ++pos_enc;
+			conversion_required.push_back('M');
+		}
+		else if (c == EDLIB_EDOP_MISMATCH)
+		{
+			conversion_required.push_back(CMissmatchCoder::encode_missmatch_symb("ACGT"[ref[pos_ref]], "ACGT"[enc[pos_enc]]));
+			++pos_ref, ++pos_enc;
+		}
+		else if (c == del_code)
+		{
+			conversion_required.push_back('D');
+			++pos_ref;
+		}
+		else
+			conversion_required.push_back("ACGT"[enc[pos_enc++]]);
+	}
+	return conversion_required;
+}
+
 /*
 * sequences may not be empty!
 */
@@ -280,45 +317,24 @@ inline EditDistRes find_edit_dist_with_edlib_ex(read_view ref, read_view enc, Ed
 		return res;
 	}
 
+	if (ref.length() <= bit_parallel_max_query_len && mode != EDLIB_MODE_HW)
+	{
+		thread_local std::vector<unsigned char> alignment;
+		int end_location;
+		res.editDist = bit_parallel_align(ref.data(), static_cast<uint32_t>(ref.length()), enc.data(), static_cast<uint32_t>(enc.length()), mode, alignment, end_location);
+		res.editScript = edit_script_from_alignment(alignment.data(), static_cast<int>(alignment.size()), ref, enc, false);
+		return res;
+	}
+
 	EdlibAlignResult result = edlibAlign((const char*)ref.data(), static_cast<int>(ref.length()), (const char*)enc.data(), static_cast<int>(enc.length()),
 		edlibNewAlignConfig(-1, mode, EDLIB_TASK_PATH, NULL, 0)
 	);
-	std::string conversion_required;
 	if (result.status == EDLIB_STATUS_OK)
 	{
-		//0 - match
-		//1 - insertion to target, enc
-		//2 - insertion to query, ref
-		//3 - missmatch		
-		uint32_t pos_ref{}, pos_enc{};
-		conversion_required.reserve(result.alignmentLength);
-		for (int i = 0; i < result.alignmentLength; ++i)
-		{
-			char c = result.alignment[i];
-			if (c == 0)
-			{
-				++pos_ref, ++pos_enc;
-				conversion_required.push_back('M');
-			}
-			else if (c == 1)
-			{
-				conversion_required.push_back('D');
-				++pos_ref;
-			}
-			else if (c == 2)				
-				conversion_required.push_back("ACGT"[enc[pos_enc++]]);
-			else if (c == 3)
-			{
-				conversion_required.push_back(CMissmatchCoder::encode_missmatch_symb("ACGT"[ref[pos_ref]], "ACGT"[enc[pos_enc]]));
-				++pos_ref, ++pos_enc;
-			}
-		}
-		edlibFreeAlignResult(result);
-
-		res.editScript = move(conversion_required);
+		res.editScript = edit_script_from_alignment(result.alignment, result.alignmentLength, ref, enc, false);
 		res.editDist = result.editDistance;
+		edlibFreeAlignResult(result);
 		return res;
-
 	}
 	else
 	{
@@ -342,50 +358,27 @@ inline EditDistRes find_edit_dist_with_edlib_ex_odwr(read_view ref, read_view en
 		return res;
 	}
 
+	if (enc.length() <= bit_parallel_max_query_len && mode != EDLIB_MODE_HW)
+	{
+		thread_local std::vector<unsigned char> alignment;
+		int end_location;
+		res.editDist = bit_parallel_align(enc.data(), static_cast<uint32_t>(enc.length()), ref.data(), static_cast<uint32_t>(ref.length()), mode, alignment, end_location);
+		ref_end = static_cast<uint32_t>(end_location);
+		res.editScript = edit_script_from_alignment(alignment.data(), static_cast<int>(alignment.size()), ref, enc, true);
+		return res;
+	}
+
 	EdlibAlignResult result = edlibAlign((const char*)enc.data(), static_cast<int>(enc.length()), (const char*)ref.data(), static_cast<int>(ref.length()),
 		edlibNewAlignConfig(-1, mode, EDLIB_TASK_PATH, NULL, 0)
 	);
-	std::string conversion_required;
 	if (result.status == EDLIB_STATUS_OK)
 	{
 		assert(result.numLocations > 0);
 		ref_end = result.endLocations[0];
-		//0 - match
-		//1 - insertion to target, ref  (deletion in query, enc)
-		//2 - insertion to query, enc (deletion in target, ref)
-		//3 - missmatch		
-		uint32_t pos_ref{}, pos_enc{};
-		conversion_required.reserve(result.alignmentLength);
-		for (int i = 0; i < result.alignmentLength; ++i)
-		{
-			char c = result.alignment[i];
-			if (c == 0)
-			{
-				++pos_ref, ++pos_enc;
-				conversion_required.push_back('M');
-			}
-			else if (c == 1)
-			{
-				conversion_required.push_back("ACGT"[enc[pos_enc++]]);
-			}
-			else if (c == 2)
-			{
-				conversion_required.push_back('D');
-				++pos_ref;
-			}
-			else if (c == 3)
-			{
-				conversion_required.push_back(CMissmatchCoder::encode_missmatch_symb("ACGT"[ref[pos_ref]], "ACGT"[enc[pos_enc]]));
-				++pos_ref, ++pos_enc;
-			}
-
-		}
-		edlibFreeAlignResult(result);
-
-		res.editScript = move(conversion_required);
+		res.editScript = edit_script_from_alignment(result.alignment, result.alignmentLength, ref, enc, true);
 		res.editDist = result.editDistance;
+		edlibFreeAlignResult(result);
 		return res;
-
 	}
 	else
 	{
@@ -166,38 +166,21 @@ public:
 		}
 	}
 
-	explicit CMmersHashMapLP(const read_t& read, uint32_t m, CMmersHashMapLP& allowOnly, CBloomFilter &bloom_mmers) :
+	explicit CMmersHashMapLP(const packed_read_view& read, uint32_t m, CMmersHashMapLP& allowOnly, CBloomFilter &bloom_mmers) :
 		mmers(~0ull, 16, 0.8, std::equal_to<uint64_t>{}, MurMur64Hash{})
 	{
 		hash_map_type& include = allowOnly.mmers;
-		if (read_len(read) < m)
+		if (read.size() < m)
 			return;
 
-		anchor_type mask = (1ull << (2 * m)) - 1;
-
-		anchor_type mmer{};
-		uint32_t pos = 0;
-		for (; pos < m - 1; ++pos)
-		{
-			assert(read[pos] < 4); //only ACGT
-			mmer <<= 2;
-			mmer += read[pos];
-		}
-
 		std::vector<std::pair<uint64_t, uint64_t>> v_mmers;
-		v_mmers.reserve(read_len(read) - m + 1);
-
-		for (; pos < read_len(read); ++pos)
-		{
-			assert(read[pos] < 4); //only ACGT
-			mmer <<= 2;
-			mmer += read[pos];
-			mmer &= mask;
+		v_mmers.reserve(read.size() - m + 1);
 
+		read.ForEachMmer(m, [&](anchor_type mmer, uint32_t pos) {
 			if (bloom_mmers.test(mmer))
 				if (include.check(mmer))
-					v_mmers.emplace_back(mmer, pos - m + 1);
-		}
+					v_mmers.emplace_back(mmer, pos);
+		});
 
 		mmers = hash_map_type(~0ull, static_cast<uint64_t>(v_mmers.size() / 0.4), 0.4, std::equal_to<uint64_t>{}, MurMur64Hash{});
 		for (auto& x : v_mmers)
@@ -290,7 +273,7 @@ public:
 //this is possible with insert_up_to_n_duplicates method added to hash table which has some limitation (for example there may be no HT restruct to keep the results correct)
 class CMmersHashMapDuplicateOptimizedLP
 {
-	using hash_map_type = hash_map_lp<uint64_t, uint64_t, std::equal_to<uint64_t>, MurMur64Hash>;
+	using hash_map_type = hash_map_lp<uint64_t, uint64_t, std::equal_to<uint64_t>, MurMur64Hash, arena_allocator<std::pair<uint64_t, uint64_t>>>;
 	using hash_set_type = hash_set_lp<uint64_t, std::equal_to<uint64_t>, MurMur64Hash>;
 	hash_map_type mmers;
 
@@ -323,9 +306,9 @@ public:
 		return mmers.size() - vec_for_highly_duplicated_elems.size() + x;
 	}
 
-	explicit CMmersHashMapDuplicateOptimizedLP(const read_t& read, uint32_t m) :
+	explicit CMmersHashMapDuplicateOptimizedLP(const read_t& read, uint32_t m, CArena& arena) :
 		//+ 1 in initial size is crucial because we use insert_up_to_n_duplicates which does not allow restruct of HT
-		mmers(~0ull, static_cast<size_t>((read_len(read) - m + 1) / 0.4) + 1, 0.4, std::equal_to<uint64_t>{}, MurMur64Hash{})
+		mmers(~0ull, static_cast<size_t>((read_len(read) - m + 1) / 0.4) + 1, 0.4, std::equal_to<uint64_t>{}, MurMur64Hash{}, hash_map_type::allocator_type(arena))
 	{
 		if (read_len(read) < m)
 			return;
@@ -351,40 +334,23 @@ public:
 		}
 	}
 
-	explicit CMmersHashMapDuplicateOptimizedLP(const read_t& read, uint32_t m, CMmersHashMapDuplicateOptimizedLP& allowOnly, CBloomFilter& bloom_mmers) :
-		mmers(~0ull, 16, 0.8, std::equal_to<uint64_t>{}, MurMur64Hash{})
+	explicit CMmersHashMapDuplicateOptimizedLP(const packed_read_view& read, uint32_t m, CMmersHashMapDuplicateOptimizedLP& allowOnly, CBloomFilter& bloom_mmers, CArena& arena) :
+		mmers(~0ull, 16, 0.8, std::equal_to<uint64_t>{}, MurMur64Hash{}, hash_map_type::allocator_type(arena))
 	{
 		hash_map_type& include = allowOnly.mmers;
-		if (read_len(read) < m)
+		if (read.size() < m)
 			return;
 
-		anchor_type mask = (1ull << (2 * m)) - 1;
-
-		anchor_type mmer{};
-		uint32_t pos = 0;
-		for (; pos < m - 1; ++pos)
-		{
-			assert(read[pos] < 4); //only ACGT
-			mmer <<= 2;
-			mmer += read[pos];
-		}
-
-		std::vector<std::pair<uint64_t, uint64_t>> v_mmers;
-		v_mmers.reserve(read_len(read) - m + 1);
-
-		for (; pos < read_len(read); ++pos)
-		{
-			assert(read[pos] < 4); //only ACGT
-			mmer <<= 2;
-			mmer += read[pos];
-			mmer &= mask;
+		std::vector<std::pair<uint64_t, uint64_t>, arena_allocator<std::pair<uint64_t, uint64_t>>> v_mmers{ arena_allocator<std::pair<uint64_t, uint64_t>>(arena) };
+		v_mmers.reserve(read.size() - m + 1);
 
+		read.ForEachMmer(m, [&](anchor_type mmer, uint32_t pos) {
 			if (bloom_mmers.test(mmer))
 				if (include.check(mmer))
-					v_mmers.emplace_back(mmer, pos - m + 1);
-		}
+					v_mmers.emplace_back(mmer, pos);
+		});
 		//+ 1 in initial size is crucial because we use insert_up_to_n_duplicates which does not allow restruct of HT
-		mmers = hash_map_type(~0ull, static_cast<uint64_t>(v_mmers.size() / 0.4) + 1, 0.4, std::equal_to<uint64_t>{}, MurMur64Hash{});
+		mmers = hash_map_type(~0ull, static_cast<uint64_t>(v_mmers.size() / 0.4) + 1, 0.4, std::equal_to<uint64_t>{}, MurMur64Hash{}, hash_map_type::allocator_type(arena));
 		for (auto& x : v_mmers)
 			insert_elem(x.first, x.second);
 	}
@@ -518,15 +484,15 @@ public:
 
 class CKmersHashMapLP
 {
-	using hash_map_type = hash_map_lp<uint64_t, uint64_t, std::equal_to<uint64_t>, MurMur64Hash>;
+	using hash_map_type = hash_map_lp<uint64_t, uint64_t, std::equal_to<uint64_t>, MurMur64Hash, arena_allocator<std::pair<uint64_t, uint64_t>>>;
 	using hash_set_type = hash_set_lp<uint64_t, std::equal_to<uint64_t>, MurMur64Hash>;
 	hash_map_type kmers;
 
 public:
 	uint32_t GetNMmers() { return static_cast<uint32_t>(kmers.size_unique()); }
 
-	explicit CKmersHashMapLP(const read_t& read, uint32_t m) :
-		kmers(~0ull, static_cast<size_t>((read_len(read) - m + 1) / 0.4), 0.4, std::equal_to<uint64_t>{}, MurMur64Hash{})
+	explicit CKmersHashMapLP(const read_t& read, uint32_t m, CArena& arena) :
+		kmers(~0ull, static_cast<size_t>((read_len(read) - m + 1) / 0.4), 0.4, std::equal_to<uint64_t>{}, MurMur64Hash{}, hash_map_type::allocator_type(arena))
 	{
 		if (read_len(read) < m)
 			return;
@@ -553,48 +519,24 @@ public:
 		}
 	}
 
-	explicit CKmersHashMapLP(const read_t& read, uint32_t m, CKmersHashSetLP& includeCanonical, CBloomFilter &bloomKmers, uint32_t modulo) :
-		kmers(~0ull, static_cast<size_t>(includeCanonical.Size() / 0.4), 0.4, std::equal_to<uint64_t>{}, MurMur64Hash{})
+	explicit CKmersHashMapLP(const packed_read_view& read, uint32_t m, CKmersHashSetLP& includeCanonical, CBloomFilter &bloomKmers, uint32_t modulo, CArena& arena) :
+		kmers(~0ull, static_cast<size_t>(includeCanonical.Size() / 0.4), 0.4, std::equal_to<uint64_t>{}, MurMur64Hash{}, hash_map_type::allocator_type(arena))
 	{
-		if (read_len(read) < m)
+		if (read.size() < m)
 			return;
 
 		MurMur64Hash mm;
 		libdivide::divider<uint64_t> div(modulo);
 
-		anchor_type mask = (1ull << (2 * m)) - 1;
-
-		anchor_type mmer{}, rev{};
-		uint32_t pos = 0;
-		for (; pos < m - 1; ++pos)
-		{
-			assert(read[pos] < 4); //only ACGT
-			mmer <<= 2;
-			mmer += read[pos];
-
-			rev >>= 2;
-			rev += ((uint64_t)(3 - read[pos])) << (2 * (m - 1));
-		}
-
-		for (; pos < read_len(read); ++pos)
-		{
-			assert(read[pos] < 4); //only ACGT
-			mmer <<= 2;
-			mmer += read[pos];
-			mmer &= mask;
-
-			rev >>= 2;
-			rev += ((uint64_t)(3 - read[pos])) << (2 * (m - 1));
-			auto can = mmer < rev ? mmer : rev;
-
+		read.ForEachMmerWithCanonical(m, [&](anchor_type mmer, anchor_type can, uint32_t pos) {
 			uint64_t h = mm(can);
 
 			if(h - modulo * (h / div) == 0 && bloomKmers.test(can))
 				if (includeCanonical.Check(can))
 				{
-					kmers.insert_fast(std::make_pair(mmer, pos - m + 1));
+					kmers.insert_fast(std::make_pair(mmer, pos));
 				}
-		}
+		});
 	}
 
 	//-1 if not exists or is not unique, value in _map in the other case
@@ -867,9 +809,11 @@ uint32_t CEncoder::AdjustAnchors(std::vector<Anchor>& anchors, uint32_t new_enc_
 	return tot_len;
 }
 
-AnalyseRefReadWithKmersRes CEncoder::AnalyseRefReadWithKmers(CKmers& enc_kmers, CBloomFilter& bloom_kmers, const read_t& enc_read, const read_t& ref_read, Candidate& candidate, CKmersHashSetLP& common_kmers)
+AnalyseRefReadWithKmersRes CEncoder::AnalyseRefReadWithKmers(CKmers& enc_kmers, CBloomFilter& bloom_kmers, const packed_read_view& enc_read, const packed_read_view& ref_read, Candidate& candidate, CKmersHashSetLP& common_kmers)
 {
-	CKmersHashMapLP ref_kmers(ref_read, kmerLen, common_kmers, bloom_kmers, modulo);
+	//the k-mers of the candidate are given back to the arena when it is analysed
+	CArenaScope arena_scope(arena);
+	CKmersHashMapLP ref_kmers(ref_read, kmerLen, common_kmers, bloom_kmers, modulo, arena);
 
 	std::vector<Anchor> kmers_anchors;
 
@@ -920,17 +864,11 @@ AnalyseRefReadWithKmersRes CEncoder::AnalyseRefReadWithKmers(CKmers& enc_kmers,
 	//expand first kmer anchor to the left
 	Anchor& first_anchor = kmers_anchors[0];
 
-	while (first_anchor.pos_in_enc > 0 && first_anchor.pos_in_ref > 0)
 	{
-		if (enc_read[first_anchor.pos_in_enc - 1] == ref_read[first_anchor.pos_in_ref - 1])
-		{
-			--first_anchor.pos_in_enc;
-			--first_anchor.pos_in_ref;
-			++first_anchor.len;
-			//			++tot_anch_len;
-		}
-		else
-			break;
+		uint32_t n_match = packed_match_left(enc_read, first_anchor.pos_in_enc, ref_read, first_anchor.pos_in_ref, std::min(first_anchor.pos_in_enc, first_anchor.pos_in_ref));
+		first_anchor.pos_in_enc -= n_match;
+		first_anchor.pos_in_ref -= n_match;
+		first_anchor.len += n_match;
 	}
 
 	//In the best case all symbols between two k-mer based anchors are match, so it will join into a single anchor (again, currently erase in the middle of a vector in the implementation)
@@ -941,23 +879,18 @@ AnalyseRefReadWithKmersRes CEncoder::AnalyseRefReadWithKmers(CKmers& enc_kmers,
 			auto prev_anch_end_enc = kmers_anchors[i - 1].pos_in_enc + kmers_anchors[i - 1].len;
 			auto prev_anch_end_ref = kmers_anchors[i - 1].pos_in_ref + kmers_anchors[i - 1].len;
 
-			while (true)
+			//symbols are compared up to the end of the previous anchor in enc or ref (whichever is closer)
+			uint32_t gap_enc = kmers_anchors[i].pos_in_enc - prev_anch_end_enc;
+			uint32_t gap_ref = kmers_anchors[i].pos_in_ref - prev_anch_end_ref;
+			uint32_t n_match = packed_match_left(enc_read, kmers_anchors[i].pos_in_enc, ref_read, kmers_anchors[i].pos_in_ref, std::min(gap_enc, gap_ref));
+			kmers_anchors[i].len += n_match;
+			kmers_anchors[i].pos_in_enc -= n_match;
+			kmers_anchors[i].pos_in_ref -= n_match;
+
+			if (n_match == gap_enc && n_match == gap_ref)//merge anchors
 			{
-				bool prev_reached_enc = kmers_anchors[i].pos_in_enc == prev_anch_end_enc;
-				bool prev_reached_ref = kmers_anchors[i].pos_in_ref == prev_anch_end_ref;
-				if (prev_reached_enc && prev_reached_ref)//merge anchors
-				{
-					kmers_anchors[i].len += kmers_anchors[i - 1].len;
-					kmers_anchors.erase(kmers_anchors.begin() + i - 1);
-					break;
-				}
-				if (prev_reached_enc || prev_reached_ref)
-					break;
-				if (enc_read[kmers_anchors[i].pos_in_enc - 1] != ref_read[kmers_anchors[i].pos_in_ref - 1])
-					break;
-				kmers_anchors[i].len++;
-				kmers_anchors[i].pos_in_enc--;
-				kmers_anchors[i].pos_in_ref--;
+				kmers_anchors[i].len += kmers_anchors[i - 1].len;
+				kmers_anchors.erase(kmers_anchors.begin() + i - 1);
 			}
 		}
 		//expand to the right
@@ -969,24 +902,16 @@ AnalyseRefReadWithKmersRes CEncoder::AnalyseRefReadWithKmers(CKmers& enc_kmers,
 			auto pos_enc = kmers_anchors[i].pos_in_enc + kmers_anchors[i].len;
 			auto pos_ref = kmers_anchors[i].pos_in_ref + kmers_anchors[i].len;
 
-			while (true)
+			uint32_t gap_enc = next_anch_start_enc - pos_enc;
+			uint32_t gap_ref = next_anch_start_ref - pos_ref;
+			uint32_t n_match = packed_match_right(enc_read, pos_enc, ref_read, pos_ref, std::min(gap_enc, gap_ref));
+			kmers_anchors[i].len += n_match;
+
+			if (n_match == gap_enc && n_match == gap_ref) //merge anchors
 			{
-				bool next_reached_enc = pos_enc == next_anch_start_enc;
-				bool next_reached_ref = pos_ref == next_anch_start_ref;
-				if (next_reached_enc && next_reached_ref) //merge anchors
-				{
-					kmers_anchors[i].len += kmers_anchors[i + 1].len;
-					kmers_anchors.erase(kmers_anchors.begin() + i + 1);
-					--i;
-					break;
-				}
-				else if (next_reached_enc || next_reached_ref)
-					break;
-				if (enc_read[pos_enc] != ref_read[pos_ref])
-					break;
-				++pos_enc;
-				++pos_ref;
-				++kmers_anchors[i].len;
+				kmers_anchors[i].len += kmers_anchors[i + 1].len;
+				kmers_anchors.erase(kmers_anchors.begin() + i + 1);
+				--i;
 			}
 		}
 	}
@@ -995,14 +920,7 @@ AnalyseRefReadWithKmersRes CEncoder::AnalyseRefReadWithKmers(CKmers& enc_kmers,
 	auto& last_anchor = kmers_anchors[kmers_anchors.size() - 1];
 	auto pos_enc = last_anchor.pos_in_enc + last_anchor.len;
 	auto pos_ref = last_anchor.pos_in_ref + last_anchor.len;
-	while (pos_enc < read_len(enc_read) && pos_ref < read_len(ref_read))
-	{
-		if (enc_read[pos_enc] != ref_read[pos_ref])
-			break;
-		++pos_enc;
-		++pos_ref;
-		++last_anchor.len;
-	}
+	last_anchor.len += packed_match_right(enc_read, pos_enc, ref_read, pos_ref, std::min(enc_read.size() - pos_enc, ref_read.size() - pos_ref));
 
 	candidate.anchors = std::move(kmers_anchors);
 	candidate.tot_anchor_len = 0;
@@ -1013,9 +931,11 @@ AnalyseRefReadWithKmersRes CEncoder::AnalyseRefReadWithKmers(CKmers& enc_kmers,
 }
 
 
-AnalyseRefReadRes CEncoder::AnalyseRefRead(CMmers& encode_mmers, CBloomFilter &bloom_mmers, const read_t& enc_read, const read_t& ref_read, Candidate& candidate, int decision)
+AnalyseRefReadRes CEncoder::AnalyseRefRead(CMmers& encode_mmers, CBloomFilter &bloom_mmers, const read_t& enc_read, const packed_read_view& ref_read, Candidate& candidate, int decision)
 {
-	CMmers candidate_mmers(ref_read, anchor_len, encode_mmers, bloom_mmers);
+	//the m-mers of the candidate are given back to the arena when it is analysed
+	CArenaScope arena_scope(arena);
+	CMmers candidate_mmers(ref_read, anchor_len, encode_mmers, bloom_mmers, arena);
 
 	std::vector<std::pair<anchor_type, std::vector<uint32_t>>> inter_mmers_enc_read_vec;
 	std::vector<std::pair<anchor_type, std::vector<uint32_t>>> inter_mmers_ref_read_vec;
@@ -1042,7 +962,7 @@ AnalyseRefReadRes CEncoder::AnalyseRefRead(CMmers& encode_mmers, CBloomFilter &b
 	}
 
 	auto sorted_mmers_enc_vec = Convert(inter_mmers_enc_read_vec, read_len(enc_read));
-	auto sorted_mmers_ref_vec = Convert(inter_mmers_ref_read_vec, read_len(ref_read));
+	auto sorted_mmers_ref_vec = Convert(inter_mmers_ref_read_vec, ref_read.size());
 
 	std::vector<std::tuple<anchor_type, uint32_t, uint32_t>> aligned_mmers_vec = get_aligned_mmers_LIS(sorted_mmers_enc_vec, sorted_mmers_ref_vec, inter_mmers_ref_read_vec);
 
@@ -1061,8 +981,8 @@ EncodeCandidates CEncoder::prepareEncodeCandidates(const read_t& enc_read, const
 	//res.encode.enc_read_id = enc_id;
 	//const auto& enc_read = reads.GetRead(enc_id);
 
-	CMmers encode_mmers(enc_read, anchor_len);
-	CBloomFilter bloom_mmers(enc_read, anchor_len);
+	CMmers encode_mmers(enc_read, anchor_len, arena);
+	CBloomFilter bloom_mmers(enc_read, anchor_len, arena);
 
 	int decision = -1; //0 - encode, 1 - refuse, other - not know yet
 
@@ -1080,19 +1000,27 @@ EncodeCandidates CEncoder::prepareEncodeCandidates(const read_t& enc_read, const
 	bool refused_too_many_matches = false;
 	bool refused_too_low_anchors = false;
 
-	for (const auto ref_read_id : neighbours)
+	for (uint64_t i = 0; i < neighbours.size(); ++i)
 	{
+		if (effortExceeded())
+		{
+			stats.LogEffortSkippedCandidates(neighbours.size() - i);
+			break;
+		}
+		const auto ref_read_id = neighbours[i];
+
 		Candidate candidate;
 		candidate.ref_read_id = ref_read_id;
-		auto ref_read = reference_reads.GetRefRead(ref_read_id);
+		auto ref_read = reference_reads.GetPackedRefRead(ref_read_id, false);
 
 		Candidate rev_compl_candidate;
 		rev_compl_candidate.ref_read_id = ref_read_id;
 		rev_compl_candidate.shouldReverse = true;
 //		auto rev_compl_ref_read = get_rev_compl(ref_read);
-		auto rev_compl_ref_read = reference_reads.GetRefRead(ref_read_id, true);
+		auto rev_compl_ref_read = reference_reads.GetPackedRefRead(ref_read_id, true);
 
 		MmerBasedAnchors(encode_mmers, bloom_mmers, enc_read, ref_read, rev_compl_ref_read, candidate, rev_compl_candidate, decision, res, refused_too_many_matches, refused_too_low_anchors);
+		effort_used += 2 * ref_read.size();
 	}
 
 	if (res.candidates.empty())
@@ -1111,8 +1039,8 @@ EncodeCandidates CEncoder::prepareEncodeCandidates(const read_t& enc_read, const
 }
 
 bool CEncoder::KmerBasedAnchors(CKmersHashMapLP& enc_kmers, CBloomFilter& bloom_kmers, 
-	const read_t& enc_read, const read_t& ref_read,
-	const read_t& rev_compl_ref_read, Candidate& candidate, Candidate& rev_compl_candidate,  const std::vector<kmer_type>& common_kmers, EncodeCandidates& res)
+	const packed_read_view& enc_read, const packed_read_view& ref_read,
+	const packed_read_view& rev_compl_ref_read, Candidate& candidate, Candidate& rev_compl_candidate,  const std::vector<kmer_type>& common_kmers, EncodeCandidates& res)
 {
 	CKmersHashSetLP com_kmers(common_kmers);
 	AnalyseRefReadWithKmersRes rev_cmpl_analyse_with_kmers_res = AnalyseRefReadWithKmers(enc_kmers, bloom_kmers, enc_read, rev_compl_ref_read, rev_compl_candidate, com_kmers);
@@ -1147,7 +1075,7 @@ bool CEncoder::KmerBasedAnchors(CKmersHashMapLP& enc_kmers, CBloomFilter& bloom_
 }
 
 void CEncoder::MmerBasedAnchors(CMmers& encode_mmers, CBloomFilter& bloom_mmers,
-	const read_t& enc_read, const read_t& ref_read, const read_t& rev_compl_ref_read,
+	const read_t& enc_read, const packed_read_view& ref_read, const packed_read_view& rev_compl_ref_read,
 	Candidate& candidate, Candidate& rev_compl_candidate, int decision, EncodeCandidates& res,
 	bool& refused_too_many_matches, bool& refuled_too_low_anchors)
 {
@@ -1197,8 +1125,8 @@ EncodeCandidates CEncoder::prepareEncodeCandidatesHiFi(const read_t& enc_read, c
 	//res.encode.enc_read_id = enc_id;
 	//const auto& enc_read = reads.GetRead(enc_id);
 
-	CMmers encode_mmers(enc_read, anchor_len);
-	CBloomFilter bloom_mmers(enc_read, anchor_len);
+	CMmers encode_mmers(enc_read, anchor_len, arena);
+	CBloomFilter bloom_mmers(enc_read, anchor_len, arena);
 
 	int decision = -1; //0 - encode, 1 - refuse, other - not know yet
 
@@ -1216,23 +1144,33 @@ EncodeCandidates CEncoder::prepareEncodeCandidatesHiFi(const read_t& enc_read, c
 	bool refused_too_many_matches = false;
 	bool refuled_too_low_anchors = false;
 	
-	CKmersHashMapLP enc_kmers(enc_read, kmerLen);
-	CBloomFilter bloom_kmers(enc_read, kmerLen, true);
+	CKmersHashMapLP enc_kmers(enc_read, kmerLen, arena);
+	CBloomFilter bloom_kmers(enc_read, kmerLen, arena, true);
+
+	//anchors are extended by comparing packed reads
+	read_t packed_enc_read_data = pack_read(enc_read);
+	packed_read_view packed_enc_read(packed_enc_read_data);
 
 	for (uint64_t i = 0; i < neighbours.size(); ++i)
 	{
+		if (effortExceeded())
+		{
+			stats.LogEffortSkippedCandidates(neighbours.size() - i);
+			break;
+		}
 		const auto ref_read_id = neighbours[i];
 
 		Candidate candidate;
 		candidate.ref_read_id = ref_read_id;
-		auto ref_read = reference_reads.GetRefRead(ref_read_id);
+		auto ref_read = reference_reads.GetPackedRefRead(ref_read_id, false);
 
 		Candidate rev_compl_candidate;
 		rev_compl_candidate.ref_read_id = ref_read_id;
 		rev_compl_candidate.shouldReverse = true;
-		auto rev_compl_ref_read = reference_reads.GetRefRead(ref_read_id, true);
+		auto rev_compl_ref_read = reference_reads.GetPackedRefRead(ref_read_id, true);
 
-		if (KmerBasedAnchors(enc_kmers, bloom_kmers, enc_read, ref_read, rev_compl_ref_read, candidate, rev_compl_candidate, common_kmers[i], res))
+		effort_used += 2 * ref_read.size();
+		if (KmerBasedAnchors(enc_kmers, bloom_kmers, packed_enc_read, ref_read, rev_compl_ref_read, candidate, rev_compl_candidate, common_kmers[i], res))
 			continue;
 
 		//if k-mer based anchors analysis fails
@@ -1260,6 +1198,10 @@ EditDistRes CEncoder::GetEditDist(read_view refPart, read_view encPart, uint32_t
 	EditDistRes ed;
 
 	uint32_t max_symbols_for_flank = static_cast<uint32_t>(encPart.size() * 2);
+	//bit-parallel alignment processes a word of the reference part per symbol of the encoded part
+	uint64_t aligned_ref_len = (frag_no == 0 || frag_no == n_fragments - 1) ? std::min<uint64_t>(refPart.size(), max_symbols_for_flank) : refPart.size();
+	effort_used += encPart.size() * (aligned_ref_len / 64 + 1);
+
 	if (frag_no == 0)
 	{
 		uint32_t ref_offset;
@@ -1275,13 +1217,41 @@ EditDistRes CEncoder::GetEditDist(read_view refPart, read_view encPart, uint32_t
 	}
 	else
 	{
-		ed = find_edit_dist_with_edlib_ex(refPart, encPart);
+		if (!AlignInBand(refPart, encPart, ed))
+			ed = find_edit_dist_with_edlib_ex(refPart, encPart);
 		refactor_edit_script(refPart, encPart, ed.editScript);
+
+		read_aligned_edits += ed.editDist;
+		read_aligned_symb += encPart.size();
+		tot_aligned_edits += ed.editDist;
+		tot_aligned_symb += encPart.size();
 	}
 
 	return ed;
 }
 
+bool CEncoder::AlignInBand(read_view refPart, read_view encPart, EditDistRes& ed)
+{
+	//short parts are aligned in a single word anyway
+	if (refPart.size() <= bit_parallel_max_query_len)
+		return false;
+
+	//the fragment lies between two anchors, so the alignment follows the diagonal joining them, the band is widened by the expected number of edits
+	const double prior_weight = 64;
+	double prior_rate = tot_aligned_symb ? static_cast<double>(tot_aligned_edits) / tot_aligned_symb : 0.2;
+	double rate = (read_aligned_edits + prior_rate * prior_weight) / (read_aligned_symb + prior_weight);
+
+	uint64_t len_diff = refPart.size() > encPart.size() ? refPart.size() - encPart.size() : encPart.size() - refPart.size();
+	uint64_t max_edit_dist = len_diff + static_cast<uint64_t>(2 * rate * std::max(refPart.size(), encPart.size())) + 8;
+
+	stats.LogBandedAlignment();
+	if (banded_aligner.Align(refPart, encPart, static_cast<uint32_t>(std::min<uint64_t>(max_edit_dist, refPart.size() + encPart.size())), ed))
+		return true;
+
+	stats.LogBandExceeded();
+	return false;
+}
+
 
 
 uint32_t CEncoder::CountDeletions(std::string_view es)
@@ -1453,14 +1423,22 @@ void CEncoder::EncodePart(uint32_t level, read_view encode_read, uint32_t frag_n
 	read_view refPart = read_view(ref_read).substr(cur_pos_in_ref_read, end_ref - cur_pos_in_ref_read);
 	read_view encPart = encode_read.substr(cur_pos_in_encode_read, end_enc - cur_pos_in_encode_read);
 
-	EditDistRes ed = GetEditDist(refPart, encPart, frag_no, n_fragments);
-
-	bool decision;
+	//if the effort budget is exceeded the remaining parts are stored plain
+	bool effort_exceeded = effortExceeded();
+	EditDistRes ed;
+	bool decision = false;
 
-	if (encPart.length() < minPartLenToConsiderAltRead)
-		decision = entropyEstimator.EncodeWithEditScript(ed.editScript, encPart, refPart.length());
+	if (effort_exceeded)
+		stats.LogEffortPlainSymb(encPart.length());
 	else
-		decision = EncodeWithEditScript(ed, refPart, encPart, frag_no, n_fragments);
+	{
+		ed = GetEditDist(refPart, encPart, frag_no, n_fragments);
+
+		if (encPart.length() < minPartLenToConsiderAltRead)
+			decision = entropyEstimator.EncodeWithEditScript(ed.editScript, encPart, refPart.length());
+		else
+			decision = EncodeWithEditScript(ed, refPart, encPart, frag_no, n_fragments);
+	}
 
 	//if (EncodeWithEditScript(ed, refPart, encPart, frag_no, n_fragments))
 //	if(entropyEstimator.EncodeWithEditScript(ed.editScript, encPart, refPart.length()))
@@ -1475,7 +1453,7 @@ void CEncoder::EncodePart(uint32_t level, read_view encode_read, uint32_t frag_n
 	{
 		std::vector<Candidate> alt_candidates;
 
-		if (EncodeWithAlternativeRead(candidates, level, encPart, cur_pos_in_encode_read, end_enc, alt_candidates))
+		if (!effort_exceeded && EncodeWithAlternativeRead(candidates, level, encPart, cur_pos_in_encode_read, end_enc, alt_candidates))
 		{
 			if (frag_no == n_fragments - 1)
 				stats.ComprStats(level).n_alternative_right_flank++;
@@ -1632,6 +1610,11 @@ void CEncoder::processComprElem(const CCompressElem& compr_elem)
 		return;
 	}
 	entropyEstimator.LogRead(compr_elem.read);
+	effort_budget = static_cast<uint64_t>(maxEncodeEffort * read_len(compr_elem.read));
+	effort_used = 0;
+	arena.Reset();
+	read_aligned_edits = 0;
+	read_aligned_symb = 0;
 	if (neighbours.empty())
 	{
 		AddPlainRead(compr_elem.read);
@@ -1644,6 +1627,8 @@ void CEncoder::processComprElem(const CCompressElem& compr_elem)
 
 	if (encodeCandidates.candidates.empty())
 	{
+		if (effortExceeded())
+			stats.LogEffortExceeded();
 		AddPlainRead(compr_elem.read);
 		return;
 	}
@@ -1658,6 +1643,8 @@ void CEncoder::processComprElem(const CCompressElem& compr_elem)
 	
 	current_encoded_reads.emplace_back();
 	AddEncodedReadWithCandidates(compr_elem.read, encodeCandidates.candidates, 0, current_encoded_reads.back(), encodeCandidates.candidates[0].ref_read_id, first);
+	if (effortExceeded())
+		stats.LogEffortExceeded();
 }
 
 
@@ -29,6 +29,8 @@
 #include "hs.h"
 #include "murmur64_hash.h"
 #include "reference_reads.h"
+#include "banded_align.h"
+#include "arena.h"
 #include "parallel_queue.h"
 #include <chrono>
 #include "../common/libs/libdivide/libdivide.h"
@@ -73,14 +75,13 @@ class CBloomFilter
 {
 #define BLOOM_1_FUNC
 	uint64_t* data;
-	uint64_t* raw_data;
 	uint64_t size_in_bits;
 	uint64_t size_mask;
 	uint64_t word_mask;
 	const uint64_t sub_bits = 6;
 	const uint64_t sub_mask = (1ull << sub_bits) - 1ull;
 
-	void allocate(uint64_t no_items)
+	void allocate(uint64_t no_items, CArena& arena)
 	{
 		if (no_items < 64)
 			no_items = 64;
@@ -100,22 +101,12 @@ class CBloomFilter
 		size_mask = size_in_bits - 1ull;
 		word_mask = size_mask >> 6;
 
-		raw_data = new uint64_t[size_in_words + 8];
-		data = raw_data + 8 - (((uint64_t)raw_data) / 8) % 8;
+		data = static_cast<uint64_t*>(arena.Allocate(size_in_words * sizeof(uint64_t), 64));
 
 //		std::fill_n(data, size_in_words, 0ull);
 		std::fill_n(data, size_in_words, ~0ull);
 	}
 
-	void deallocate()
-	{
-		if (raw_data)
-		{
-			delete[] raw_data;
-			raw_data = nullptr;
-		}
-	}
-
 	uint64_t basic_hash(uint64_t h)
 	{
 		h ^= h >> 33;
@@ -161,12 +152,13 @@ class CBloomFilter
 	}
 
 public:
-	explicit CBloomFilter(const read_t& read, uint32_t m, bool canonical = false) : raw_data(nullptr)
+	// the filter lives in the arena, so it must not outlive the arena scope in which it was created
+	explicit CBloomFilter(const read_t& read, uint32_t m, CArena& arena, bool canonical = false) : data(nullptr)
 	{
 		if (read_len(read) < m)
 			return;
 
-		allocate(read_len(read) - m + 1);
+		allocate(read_len(read) - m + 1, arena);
 
 		anchor_type mask = (1ull << (2 * m)) - 1;
 
@@ -269,10 +261,6 @@ public:
 #endif
 	}*/
 
-	~CBloomFilter()
-	{
-		deallocate();
-	}
 };
 
 
@@ -290,6 +278,7 @@ class CEncoder
 	double minFractionOfMmersInEncodeToAlwaysEncode;
 	double minFractionOfMmersInEncode;
 	double maxMatchesMultiplier;
+	double maxEncodeEffort;
 	double editScriptCostMultiplier;
 	uint32_t minPartLenToConsiderAltRead;
 	uint32_t maxRecurence;	
@@ -301,16 +290,38 @@ class CEncoder
 	DataSource dataSource;
 
 	CEntropyEstimator entropyEstimator;
-	AnalyseRefReadRes AnalyseRefRead(CMmers& encode_mmers, CBloomFilter& bloom_mmers, const read_t& enc_read, const read_t& ref_read, Candidate& candidate, int decision);
-	AnalyseRefReadWithKmersRes AnalyseRefReadWithKmers(CKmers& enc_kmers, CBloomFilter& bloom_kmers, const read_t& enc_read, const read_t& ref_read, Candidate& candidate, CKmersHashSetLP& common_kmers);
+
+	// work spent on the current read (scanned candidate symbols and alignment words) and its limit (0 - no limit)
+	uint64_t effort_budget{};
+	uint64_t effort_used{};
+
+	bool effortExceeded() const
+	{
+		return effort_budget && effort_used > effort_budget;
+	}
+
+	// long middle fragments are aligned in a band sized from the edit rate seen so far in the current read (and in all reads before)
+	CBandedAligner banded_aligner;
+
+	// per read temporaries (hash tables of m-mers and k-mers, Bloom filters), given back at the beginning of each read
+	CArena arena;
+	uint64_t read_aligned_edits{};
+	uint64_t read_aligned_symb{};
+	uint64_t tot_aligned_edits{};
+	uint64_t tot_aligned_symb{};
+
+	bool AlignInBand(read_view refPart, read_view encPart, EditDistRes& ed);
+
+	AnalyseRefReadRes AnalyseRefRead(CMmers& encode_mmers, CBloomFilter& bloom_mmers, const read_t& enc_read, const packed_read_view& ref_read, Candidate& candidate, int decision);
+	AnalyseRefReadWithKmersRes AnalyseRefReadWithKmers(CKmers& enc_kmers, CBloomFilter& bloom_kmers, const packed_read_view& enc_read, const packed_read_view& ref_read, Candidate& candidate, CKmersHashSetLP& common_kmers);
 
 	bool KmerBasedAnchors(CKmersHashMapLP& enc_kmers, CBloomFilter& bloom_mmers, 
-		const read_t& enc_read, const read_t& ref_read,
-		const read_t& rev_compl_ref_read, Candidate& candidate, Candidate& rev_compl_candidate,
+		const packed_read_view& enc_read, const packed_read_view& ref_read,
+		const packed_read_view& rev_compl_ref_read, Candidate& candidate, Candidate& rev_compl_candidate,
 		const std::vector<kmer_type>& common_kmers, EncodeCandidates& res);
 
 	void MmerBasedAnchors(CMmers& encode_mmers, CBloomFilter& bloom_mmers,
-		const read_t& enc_read, const read_t& ref_read, const read_t& rev_compl_ref_read,
+		const read_t& enc_read, const packed_read_view& ref_read, const packed_read_view& rev_compl_ref_read,
 		Candidate& candidate, Candidate& rev_compl_candidate, int decision, EncodeCandidates& res,
 		bool& refused_too_many_matches, bool& refules_too_low_anchors);
 	
@@ -377,6 +388,7 @@ public:
 		double minFractionOfMmersInEncodeToAlwaysEncode,
 		double minFractionOfMmersInEncode,
 		double maxMatchesMultiplier,
+		double maxEncodeEffort,
 		double editScriptCostMultiplier,
 		uint32_t minPartLenToConsiderAltRead,
 		uint32_t maxRecurence,	
@@ -395,6 +407,7 @@ public:
 		minFractionOfMmersInEncodeToAlwaysEncode(minFractionOfMmersInEncodeToAlwaysEncode),
 		minFractionOfMmersInEncode(minFractionOfMmersInEncode),
 		maxMatchesMultiplier(maxMatchesMultiplier),
+		maxEncodeEffort(maxEncodeEffort),
 		editScriptCostMultiplier(editScriptCostMultiplier),
 		minPartLenToConsiderAltRead(minPartLenToConsiderAltRead),
 		maxRecurence(maxRecurence),		
@@ -25,21 +25,34 @@ void CEntrComprHeaders::Compress()
 	header_pack_t headers_pack;
 	std::vector<uint8_t> v_output;
 
-	id_coder.Init(true, headerComprMode, compression_level);
+	bool is_first_part = true;
 
 	while (headers_queue.Pop(headers_pack))
 	{
+		bool is_restart = is_first_part || independent_parts;
+		if (is_restart)
+		{
+			id_coder = std::make_unique<entropy_coder::CIDCoder>(verbose);
+			id_coder->Init(true, headerComprMode, compression_level);
+		}
+
+		uint64_t n_symbols = 0;
 		for (const auto& [id, plus_id] : headers_pack)
-			id_coder.Encode(plus_id == qual_header_type::eq_read_header, id);
+		{
+			id_coder->Encode(plus_id == qual_header_type::eq_read_header, id);
+			n_symbols += id.size();
+		}
 
-		id_coder.Finish();
+		id_coder->Finish();
 
-		id_coder.GetOutput(v_output);
-		id_coder.Restart();
+		id_coder->GetOutput(v_output);
+		id_coder->Restart();
 
 		uint32_t n_reads = static_cast<uint32_t>(headers_pack.size());
 
 		archive.AddPart(s_header, v_output, n_reads);
+		archive_index.AddPart("header", n_reads, n_symbols, is_restart);
+		is_first_part = false;
 		v_output.clear();
 	}
 }
@@ -47,30 +60,40 @@ void CEntrComprHeaders::Compress()
 // *******************************************************************************************
 void CEntrDecomprHeaders::Decompress()
 {
-	std::vector<uint8_t> v_input, v_compressed;
+	CArchivePart part;
 	size_t n_reads;
 	header_pack_t pack;
 
-	id_coder.Init(false, headerComprMode, compression_level);
-
 	string id;
 	bool plus_id;
 
-	while (archive.GetPart(s_header, v_compressed, n_reads))
+	uint64_t first_read = start_first_read;
+	archive.SetCurrentPart(s_header, start_part);
+
+	while (first_read < range.to && archive.GetPart(s_header, part, n_reads))
 	{
-		id_coder.SetInput(v_compressed);
-		id_coder.Restart();
+		if (!id_coder || independent_parts)
+		{
+			id_coder = std::make_unique<entropy_coder::CIDCoder>(verbose);
+			id_coder->Init(false, headerComprMode, compression_level);
+		}
+		id_coder->SetInput(part.data, part.size);
+		id_coder->Restart();
 
 		for (uint32_t i = 0; i < n_reads; ++i)
 		{
-			id_coder.Decode(plus_id, id);
+			id_coder->Decode(plus_id, id);
 			pack.emplace_back(std::move(id), plus_id ? qual_header_type::eq_read_header : qual_header_type::empty);
 		}
 
-		id_coder.Finish();
+		id_coder->Finish();
+
+		range.Trim(pack, first_read);
+		first_read += n_reads;
 
-		if (!header_decompr_queue.PushOrCancel(std::move(pack)))
+		if (!pack.empty() && !header_decompr_queue.PushOrCancel(std::move(pack)))
 			break;
+		pack.clear();
 	}
 
 	/*if (pack.size())
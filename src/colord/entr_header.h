@@ -21,32 +21,41 @@
 #include "utils.h"
 #include "parallel_queue.h"
 #include "archive.h"
+#include "archive_index.h"
 #include "params.h"
 #include "id_coder.h"
+#include <memory>
 
 class CEntrComprHeaders
 {
 	CParallelQueue<header_pack_t>& headers_queue;
 	CArchive& archive;
+	CArchiveIndex& archive_index;
 	int s_header;
 	HeaderComprMode headerComprMode;	
 	int32_t compression_level;
+	bool verbose;
+	bool independent_parts;		// each part is coded with fresh models, so it is a restart point
 
-	entropy_coder::CIDCoder id_coder;
+	std::unique_ptr<entropy_coder::CIDCoder> id_coder;
 
 public:
 	CEntrComprHeaders(CParallelQueue<header_pack_t>& headers_queue, 		
 		CArchive& archive,
+		CArchiveIndex& archive_index,
 		HeaderComprMode headerComprMode,
 		int32_t compression_level,
-		bool verbose) :
+		bool verbose,
+		bool independent_parts) :
 
 		headers_queue(headers_queue),		
 		archive(archive),
+		archive_index(archive_index),
 		s_header(archive.RegisterStream("header")),
 		headerComprMode(headerComprMode),
 		compression_level(compression_level),
-		id_coder(verbose)
+		verbose(verbose),
+		independent_parts(independent_parts)
 	{
 	}
 
@@ -65,21 +74,35 @@ class CEntrDecomprHeaders
 	int s_header;
 	HeaderComprMode headerComprMode;
 	int32_t compression_level;
-	entropy_coder::CIDCoder id_coder;
+	bool verbose;
+	bool independent_parts;
+	std::unique_ptr<entropy_coder::CIDCoder> id_coder;
+
+	const CReadsRange& range;
+	size_t start_part;			// first part to decode (restart point)
+	uint64_t start_first_read;	// ordinal of the first read in start_part
 
 public:
 	CEntrDecomprHeaders(CArchive& archive,
 		CParallelQueue<header_pack_t>& header_decompr_queue,
 		HeaderComprMode headerComprMode,
 		int32_t compression_level,
-		bool verbose) :
+		bool verbose,
+		bool independent_parts,
+		const CReadsRange& range,
+		size_t start_part,
+		uint64_t start_first_read) :
 
 		archive(archive),
 		header_decompr_queue(header_decompr_queue),
 		s_header(archive.GetStreamId("header")),
 		headerComprMode(headerComprMode),
 		compression_level(compression_level),
-		id_coder(verbose)
+		verbose(verbose),
+		independent_parts(independent_parts),
+		range(range),
+		start_part(start_part),
+		start_first_read(start_first_read)
 	{
 	}
 
@@ -21,16 +21,36 @@
 #include "utils.h"
 #include "parallel_queue.h"
 #include "archive.h"
+#include "archive_index.h"
 #include "quality_coder.h"
+#include "block_splitter.h"
+#include "pooled_threads.h"
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 
 class CEntrComprQuals
 {
 	CParallelQueue<qual_pack_t>& quals_queue;	
 	CArchive& archive;
+	CArchiveIndex& archive_index;
 	int s_qual;
-	entropy_coder::CQualityCoder quality_coder;
+	std::unique_ptr<entropy_coder::CQualityCoder> quality_coder;
+
+	QualityComprMode qualityComprMode;
+	const std::vector<uint32_t>& qualityFwdThresholds;
+	const std::vector<uint32_t>& qualityRevThresholds;
+	bool verbose;
+	int32_t compression_level;
+	uint64_t approx_input_stream_size;
+
+	CBlockSplitter qual_block_splitter;
+	bool is_block_start = false;
 
 	size_t q_size = 0;
+	uint64_t n_part_reads{};
+	uint64_t n_part_symbols{};
 
 	CParallelPriorityQueue<std::vector<es_t>>& edit_script_for_qual_queue;
 	
@@ -65,20 +85,35 @@ class CEntrComprQuals
 		return true;
 	}
 
+	// Each block is coded with fresh models
+	void startPart()
+	{
+		is_block_start = qual_block_splitter.NextPack(quals_pack.size());
+		if (!is_block_start)
+			return;
+
+		quality_coder = std::make_unique<entropy_coder::CQualityCoder>(verbose);
+		quality_coder->Init(true, qualityComprMode, dataSource, qualityFwdThresholds, qualityRevThresholds, compression_level, approx_input_stream_size);
+	}
+
 	void storeCurEncoded(std::vector<uint8_t>& v_output)
 	{
-		quality_coder.Finish();
+		quality_coder->Finish();
 
-		quality_coder.GetOutput(v_output);
+		quality_coder->GetOutput(v_output);
 		archive.AddPart(s_qual, v_output, 0);
+		archive_index.AddPart("qual", n_part_reads, n_part_symbols, is_block_start);
 
 		q_size += v_output.size();
+		n_part_reads = 0;
+		n_part_symbols = 0;
 
-		quality_coder.Restart();
+		quality_coder->Restart();
 	}
 public:
 	CEntrComprQuals(CParallelQueue<qual_pack_t>& quals_queue,
 		CArchive& archive,
+		CArchiveIndex& archive_index,
 		QualityComprMode qualityComprMode,
 		const std::vector<uint32_t>& qualityFwdThresholds,
 		const std::vector<uint32_t>& qualityRevThresholds,
@@ -86,15 +121,22 @@ public:
 		int32_t compression_level,
 		uint64_t approx_input_stream_size,
 		CParallelPriorityQueue<std::vector<es_t>>& edit_script_for_qual_queue,
-		DataSource dataSource) :
+		DataSource dataSource,
+		uint32_t qualBlockSize) :
 		quals_queue(quals_queue),		
 		archive(archive),
+		archive_index(archive_index),
 		s_qual(archive.RegisterStream("qual")),
-		quality_coder(verbose),
+		qualityComprMode(qualityComprMode),
+		qualityFwdThresholds(qualityFwdThresholds),
+		qualityRevThresholds(qualityRevThresholds),
+		verbose(verbose),
+		compression_level(compression_level),
+		approx_input_stream_size(approx_input_stream_size),
+		qual_block_splitter(qualBlockSize),
 		edit_script_for_qual_queue(edit_script_for_qual_queue),
 		dataSource(dataSource)
 	{
-		quality_coder.Init(true, qualityComprMode, dataSource, qualityFwdThresholds, qualityRevThresholds, compression_level, approx_input_stream_size);
 	}
 	
 	void Compress()
@@ -111,7 +153,11 @@ public:
 		while (hasNextReadAndQual && hasNextEditScirpt)
 		{
 			const auto& [read, qual] = read_and_qual;
-			quality_coder.Encode(read, qual, es); 
+			if (n_part_reads == 0)
+				startPart();
+			quality_coder->Encode(read, qual, es); 
+			++n_part_reads;
+			n_part_symbols += qual.size();
 
 			if(quals_pack_pos == quals_pack.size())
 				storeCurEncoded(v_output);
@@ -137,66 +183,210 @@ public:
 class CEntrDecomprQuals
 {	
 	CArchive& archive;
+	const CArchiveIndex& archive_index;
 	int s_qual;
 	CParallelQueue<decomp_read_pack_t>& read_decompr_queue;
 	CParallelQueue<decomp_qual_pack_t>& qual_decompr_queue;
 
 	entropy_coder::CQualityCoder quality_coder;
 
-	std::vector<uint8_t> v_archive;
+	bool verbose;
+	QualityComprMode qualityComprMode;
+	DataSource dataSource;
+	const std::vector<uint32_t>& qualityFwdThresholds;
+	const std::vector<uint32_t>& qualityRevThresholds;
+	int32_t compression_level;
+	uint64_t approx_output_stream_size;
+
+	CArchivePart qual_part;
 
-	decomp_read_pack_t read_pack;
-	uint32_t read_pack_pos{};
-	decomp_qual_pack_t qual_pack;
+	bool qual_blocks;
+	uint32_t n_threads;
 
-	bool nextCompressedQual(std::vector<uint8_t>& read, std::vector<uint8_t>& qual, bool& cancel)
+	const CReadsRange& range;
+	size_t start_part;			// first quality part to decode (restart point)
+	size_t reads_start_part;	// part of the first read pack in read_decompr_queue
+	uint64_t reads_first_read;	// ordinal of the first read in read_decompr_queue
+
+	struct block_t
+	{
+		size_t first_part;
+		uint64_t first_read;
+		std::vector<decomp_read_pack_t> read_packs;
+		std::vector<decomp_qual_pack_t> qual_packs;
+		pooled_threads::thread th;
+	};
+
+	void decompressSequential()
 	{
-		if (read_pack_pos == 0)
-			return false;
+		decomp_read_pack_t read_pack;
+		decomp_qual_pack_t qual_pack;
+		std::vector<uint8_t> qual;
+		bool cancel = false;
 
-		if (read_pack_pos == 1)
-		{
-			size_t meta;
-			if (!archive.GetPart(s_qual, v_archive, meta))
-				return false;
+		size_t part_id = reads_start_part;
+		uint64_t first_read = reads_first_read;
 
-			if (!qual_pack.empty())
+		archive.SetCurrentPart(s_qual, start_part);
+
+		while (!cancel && read_decompr_queue.Pop(read_pack))
+		{
+			if (part_id >= start_part)
 			{
-				if (!qual_decompr_queue.PushOrCancel(std::move(qual_pack)))
+				size_t meta;
+				if (!archive.GetPart(s_qual, qual_part, meta))
+				{
+					std::cerr << "Error: cirtical, contact authors, file: " << __FILE__ << ", line: " << __LINE__ << "\n";
+					exit(1);
+				}
+
+				quality_coder.SetInput(qual_part.data, qual_part.size);
+				quality_coder.Restart();
+
+				for (auto& read : read_pack)
+				{
+					qual.clear();
+					quality_coder.Decode(read, qual);
+					qual_pack.emplace_back(qual.begin(), qual.end());
+				}
+
+				range.Trim(qual_pack, first_read);
+				if (!qual_pack.empty() && !qual_decompr_queue.PushOrCancel(std::move(qual_pack)))
 					cancel = true;
 				qual_pack.clear();
 			}
 
-			quality_coder.SetInput(v_archive);
-			quality_coder.Restart();
+			first_read += read_pack.size();
+			++part_id;
 		}
+	}
 
-		qual.clear();
+	// Each block is decoded with fresh models
+	void decompressBlock(block_t& block)
+	{
+		entropy_coder::CQualityCoder block_coder(verbose);
+		block_coder.Init(false, qualityComprMode, dataSource, qualityFwdThresholds, qualityRevThresholds, compression_level, approx_output_stream_size);
 
-/*		string q;
-		
-		quality_coder.Decode(read, q);
+		CArchivePart part;
+		std::vector<uint8_t> qual;
+		size_t meta;
 
-		qual.assign(q.begin(), q.end());*/
+		for (size_t i = 0; i < block.read_packs.size(); ++i)
+		{
+			if (!archive.GetPart(s_qual, block.first_part + i, part, meta))
+			{
+				std::cerr << "Error: cirtical, contact authors, file: " << __FILE__ << ", line: " << __LINE__ << "\n";
+				exit(1);
+			}
 
-		quality_coder.Decode(read, qual);
+			block_coder.SetInput(part.data, part.size);
+			block_coder.Restart();
 
-		return true;
+			block.qual_packs.emplace_back();
+			for (auto& read : block.read_packs[i])
+			{
+				qual.clear();
+				block_coder.Decode(read, qual);
+				block.qual_packs.back().emplace_back(qual.begin(), qual.end());
+			}
+		}
+		block.read_packs.clear();
 	}
 
-	bool nextRead(read_t& read)
+	// Blocks are collected from read packs and decoded by the threads of the pool, at most n_threads at the same time. Finished blocks are passed to the queue
+	// in the original order by another thread, so the writer gets the qualities of a block as soon as it is decoded. Each block is started when its last read pack arrives, so the output reads queue must have room for one block.
+	void decompressBlocks()
 	{
-		if (read_pack_pos == read_pack.size())
+		auto parts = archive_index.GetParts("qual");
+		if (!parts)
 		{
-			read_pack_pos = 0;
-			if (!read_decompr_queue.Pop(read_pack))
-				return false;
+			std::cerr << "Error: no quality parts in archive index\n";
+			exit(1);
 		}
-		read = std::move(read_pack[read_pack_pos++]);
-		return true;
+
+		CParallelQueue<std::unique_ptr<block_t>> blocks_queue(n_threads);
+		std::atomic<bool> cancel = false;
+
+		std::mutex mtx_running;
+		std::condition_variable cv_running;
+		uint32_t n_running = 0;
+
+		pooled_threads::thread emitter([&] {
+			std::unique_ptr<block_t> block;
+			while (blocks_queue.Pop(block))
+			{
+				block->th.join();
+				uint64_t first_read = block->first_read;
+				for (auto& qual_pack : block->qual_packs)
+				{
+					auto pack_size = qual_pack.size();
+					range.Trim(qual_pack, first_read);
+					if (!cancel && !qual_pack.empty() && !qual_decompr_queue.PushOrCancel(std::move(qual_pack)))
+						cancel = true;
+					first_read += pack_size;
+				}
+			}
+		});
+
+		std::unique_ptr<block_t> cur_block;
+		auto run_block = [&] {
+			auto& block = *cur_block;
+			{
+				std::unique_lock<std::mutex> lck(mtx_running);
+				cv_running.wait(lck, [&] { return n_running < n_threads; });
+				++n_running;
+			}
+			block.th = pooled_threads::thread([this, &block, &mtx_running, &cv_running, &n_running] {
+				decompressBlock(block);
+				std::lock_guard<std::mutex> lck(mtx_running);
+				--n_running;
+				cv_running.notify_one();
+			});
+			blocks_queue.Push(std::move(cur_block));
+		};
+
+		decomp_read_pack_t read_pack;
+		size_t part_id = reads_start_part;
+		uint64_t first_read = reads_first_read;
+
+		while (!cancel && read_decompr_queue.Pop(read_pack))
+		{
+			auto pack_size = read_pack.size();
+			if (part_id >= start_part)
+			{
+				if (part_id >= parts->size())
+				{
+					std::cerr << "Error: cirtical, contact authors, file: " << __FILE__ << ", line: " << __LINE__ << "\n";
+					exit(1);
+				}
+
+				if (!cur_block)
+				{
+					cur_block = std::make_unique<block_t>();
+					cur_block->first_part = part_id;
+					cur_block->first_read = first_read;
+				}
+				cur_block->read_packs.emplace_back(std::move(read_pack));
+
+				if (part_id + 1 == parts->size() || (*parts)[part_id + 1].restart)
+					run_block();
+			}
+
+			first_read += pack_size;
+			++part_id;
+		}
+
+		// Reads stream may end inside a block if only a range of reads is decoded
+		if (cur_block && !cancel)
+			run_block();
+
+		blocks_queue.MarkCompleted();
+		emitter.join();
 	}
+
 public:
 	CEntrDecomprQuals(CArchive& archive,
+		const CArchiveIndex& archive_index,
 		CParallelQueue<decomp_read_pack_t>& read_decompr_queue,
 		CParallelQueue<decomp_qual_pack_t>& qual_decompr_queue,
 		bool verbose,
@@ -205,51 +395,45 @@ public:
 		const std::vector<uint32_t>& qualityFwdThresholds,
 		const std::vector<uint32_t>& qualityRevThresholds,
 		int32_t compression_level,
-		uint64_t approx_output_stream_size) :
+		uint64_t approx_output_stream_size,
+		bool qual_blocks,
+		uint32_t n_threads,
+		const CReadsRange& range,
+		size_t start_part,
+		size_t reads_start_part,
+		uint64_t reads_first_read) :
 		archive(archive),
+		archive_index(archive_index),
 		s_qual(archive.GetStreamId("qual")),
 		read_decompr_queue(read_decompr_queue),
 		qual_decompr_queue(qual_decompr_queue),
-		quality_coder(verbose)
+		quality_coder(verbose),
+		verbose(verbose),
+		qualityComprMode(qualityComprMode),
+		dataSource(dataSource),
+		qualityFwdThresholds(qualityFwdThresholds),
+		qualityRevThresholds(qualityRevThresholds),
+		compression_level(compression_level),
+		approx_output_stream_size(approx_output_stream_size),
+		qual_blocks(qual_blocks),
+		n_threads(std::max(n_threads, 1u)),
+		range(range),
+		start_part(start_part),
+		reads_start_part(reads_start_part),
+		reads_first_read(reads_first_read)
 	{
-		quality_coder.Init(false, qualityComprMode, dataSource, qualityFwdThresholds, qualityRevThresholds, compression_level, approx_output_stream_size);
+		if (!qual_blocks)
+			quality_coder.Init(false, qualityComprMode, dataSource, qualityFwdThresholds, qualityRevThresholds, compression_level, approx_output_stream_size);
 	}
 
+	// Quality parts correspond 1:1 to read packs
 	void Decompress()
 	{
-		std::vector<uint8_t> qual;
-		read_t read;
-		bool cancel = false;
-		bool hasNextRead = nextRead(read);
-		bool hasNextQual = nextCompressedQual(read, qual, cancel);
-
-		while (!cancel && hasNextRead && hasNextQual)
-		{
-			qual_pack.emplace_back(qual.begin(), qual.end());
-//			for (auto c : qual)
-//				qual_pack.back().push_back(c);
-
-/*			if (qual_pack.size() == 1024)
-			{
-				qual_decompr_queue.Push(std::move(qual_pack));
-				qual_pack.clear();
-			}*/
-
-			hasNextRead = nextRead(read);
-			hasNextQual = nextCompressedQual(read, qual, cancel);
-		}
-
-		if (qual_pack.size())
-			if (!qual_decompr_queue.PushOrCancel(std::move(qual_pack)))
-				cancel = true;
-
-
-		if (!cancel && hasNextQual != hasNextRead)
-		{
-			std::cerr << "Error: cirtical, contact authors, file: " << __FILE__ << ", line: " << __LINE__ << "\n";
-			exit(1);
-		}
+		if (qual_blocks)
+			decompressBlocks();
+		else
+			decompressSequential();
 
 		qual_decompr_queue.MarkCompleted();
 	}
-};
\ No newline at end of file
+};
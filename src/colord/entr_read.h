@@ -22,17 +22,59 @@
 #include "parallel_queue.h"
 #include "dna_coder.h"
 #include "archive.h"
+#include "archive_index.h"
 #include "ref_reads_accepter.h"
+#include "block_splitter.h"
+#include "pooled_threads.h"
+#include <memory>
+#include <deque>
 
 class CEntrComprReads
 {
 	CParallelPriorityQueue<std::vector<es_t>>& compressed_queue;
-	entropy_coder::CDNACoder dna_coder;
+	std::unique_ptr<entropy_coder::CDNACoder> dna_coder;
+	CReferenceReads& ref_reads;
+	bool verbose;
+	uint32_t maxCandidates;
+	int32_t compression_level;
+	uint64_t approx_input_stream_size;
 	CArchive& archive;
+	CArchiveIndex& archive_index;
 	int s_dna;	
 	uint32_t tot_reads;
 	uint32_t n_ref_genome_pseudo_reads;
 
+	ReferenceReadsMode referenceReadsMode;
+	CRefReadsAccepter& ref_reads_accepter;
+	CBlockSplitter dna_block_splitter;
+
+	uint32_t cur_read_id;		// the same numbering as in the similarity graph (pseudo reads from the reference genome are first)
+	uint32_t cur_ref_read_id;	// id in reference reads of the next read accepted as reference
+
+	// Must give the same decisions as the similarity graph
+	void updateRefReadId(es_t& es)
+	{
+		tuple_types tuple_type = tuple_types::none;
+		uint32_t tuple_val1{};
+		uint32_t tuple_val2{};
+
+		es.restart_reading();
+		es.load(tuple_type, tuple_val1, tuple_val2);
+
+		bool acceptRefRead = tuple_type != tuple_types::start_plain_with_Ns;
+		if (referenceReadsMode == ReferenceReadsMode::Sparse)
+			acceptRefRead &= ref_reads_accepter.ShouldAddToReference(cur_read_id);
+
+		cur_ref_read_id += acceptRefRead;
+		++cur_read_id;
+	}
+
+	void startBlock()
+	{
+		dna_coder = std::make_unique<entropy_coder::CDNACoder>(ref_reads, verbose);
+		dna_coder->Init(true, maxCandidates, compression_level, approx_input_stream_size, cur_read_id);
+	}
+
 public:
 	CEntrComprReads(CParallelPriorityQueue<std::vector<es_t>>& compressed_queue,
 		CReferenceReads& ref_reads, bool verbose,
@@ -40,19 +82,33 @@ public:
 		int32_t compression_level,
 		uint64_t approx_input_stream_size,
 		CArchive& archive,
+		CArchiveIndex& archive_index,
 		uint32_t tot_reads,
-		uint32_t n_ref_genome_pseudo_reads
+		uint32_t n_ref_genome_pseudo_reads,
+		ReferenceReadsMode referenceReadsMode,
+		CRefReadsAccepter& ref_reads_accepter,
+		uint32_t dnaBlockSize
 		) :
 		compressed_queue(compressed_queue),
-		dna_coder(ref_reads, verbose),	
+		ref_reads(ref_reads),
+		verbose(verbose),
+		maxCandidates(maxCandidates),
+		compression_level(compression_level),
+		approx_input_stream_size(approx_input_stream_size),
 		archive(archive),
+		archive_index(archive_index),
 		s_dna(archive.RegisterStream("dna")),
 		tot_reads(tot_reads),
-		n_ref_genome_pseudo_reads(n_ref_genome_pseudo_reads)
+		n_ref_genome_pseudo_reads(n_ref_genome_pseudo_reads),
+		referenceReadsMode(referenceReadsMode),
+		ref_reads_accepter(ref_reads_accepter),
+		dna_block_splitter(dnaBlockSize),
+		cur_read_id(n_ref_genome_pseudo_reads),
+		cur_ref_read_id(n_ref_genome_pseudo_reads)
 	{
-		dna_coder.Init(true, maxCandidates, compression_level, approx_input_stream_size, n_ref_genome_pseudo_reads);
 	}
 
+	// In DNA blocks mode each block is coded with fresh models and each part starts with the id (in reference reads) of its first read
 	void Compress()
 	{
 		std::vector<es_t> encoded_redas_part;
@@ -61,19 +117,36 @@ public:
 		CPercentProgress progress(tot_reads);
 		while (compressed_queue.Pop(encoded_redas_part))
 		{	
-			for (const auto& encoded_read : encoded_redas_part)
+			size_t n_reads = encoded_redas_part.size();
+
+			bool is_block_start = dna_block_splitter.NextPack(n_reads);
+			if (is_block_start)
+				startBlock();
+
+			uint32_t part_first_ref_read_id = cur_ref_read_id;
+
+			uint64_t n_symbols_before = dna_coder->GetNEncodedSymbols();
+			for (auto& encoded_read : encoded_redas_part)
 			{
-				dna_coder.Encode(encoded_read);
+				if (dna_block_splitter.IsEnabled())
+					updateRefReadId(encoded_read);
+				dna_coder->Encode(encoded_read);
 			}
 
-			dna_coder.Finish();
+			dna_coder->Finish();
 
-			dna_coder.GetOutput(v_output);
-			dna_coder.Restart();
-			
-			size_t n_reads = encoded_redas_part.size();
+			dna_coder->GetOutput(v_output);
+			dna_coder->Restart();
+
+			if (dna_block_splitter.IsEnabled())
+			{
+				vector<uint8_t> v_prefix;
+				StoreLittleEndian(v_prefix, part_first_ref_read_id);
+				v_output.insert(v_output.begin(), v_prefix.begin(), v_prefix.end());
+			}
 
 			archive.AddPart(s_dna, v_output, n_reads);
+			archive_index.AddPart("dna", n_reads, dna_coder->GetNEncodedSymbols() - n_symbols_before, is_block_start);
 			v_output.clear();			
 
 			progress.LongNIters(encoded_redas_part.size());
@@ -84,8 +157,11 @@ public:
 class CEntropyDecomprReads
 {
 	CArchive& archive;
+	const CArchiveIndex& archive_index;
 	int s_dna;
 	std::vector<CParallelQueue<decomp_read_pack_t>*>& read_decompr_queues; //first for output, second is optional for quality
+	CReferenceReads& ref_reads;
+	bool verbose;
 	entropy_coder::CDNACoder coder;
 	
 	uint64_t n_reads{};
@@ -99,9 +175,22 @@ class CEntropyDecomprReads
 	CRefReadsAccepter& ref_reads_accepter;
 
 	uint32_t n_ref_genome_pseudo_reads;
+	bool dna_blocks;
+	size_t start_part;		// first part to decode, must be a restart point
+	uint32_t n_threads;
 	bool hide_progress;
 
-	bool packToQueues(decomp_read_pack_t& pack)
+	const CReadsRange& range;
+
+	struct block_t
+	{
+		size_t first_part;
+		size_t n_parts;
+		uint64_t first_read;
+	};
+
+	// Reads outside the range are still passed to the quality decompressor (it needs them as a context), but not to the output
+	bool packToQueues(decomp_read_pack_t& pack, uint64_t first_read)
 	{		
 		for (uint32_t i = 1; i < read_decompr_queues.size(); ++i)
 		{
@@ -110,6 +199,10 @@ class CEntropyDecomprReads
 				return false;
 		}
 
+		range.Trim(pack, first_read);
+		if (pack.empty())
+			return true;
+
 		// Mask flags
 		if(compression_level > 1)
 			for (auto& r : pack)
@@ -120,45 +213,142 @@ class CEntropyDecomprReads
 			return false;
 		return true;
 	}
-public:
-	CEntropyDecomprReads(CArchive& archive, std::vector<CParallelQueue<decomp_read_pack_t>*>& read_decompr_queues, bool verbose, uint32_t maxCandidates,
-		int32_t compression_level,
-		uint64_t output_stream_size,
-		uint32_t total_reads,
-		ReferenceReadsMode referenceReadsMode, CReferenceReads& ref_reads, CRefReadsAccepter& ref_reads_accepter,
-		uint32_t n_ref_genome_pseudo_reads,
-		bool hide_progress = false) :
-		archive(archive),
-		s_dna(archive.GetStreamId("dna")),
-		read_decompr_queues(read_decompr_queues),
-		coder(ref_reads, verbose),
-		maxCandidates(maxCandidates),
-		compression_level(compression_level),
-		output_stream_size(output_stream_size),
-		total_reads(total_reads),
-		referenceReadsMode(referenceReadsMode),
-		ref_reads_accepter(ref_reads_accepter),
-		n_ref_genome_pseudo_reads(n_ref_genome_pseudo_reads),
-		hide_progress(hide_progress)
+
+	// Blocks (sequences of parts starting at restart points) covering the requested range
+	std::vector<block_t> getBlocks() const
 	{
+		std::vector<block_t> blocks;
+		auto parts = archive_index.GetParts("dna");
+		if (!parts)
+		{
+			std::cerr << "Error: no DNA parts in archive index\n";
+			exit(1);
+		}
+
+		for (size_t part_id = start_part; part_id < parts->size(); ++part_id)
+		{
+			const auto& part = (*parts)[part_id];
+			if (part.restart || blocks.empty())
+			{
+				if (part.first_read >= range.to)
+					break;
+				blocks.push_back({ part_id, 0, part.first_read });
+			}
+			++blocks.back().n_parts;
+		}
+		return blocks;
 	}
 
-	void Decompress()
+	// Each block is decoded with fresh models. Reads accepted as reference are stored at positions given in the parts and released when the block is done
+	void decompressBlock(const block_t& block, std::vector<decomp_read_pack_t>& packs)
 	{
-		vector<uint8_t> v_input;
+		entropy_coder::CDNACoder block_coder(ref_reads, verbose);
+		CArchivePart part;
 		size_t meta;
-		archive.GetPart(s_dna, v_input, meta);
+		uint32_t block_first_ref_read_id{};
+
+		for (size_t i = 0; i < block.n_parts; ++i)
+		{
+			if (!archive.GetPart(s_dna, block.first_part + i, part, meta) || part.size < sizeof(uint32_t))
+			{
+				std::cerr << "Error: corrupted DNA block in archive\n";
+				exit(1);
+			}
+
+			uint32_t part_first_ref_read_id;
+			LoadLittleEndian(part.data, part_first_ref_read_id);
+
+			block_coder.SetInput(part.data + sizeof(part_first_ref_read_id), part.size - sizeof(part_first_ref_read_id));
+			if (i == 0)
+			{
+				block_first_ref_read_id = part_first_ref_read_id;
+				block_coder.Init(false, static_cast<int>(maxCandidates), compression_level, 0, static_cast<uint32_t>(n_ref_genome_pseudo_reads + block.first_read));
+				block_coder.SetRefReadId(block_first_ref_read_id);
+			}
+			else
+				block_coder.Restart();
+
+			packs.emplace_back();
+			read_t read;
+			for (size_t j = 0; j < meta; ++j)
+			{
+				block_coder.Decode(read, ref_reads_accepter, referenceReadsMode == ReferenceReadsMode::All);
+				packs.back().emplace_back(std::move(read));
+			}
+		}
+
+		ref_reads.Release(block_first_ref_read_id, block_coder.GetRefReadId());
+	}
+
+	// Up to n_threads blocks are decoded at the same time by the threads of the pool, packs are passed to the queues in the original order
+	void decompressBlocks()
+	{
+		struct job_t
+		{
+			uint64_t first_read;
+			std::vector<decomp_read_pack_t> packs;
+			pooled_threads::thread th;
+		};
+
+		auto blocks = getBlocks();
+		uint64_t first_output_read = blocks.empty() ? 0 : blocks.front().first_read;
+		CPercentProgress progress(static_cast<uint32_t>(std::min<uint64_t>(total_reads, range.to) - first_output_read), hide_progress);
+
+		std::deque<std::unique_ptr<job_t>> jobs;
+		bool cancelled = false;
+
+		auto finish_front = [&] {
+			auto& job = *jobs.front();
+			job.th.join();
+			uint64_t first_read = job.first_read;
+			for (auto& pack : job.packs)
+			{
+				if (cancelled || first_read >= range.to)
+					break;
+				auto pack_size = pack.size();
+				progress.LongNIters(std::min<uint64_t>(pack_size, range.to - first_read));
+				if (!packToQueues(pack, first_read))
+					cancelled = true;
+				first_read += pack_size;
+			}
+			jobs.pop_front();
+		};
+
+		for (const auto& block : blocks)
+		{
+			if (jobs.size() >= n_threads)
+				finish_front();
+			if (cancelled)
+				break;
+
+			auto job = std::make_unique<job_t>();
+			job->first_read = block.first_read;
+			job->th = pooled_threads::thread([this, &block, &packs = job->packs] {
+				decompressBlock(block, packs);
+			});
+			jobs.push_back(std::move(job));
+		}
+
+		while (!jobs.empty())
+			finish_front();
+	}
+
+	void decompressSequential()
+	{
+		CArchivePart part;
+		size_t meta;
+		archive.GetPart(s_dna, part, meta);
 		uint64_t local_n_reads = meta;
 
 		n_reads += local_n_reads;
 
-		coder.SetInput(v_input);
+		coder.SetInput(part.data, part.size);
 // !!! TODO		coder.Init(false, maxCandidates, compression_level, input_stream_size);
 		coder.Init(false, static_cast<int>(maxCandidates), compression_level, 0, n_ref_genome_pseudo_reads);
 		decomp_read_pack_t read_pack;
 
 		//CPercentProgress progress(output_stream_size);
-		CPercentProgress progress(total_reads, hide_progress);
+		CPercentProgress progress(static_cast<uint32_t>(std::min<uint64_t>(total_reads, range.to)), hide_progress);
 		while (true)
 		{
 			read_t read;
@@ -170,22 +360,67 @@ public:
 				read_pack.emplace_back(std::move(read));
 			}
 
-			if (!packToQueues(read_pack))
+			if (!packToQueues(read_pack, n_reads - local_n_reads))
+				break;
+			read_pack.clear();
+
+			if (n_reads >= range.to)
 				break;
 
-			if (!archive.GetPart(s_dna, v_input, meta))
+			if (!archive.GetPart(s_dna, part, meta))
 				break;
 			local_n_reads = meta;
 
 			n_reads += local_n_reads;
 
-			coder.SetInput(v_input);
+			coder.SetInput(part.data, part.size);
 			coder.Restart();
 		}
 
 		//progress.ForceFinish();
+	}
+public:
+	CEntropyDecomprReads(CArchive& archive, const CArchiveIndex& archive_index, std::vector<CParallelQueue<decomp_read_pack_t>*>& read_decompr_queues, bool verbose, uint32_t maxCandidates,
+		int32_t compression_level,
+		uint64_t output_stream_size,
+		uint32_t total_reads,
+		ReferenceReadsMode referenceReadsMode, CReferenceReads& ref_reads, CRefReadsAccepter& ref_reads_accepter,
+		uint32_t n_ref_genome_pseudo_reads,
+		bool dna_blocks,
+		size_t start_part,
+		uint32_t n_threads,
+		const CReadsRange& range,
+		bool hide_progress = false) :
+		archive(archive),
+		archive_index(archive_index),
+		s_dna(archive.GetStreamId("dna")),
+		read_decompr_queues(read_decompr_queues),
+		ref_reads(ref_reads),
+		verbose(verbose),
+		coder(ref_reads, verbose),
+		maxCandidates(maxCandidates),
+		compression_level(compression_level),
+		output_stream_size(output_stream_size),
+		total_reads(total_reads),
+		referenceReadsMode(referenceReadsMode),
+		ref_reads_accepter(ref_reads_accepter),
+		n_ref_genome_pseudo_reads(n_ref_genome_pseudo_reads),
+		dna_blocks(dna_blocks),
+		start_part(start_part),
+		n_threads(std::max(n_threads, 1u)),
+		hide_progress(hide_progress),
+		range(range)
+	{
+	}
+
+	void Decompress()
+	{
+		if (dna_blocks)
+			decompressBlocks();
+		else
+			decompressSequential();
 
 		for (auto q : read_decompr_queues)
 			q->MarkCompleted();
 	}
-};
\ No newline at end of file
+};
@@ -17,8 +17,13 @@
 
 ******************************************************************************/
 #include "kmer_filter.h"
-#include "kmc_file.h"
+#include "count_kmers.h"
 #include "utils.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <thread>
 
 
 kmer_type CKmerFilter::hash_mm(kmer_type x) const
@@ -42,46 +47,403 @@ std::string kmer_to_str(kmer_type kmer, uint32_t len)
 	return res;
 }
 
-CKmerFilter::CKmerFilter(const std::string& kmcDbPath, uint32_t modulo, uint32_t kmer_len, uint64_t tot_uniqe_kmers, double fill_factor_filtered_kmers, bool verbose):
-	kmers(kmer_len, tot_uniqe_kmers, fill_factor_filtered_kmers),
-	modulo(modulo), 
-	div(modulo)
+namespace
 {
-	CKMCFile kmc_file;
+	// Runs body(tno) for tno in [0, n_threads), the calling thread runs body(0)
+	template<typename BODY>
+	void runInThreads(uint32_t n_threads, const BODY& body)
+	{
+		std::vector<std::thread> threads;
+		for (uint32_t tno = 1; tno < n_threads; ++tno)
+			threads.emplace_back([&body, tno] { body(tno); });
+		body(0);
+		for (auto& th : threads)
+			th.join();
+	}
 
-	if (!kmc_file.OpenForListing(kmcDbPath))
+	// Runs body(task) for task in [0, n_tasks), tasks are taken dynamically by n_threads threads
+	template<typename BODY>
+	void runTasks(uint32_t n_threads, uint64_t n_tasks, const BODY& body)
 	{
-		std::cerr << "Cannot open kmc database\n";
-		exit(1);
+		std::atomic<uint64_t> next_task{ 0 };
+		runInThreads(static_cast<uint32_t>(std::min<uint64_t>(n_threads, std::max<uint64_t>(n_tasks, 1))), [&](uint32_t) {
+			for (uint64_t task; (task = next_task.fetch_add(1)) < n_tasks; )
+				body(task);
+		});
+	}
+
+	// Vectors of the index are stored in the native byte order, the index is meant to be reused on the same machine
+	template<typename T>
+	void storeVector(std::ostream& out, const std::vector<T>& vec)
+	{
+		StoreLittleEndian(out, static_cast<uint64_t>(vec.size()));
+		out.write(reinterpret_cast<const char*>(vec.data()), vec.size() * sizeof(T));
+	}
+
+	// The stored size is checked against the rest of the stream, so a corrupted index fails the stream instead of a huge allocation
+	template<typename T>
+	void loadVector(std::istream& in, std::vector<T>& vec)
+	{
+		uint64_t size;
+		LoadLittleEndian(in, size);
+		auto pos = in.tellg();
+		in.seekg(0, std::ios::end);
+		auto end = in.tellg();
+		in.seekg(pos);
+		if (!in || size > static_cast<uint64_t>(end - pos) / sizeof(T))
+		{
+			in.setstate(std::ios::failbit);
+			return;
+		}
+		vec.resize(size);
+		in.read(reinterpret_cast<char*>(vec.data()), size * sizeof(T));
 	}
-	
-	CKmerAPI kmer(kmc_file.KmerLength());
-	uint32_t count;
-	std::vector<uint64> kmer_v;
-	
-	CKMCFileInfo info;
-	kmc_file.Info(info);	
-	CPercentProgress progress(info.total_kmers);	
-	
-//	div = libdivide::divider(modulo);
-
-	while (kmc_file.ReadNextKmer(kmer, count))
-	{	
-		progress.LogIter();
-		kmer.to_long(kmer_v);
-		uint64_t lowest = kmer_v.back();
-//		if (hash_mm(lowest) % modulo == 0) // KMC was responsible for filtering :-)
+
+	// Lists a kmc2 database (k <= 32, integer counters) in parts, a part is a range of prefixes of the database with
+	// about the same number of records, each part reads its own range of the suffix file, so parts may be listed concurrently
+	class CKmcDbParts
+	{
+		std::string suf_path;
+		std::vector<uint64_t> prefix_starts;	// first record of each prefix (of all bins), the last element is the number of records
+		std::vector<uint64_t> part_prefixes;	// first prefix of each part, the last element is the number of prefixes
+		uint32_t lut_prefix_length{};
+		uint32_t suffix_size{};
+		uint32_t counter_size{};
+
+		template<typename T>
+		static bool read(std::ifstream& in, T& x)
+		{
+			return static_cast<bool>(in.read(reinterpret_cast<char*>(&x), sizeof(T)));
+		}
+
+	public:
+		bool Open(const std::string& kmcDbPath, uint32_t n_parts)
+		{
+			//layout of *.kmc_pre: marker, lut, guard, signature map, header, header offset, version, marker
+			std::ifstream pre(kmcDbPath + ".kmc_pre", std::ios::binary);
+			pre.seekg(0, std::ios::end);
+			uint64_t pre_size = pre.tellg();
+			uint32_t kmc_version, header_offset;
+			if (!pre || pre_size < 16)
+				return false;
+			pre.seekg(pre_size - 12);
+			if (!read(pre, kmc_version) || !read(pre, header_offset) || kmc_version != 0x200 || header_offset + 12 > pre_size)
+				return false;
+
+			uint32_t kmer_length, mode, signature_len;
+			uint64_t total_kmers;
+			pre.seekg(pre_size - 8 - header_offset);
+			if (!read(pre, kmer_length) || !read(pre, mode) || !read(pre, counter_size) || !read(pre, lut_prefix_length) || !read(pre, signature_len))
+				return false;
+			pre.seekg(8, std::ios::cur);	// min and max counts, all records of the database are within them
+			if (!read(pre, total_kmers) || mode != 0 || kmer_length > 32 || lut_prefix_length > kmer_length || signature_len > 16 ||
+				(kmer_length - lut_prefix_length) % 4 || counter_size > 4)
+				return false;
+			suffix_size = (kmer_length - lut_prefix_length) / 4;
+
+			uint64_t signature_map_bytes = ((1ull << (2 * signature_len)) + 1) * sizeof(uint32_t);
+			if (pre_size < 4 + 8 + signature_map_bytes + header_offset + 8)
+				return false;
+			uint64_t n_prefixes = (pre_size - 4 - 8 - signature_map_bytes - header_offset - 8) / sizeof(uint64_t);
+			prefix_starts.resize(n_prefixes + 1);
+			pre.seekg(4);
+			if (!pre.read(reinterpret_cast<char*>(prefix_starts.data()), n_prefixes * sizeof(uint64_t)))
+				return false;
+			prefix_starts[n_prefixes] = total_kmers;
+			for (uint64_t i = 0; i < n_prefixes; ++i)
+				if (prefix_starts[i] > prefix_starts[i + 1])
+					return false;
+
+			suf_path = kmcDbPath + ".kmc_suf";
+			std::ifstream suf(suf_path, std::ios::binary);
+			suf.seekg(0, std::ios::end);
+			if (!suf || static_cast<uint64_t>(suf.tellg()) != 8 + total_kmers * (suffix_size + counter_size))
+				return false;
+
+			part_prefixes.resize(n_parts + 1);
+			for (uint32_t part = 0; part < n_parts; ++part)
+				part_prefixes[part] = std::lower_bound(prefix_starts.begin(), prefix_starts.end() - 1, total_kmers * part / n_parts) - prefix_starts.begin();
+			part_prefixes[n_parts] = n_prefixes;
+
+			return true;
+		}
+
+		uint32_t GetNParts() const
 		{
-			total_count_filtered += count;
-			//this->kmers.emplace(kmer_type(lowest), count);
-			this->kmers.insert(lowest
+			return static_cast<uint32_t>(part_prefixes.size() - 1);
+		}
+
+		void ForEachKmer(uint32_t part, const std::function<void(kmer_type, uint32_t)>& add) const
+		{
+			const uint64_t prefix_mask = (1ull << (2 * lut_prefix_length)) - 1;
+			const uint32_t rec_size = suffix_size + counter_size;
+			const uint64_t recs_in_buf = (1ull << 20) / rec_size;
+
+			uint64_t prefix = part_prefixes[part];
+			uint64_t last_prefix = part_prefixes[part + 1];
+			uint64_t rec_no = prefix_starts[prefix];
+			uint64_t part_end = prefix_starts[last_prefix];
+
+			std::ifstream suf(suf_path, std::ios::binary);
+			suf.seekg(4 + rec_no * rec_size);
+			std::vector<uint8_t> buf;
+			while (rec_no < part_end)
+			{
+				uint64_t n_recs = std::min(recs_in_buf, part_end - rec_no);
+				buf.resize(n_recs * rec_size);
+				if (!suf.read(reinterpret_cast<char*>(buf.data()), buf.size()))
+				{
+					std::cerr << "Error: cannot read kmc database\n";
+					exit(1);
+				}
+				for (const uint8_t* rec = buf.data(); rec < buf.data() + buf.size(); rec += rec_size, ++rec_no)
+				{
+					while (rec_no == prefix_starts[prefix + 1])
+						++prefix;
+
+					kmer_type kmer = prefix & prefix_mask;
+					for (uint32_t i = 0; i < suffix_size; ++i)
+						kmer = (kmer << 8) | rec[i];
+					uint32_t count = 0;
+					for (uint32_t i = 0; i < counter_size; ++i)
+						count |= static_cast<uint32_t>(rec[suffix_size + i]) << (8 * i);
+					add(kmer, count);
+				}
+			}
+		}
+	};
+}
+
+void CCompactedKmers::Build(uint32_t n_threads, uint32_t n_parts, const source_t& source)
+{
+	//k-mers are distributed to ranges by their highest bits, ranges are sorted independently
+	const uint32_t max_range_bits = 12;
+	uint32_t range_bits = std::min(max_range_bits, kmer_len_bits);
+	uint32_t range_shift = kmer_len_bits - range_bits;
+	uint32_t n_ranges = 1u << range_bits;
+
+	//first pass: count k-mers in ranges for each part
+	std::vector<std::vector<uint64_t>> part_range_sizes(n_parts);
+	std::atomic<uint64_t> atomic_total_count{ 0 };
 #ifdef ESTIMATE_MEMORY_WITH_COUNTS_PER_PREFIX
-				, count
+	std::vector<std::atomic<uint64_t>> atomic_counts_per_prefix(GetNPrefixes());
 #endif
-			);
+
+	runTasks(n_threads, n_parts, [&](uint64_t part) {
+		auto& range_sizes = part_range_sizes[part];
+		range_sizes.assign(n_ranges, 0);
+		uint64_t part_total_count = 0;
+#ifdef ESTIMATE_MEMORY_WITH_COUNTS_PER_PREFIX
+		uint64_t cur_prefix = 0;
+		uint64_t cur_prefix_count = 0;
+#endif
+		source(static_cast<uint32_t>(part), [&](kmer_type kmer, uint32_t count) {
+			++range_sizes[kmer >> range_shift];
+			part_total_count += count;
+#ifdef ESTIMATE_MEMORY_WITH_COUNTS_PER_PREFIX
+			//k-mers are usually given in a sorted order, so counts are accumulated as long as the prefix does not change
+			uint64_t prefix = kmer >> prefix_suffix_len_bits;
+			if (prefix != cur_prefix)
+			{
+				atomic_counts_per_prefix[cur_prefix] += cur_prefix_count;
+				cur_prefix = prefix;
+				cur_prefix_count = 0;
+			}
+			cur_prefix_count += count;
+#endif
+		});
+		atomic_total_count += part_total_count;
+#ifdef ESTIMATE_MEMORY_WITH_COUNTS_PER_PREFIX
+		atomic_counts_per_prefix[cur_prefix] += cur_prefix_count;
+#endif
+	});
+
+	total_count = atomic_total_count;
+#ifdef ESTIMATE_MEMORY_WITH_COUNTS_PER_PREFIX
+	counts_per_prefix.assign(atomic_counts_per_prefix.begin(), atomic_counts_per_prefix.end());
+#endif
+
+	//positions of parts in ranges
+	std::vector<uint64_t> range_starts(n_ranges + 1);
+	n_kmers = 0;
+	for (uint32_t range = 0; range < n_ranges; ++range)
+	{
+		range_starts[range] = n_kmers;
+		for (auto& range_sizes : part_range_sizes)
+		{
+			auto size = range_sizes[range];
+			range_sizes[range] = n_kmers;
+			n_kmers += size;
 		}
 	}
-	
+	range_starts[n_ranges] = n_kmers;
+
+	//second pass: distribute k-mers to ranges
+	std::vector<kmer_type> sorted_kmers(n_kmers);
+	runTasks(n_threads, n_parts, [&](uint64_t part) {
+		auto& range_pos = part_range_sizes[part];
+		source(static_cast<uint32_t>(part), [&](kmer_type kmer, uint32_t) {
+			sorted_kmers[range_pos[kmer >> range_shift]++] = kmer;
+		});
+	});
+	part_range_sizes.clear();
+	part_range_sizes.shrink_to_fit();
+
+	runTasks(n_threads, n_ranges, [&](uint64_t range) {
+		std::sort(sorted_kmers.begin() + range_starts[range], sorted_kmers.begin() + range_starts[range + 1]);
+	});
+
+	//there are 4 to 8 k-mers in a bucket on average
+	bucket_bits = 0;
+	while (bucket_bits < kmer_len_bits && (n_kmers >> (bucket_bits + 1)) >= 4)
+		++bucket_bits;
+	while (kmer_len_bits - bucket_bits > max_residual_bits)
+		++bucket_bits;
+	residual_bits = kmer_len_bits - bucket_bits;
+	residual_mask = (1ull << residual_bits) - 1;
+
+	uint64_t n_buckets = 1ull << bucket_bits;
+	uint64_t n_groups = (n_buckets >> bucket_group_bits) + 1;
+	bucket_starts.resize(n_buckets + 1);
+	bucket_group_starts.resize(n_groups);
+
+	runTasks(n_threads, n_groups, [&](uint64_t group) {
+		uint64_t first_bucket = group << bucket_group_bits;
+		uint64_t last_bucket = std::min(n_buckets + 1, (group + 1) << bucket_group_bits);
+		uint64_t pos = std::lower_bound(sorted_kmers.begin(), sorted_kmers.end(), first_bucket, [this](kmer_type kmer, uint64_t bucket) {
+			return (kmer >> residual_bits) < bucket;
+		}) - sorted_kmers.begin();
+		bucket_group_starts[group] = pos;
+
+		for (uint64_t bucket = first_bucket; bucket < last_bucket; ++bucket)
+		{
+			while (pos < n_kmers && (sorted_kmers[pos] >> residual_bits) < bucket)
+				++pos;
+			bucket_starts[bucket] = static_cast<uint32_t>(pos - bucket_group_starts[group]);
+		}
+	});
+
+	//residuals are packed in blocks of 64 k-mers, so each block starts at a word boundary and blocks may be packed in parallel
+	const uint64_t kmers_per_task = 64 * 1024;
+	residuals.assign((n_kmers * residual_bits + 63) / 64 + 1, 0); //+1 for unaligned reads of the last residual
+	runTasks(n_threads, (n_kmers + kmers_per_task - 1) / kmers_per_task, [&](uint64_t task) {
+		uint64_t first = task * kmers_per_task;
+		uint64_t last = std::min(n_kmers, first + kmers_per_task);
+		for (uint64_t pos = first; pos < last; ++pos)
+			set_residual(pos, sorted_kmers[pos] & residual_mask);
+	});
+}
+
+void CCompactedKmers::Serialize(std::ostream& out) const
+{
+	StoreLittleEndian(out, kmer_len_bits);
+	StoreLittleEndian(out, bucket_bits);
+	StoreLittleEndian(out, residual_bits);
+	StoreLittleEndian(out, n_kmers);
+	StoreLittleEndian(out, total_count);
+	storeVector(out, bucket_group_starts);
+	storeVector(out, bucket_starts);
+	storeVector(out, residuals);
+#ifdef ESTIMATE_MEMORY_WITH_COUNTS_PER_PREFIX
+	storeVector(out, counts_per_prefix);
+#endif
+}
+
+bool CCompactedKmers::Load(std::istream& in)
+{
+	uint32_t stored_kmer_len_bits;
+	LoadLittleEndian(in, stored_kmer_len_bits);
+	if (!in || stored_kmer_len_bits != kmer_len_bits)
+		return false;
+	LoadLittleEndian(in, bucket_bits);
+	LoadLittleEndian(in, residual_bits);
+	LoadLittleEndian(in, n_kmers);
+	LoadLittleEndian(in, total_count);
+	if (!in || bucket_bits > kmer_len_bits || bucket_bits + residual_bits != kmer_len_bits || residual_bits > max_residual_bits)
+		return false;
+	residual_mask = (1ull << residual_bits) - 1;
+	loadVector(in, bucket_group_starts);
+	loadVector(in, bucket_starts);
+	loadVector(in, residuals);
+#ifdef ESTIMATE_MEMORY_WITH_COUNTS_PER_PREFIX
+	loadVector(in, counts_per_prefix);
+	if (counts_per_prefix.size() != GetNPrefixes())
+		return false;
+#endif
+	if (!in)
+		return false;
+
+	//sizes must match the layout made by Build and bucket starts must stay within the k-mers, as queries do not check them
+	uint64_t n_buckets = 1ull << bucket_bits;
+	if (bucket_starts.size() != n_buckets + 1 || bucket_group_starts.size() != (n_buckets >> bucket_group_bits) + 1 ||
+		n_kmers > UINT64_MAX / max_residual_bits || residuals.size() != (n_kmers * residual_bits + 63) / 64 + 1)
+		return false;
+	uint64_t prev_start = 0;
+	for (uint64_t bucket = 0; bucket <= n_buckets; ++bucket)
+	{
+		if (bucket_group_starts[bucket >> bucket_group_bits] > n_kmers)
+			return false;
+		uint64_t start = get_bucket_start(bucket);
+		if (start < prev_start || start > n_kmers)
+			return false;
+		prev_start = start;
+	}
+
+	return prev_start == n_kmers;
+}
+
+CKmerFilter::CKmerFilter(const std::string& kmcDbPath, uint32_t modulo, uint32_t kmer_len, uint32_t n_threads, bool verbose):
+	kmers(kmer_len),
+	modulo(modulo), 
+	div(modulo)
+{
+	CKmcDbParts kmc_db;
+
+	if (!kmc_db.Open(kmcDbPath, std::max(1u, n_threads)))
+	{
+		std::cerr << "Cannot open kmc database\n";
+		exit(1);
+	}
+
+	//the database is streamed in parallel parts, so only the sorted k-mers are kept in memory, it is listed once per pass of Build
+	kmers.Build(n_threads, kmc_db.GetNParts(), [&kmc_db](uint32_t part, const std::function<void(kmer_type, uint32_t)>& add) {
+		kmc_db.ForEachKmer(part, add);
+	});
+
 	if(verbose)		
-		std::cerr << "Total count filtered: " << total_count_filtered << "\n";	
-}
\ No newline at end of file
+		std::cerr << "Total count filtered: " << GetTotalKmers() << "\n";
+}
+
+CKmerFilter::CKmerFilter(const CFilteredKmersBins& kmersBins, uint32_t modulo, uint32_t kmer_len, uint32_t n_threads, bool verbose) :
+	kmers(kmer_len),
+	modulo(modulo),
+	div(modulo)
+{
+	//bins are read in parallel
+	kmers.Build(n_threads, kmersBins.GetNBins(), [&kmersBins](uint32_t bin_no, const std::function<void(kmer_type, uint32_t)>& add) {
+		kmersBins.ForEachKmer(bin_no, add);
+	});
+
+	if (verbose)
+		std::cerr << "Total count filtered: " << GetTotalKmers() << "\n";
+}
+
+CKmerFilter::CKmerFilter(std::istream& in, uint32_t modulo, uint32_t kmer_len, bool verbose) :
+	kmers(kmer_len),
+	modulo(modulo),
+	div(modulo)
+{
+	if (!kmers.Load(in))
+	{
+		std::cerr << "Error: corrupted index or k-mer length different than in the index\n";
+		exit(1);
+	}
+
+	if (verbose)
+		std::cerr << "Total count filtered: " << GetTotalKmers() << "\n";
+}
+
+void CKmerFilter::Serialize(std::ostream& out) const
+{
+	kmers.Serialize(out);
+}
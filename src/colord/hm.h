@@ -453,7 +453,8 @@ public:
 // *** Hash map with linear probing (multikey)
 template<typename Key_t, typename Value_t,
 	typename Compare_t = std::equal_to<>,
-	typename Hash_t = std::hash<Key_t>>
+	typename Hash_t = std::hash<Key_t>,
+	typename Alloc_t = std::allocator<std::pair<Key_t, Value_t>>>
 	class hash_map_lp {
 	public:
 		using key_type = Key_t;
@@ -465,7 +466,8 @@ template<typename Key_t, typename Value_t,
 		using const_reference = const std::pair<Key_t, Value_t>&;
 		using size_type = size_t;
 		using difference_type = ptrdiff_t;
-		using hash_map_lp_type = hash_map_lp<Key_t, Value_t, Compare_t, Hash_t>;
+		using allocator_type = Alloc_t;
+		using hash_map_lp_type = hash_map_lp<Key_t, Value_t, Compare_t, Hash_t, Alloc_t>;
 		using iterator = hash_map_lp_iterator<hash_map_lp_type>;
 		using const_iterator = const_hash_map_lp_iterator<hash_map_lp_type>;
 		using local_iterator = hash_map_lp_local_iterator<hash_map_lp_type>;
@@ -474,7 +476,7 @@ template<typename Key_t, typename Value_t,
 		using const_local_value_iterator = const_hash_map_lp_local_value_iterator<hash_map_lp_type>;
 
 	private:
-		using VectorType = std::vector<value_type>;
+		using VectorType = std::vector<value_type, Alloc_t>;
 
 	private:
 		Key_t empty_key;
@@ -485,7 +487,7 @@ template<typename Key_t, typename Value_t,
 		double max_fill_factor;
 		size_t no_elements;
 		size_t no_elements_unique;
-		std::vector<value_type> data;
+		VectorType data;
 		size_t allocated;
 		size_t size_when_restruct;
 		size_t allocated_mask;
@@ -501,17 +503,18 @@ template<typename Key_t, typename Value_t,
 		virtual ~hash_map_lp() = default;
 
 		explicit hash_map_lp(const Key_t _empty_key = Key_t(), size_t _init_reserved = 16, double _max_fill_factor = 0.7,
-			const Compare_t& _compare = Compare_t(), const Hash_t _hash = Hash_t()) :
+			const Compare_t& _compare = Compare_t(), const Hash_t _hash = Hash_t(), const Alloc_t& _alloc = Alloc_t()) :
 			empty_key(_empty_key),
 			compare(_compare),
-			hash(_hash)
+			hash(_hash),
+			data(_alloc)
 		{
 			construct(_init_reserved, _max_fill_factor);
 		}
 
-		hash_map_lp(const hash_map_lp<Key_t, Value_t, Compare_t, Hash_t>& src) = default;
+		hash_map_lp(const hash_map_lp_type& src) = default;
 
-		hash_map_lp(hash_map_lp<Key_t, Value_t, Compare_t, Hash_t>&& src) = default;
+		hash_map_lp(hash_map_lp_type&& src) = default;
 
 		template <typename InputIterator>
 		hash_map_lp(InputIterator first, InputIterator last,
@@ -542,7 +545,7 @@ template<typename Key_t, typename Value_t,
 
 
 		hash_map_lp_type& operator=(
-			const hash_map_lp<Key_t, Value_t, Compare_t, Hash_t>& rhs)
+			const hash_map_lp_type& rhs)
 		{
 			if (this != &rhs)
 			{
@@ -564,7 +567,7 @@ template<typename Key_t, typename Value_t,
 		}
 
 		hash_map_lp_type& operator=(
-			hash_map_lp<Key_t, Value_t, Compare_t, Hash_t>&& rhs)
+			hash_map_lp_type&& rhs)
 		{
 			if (this != &rhs)
 			{
@@ -959,7 +962,7 @@ template<typename Key_t, typename Value_t,
 
 		void restruct(size_t new_allocated)
 		{
-			std::vector<value_type> old_data;
+			VectorType old_data(data.get_allocator());
 			old_data = move(data);
 			size_t old_allocated = allocated;
 
@@ -27,7 +27,7 @@ void CIDCoder::Init(bool _is_compressing, HeaderComprMode _header_mode, int _com
 	header_mode = _header_mode;
 	compression_level = _compression_level;
 
-	v_vios_io = new CVectorIOStream(v_io);
+	v_vios_io = new CVectorIOStream(v_io, &in_view);
 
 	init_symbol_classes();
 
@@ -209,16 +209,16 @@ public:
 
 		if(verbose)
 		{
-			cout << "Plus id size: " << m_ctx_rc_plus_id.get_size() << endl;
-			cout << "Flags size: " << m_ctx_rc_flags.get_size() << endl;
-			cout << "Numeric size size: " << m_ctx_rc_numeric_size.get_size() << endl;
-			cout << "Numeric small size: " << m_ctx_rc_numeric_small.get_size() << endl;
-			cout << "Numeric size: " << m_ctx_rc_numeric.get_size() << endl;
-			cout << "Hexadecimal size: " << m_ctx_rc_hexa.get_size() << endl;
-			cout << "Literal size: " << m_ctx_rc_literal.get_size() << endl;
-			cout << "Literal same size: " << m_ctx_rc_literal_same.get_size() << endl;
-			cout << "Literal same length size: " << m_ctx_rc_literal_same_length.get_size() << endl;
-			cout << "Plain size: " << m_ctx_rc_plain.get_size() << endl;
+			cerr << "Plus id size: " << m_ctx_rc_plus_id.get_size() << endl;
+			cerr << "Flags size: " << m_ctx_rc_flags.get_size() << endl;
+			cerr << "Numeric size size: " << m_ctx_rc_numeric_size.get_size() << endl;
+			cerr << "Numeric small size: " << m_ctx_rc_numeric_small.get_size() << endl;
+			cerr << "Numeric size: " << m_ctx_rc_numeric.get_size() << endl;
+			cerr << "Hexadecimal size: " << m_ctx_rc_hexa.get_size() << endl;
+			cerr << "Literal size: " << m_ctx_rc_literal.get_size() << endl;
+			cerr << "Literal same size: " << m_ctx_rc_literal_same.get_size() << endl;
+			cerr << "Literal same length size: " << m_ctx_rc_literal_same_length.get_size() << endl;
+			cerr << "Plain size: " << m_ctx_rc_plain.get_size() << endl;
 		}
 	}
 
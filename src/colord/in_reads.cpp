@@ -17,15 +17,35 @@
 
 ******************************************************************************/
 #include "in_reads.h"
+#include "input_spool.h"
+#include "md5_wrapper.h"
 #include <iostream>
+#include <thread>
+#include <memory>
+#include <cstring>
 
 using namespace std;
 
-read_t CInputReads::to_read_t(const std::string& str, bool& hasN)
+namespace
 {
-	read_t res(str.size() + 1);
+	inline bool is_eol(uint8_t symb)
+	{
+		return symb == '\n' || symb == '\r';
+	}
+
+	inline size_t find_eol(const uint8_t* data, size_t pos, size_t size)
+	{
+		while (pos < size && !is_eol(data[pos]))
+			++pos;
+		return pos;
+	}
+}
+
+read_t CInputParser::to_read_t(const char* str, size_t len, bool& hasN)
+{
+	read_t res(len + 1);
 	hasN = false;
-	for (size_t i = 0; i < str.length(); ++i)
+	for (size_t i = 0; i < len; ++i)
 	{
 		int8_t code = SymbToBinMap[(uint8_t)str[i]];
 		if (code == -1)
@@ -37,254 +57,496 @@ read_t CInputReads::to_read_t(const std::string& str, bool& hasN)
 		
 		res[i] = code;
 	}
-	res[str.size()] = 255; //guard
+	res[len] = 255; //guard
 	return res;
 }
 
-void CInputReads::addReadHeader()
+// ************************************************************************************
+// Returns the position of the last '>' starting a line, i.e. the end of the complete records in the buffer
+size_t CInputParser::findFastaRecordsEnd(const std::vector<uint8_t>& buff, size_t size)
+{
+	for (size_t pos = size; pos > 1; --pos)
+		if (buff[pos - 1] == '>' && is_eol(buff[pos - 2]))
+			return pos - 1;
+	return 0;
+}
+
+// ************************************************************************************
+// Returns the position just after the last complete 4-line record in the buffer, which must start at a record boundary
+size_t CInputParser::findFastqRecordsEnd(const std::vector<uint8_t>& buff, size_t size)
 {
-	total_symb_header += currentLine.size();
-	currentLine.erase(currentLine.begin()); //remove '>'
-	if (!is_fastq)
-	{		
-		current_header_bytes += currentLine.size();
-		headers.emplace_back(std::move(currentLine), qual_header_type::empty);
-		if (current_header_bytes >= headers_pack_size)
+	size_t res = 0;
+	uint32_t n_lines = 0;
+	for (size_t pos = 0; pos < size; )
+	{
+		auto eol = find_eol(buff.data(), pos, size);
+		if (eol == size)
+			break;
+		if (eol > pos && ++n_lines == 4) //empty lines are skipped
 		{
-			current_header_bytes = 0;
-			headers_queue.Push(std::move(headers));
+			n_lines = 0;
+			res = eol + 1;
 		}
+		pos = eol + 1;
 	}
-	else
-		last_read_header = std::move(currentLine);
+	return res;
 }
 
-void CInputReads::addRead()
+// ************************************************************************************
+// Returns the position just after the last complete BAM record in the buffer, which must start at a record boundary
+size_t CInputParser::findBamRecordsEnd(const std::vector<uint8_t>& buff, size_t size)
 {
-	bool hasN;
-	last_read = to_read_t(currentLine, hasN);
-	total_bases += currentLine.length();
-	current_reads_bytes += last_read.size();
+	size_t pos = 0;
+	while (pos + 4 <= size)
+	{
+		uint32_t block_size;
+		LoadLittleEndian(buff.data() + pos, block_size);
+		if (pos + 4 + block_size > size)
+			break;
+		pos += 4 + block_size;
+	}
+	return pos;
+}
 
-	reads.emplace_back(hasN, last_read);
+// ************************************************************************************
+// Returns the size of BAM header (magic, SAM header text and references) or 0 if the buffer does not contain it entirely
+size_t CInputParser::bamHeaderSize(const std::vector<uint8_t>& buff, size_t size)
+{
+	if (size < 12)
+		return 0;
+	uint32_t l_text, n_ref;
+	LoadLittleEndian(buff.data() + 4, l_text);
+	size_t pos = 8ull + l_text;
+	if (pos + 4 > size)
+		return 0;
+	LoadLittleEndian(buff.data() + pos, n_ref);
+	pos += 4;
+	for (uint32_t i = 0; i < n_ref; ++i)
+	{
+		uint32_t l_name;
+		if (pos + 4 > size)
+			return 0;
+		LoadLittleEndian(buff.data() + pos, l_name);
+		pos += 4ull + l_name + 4;
+	}
+	return pos <= size ? pos : 0;
+}
 
-	stats.LogRead(read_len(reads.back().second));
-	if (current_reads_bytes >= reads_pack_size)
+// ************************************************************************************
+bool CInputParser::skipBamHeader()
+{
+	if (filled < 4)
+		return false;
+	if (memcmp(buff.data(), "BAM\1", 4) != 0)
 	{
-		current_reads_bytes = 0;
-		reads_queue.Push(std::move(reads));
+		std::cerr << "Error: wrong BAM header\n";
+		exit(1);
 	}
+	auto header_size = bamHeaderSize(buff, filled);
+	if (!header_size)
+		return false;
+	std::copy(buff.begin() + header_size, buff.begin() + filled, buff.begin());
+	filled -= header_size;
+	bam_header_pending = false;
+	return true;
 }
 
-void CInputReads::addQualHeader()
+// ************************************************************************************
+CInputParser::CInputParser(uint32_t n_threads, std::function<void(CParsedReads&)> consumer) :
+	consumer(std::move(consumer)),
+	buff(chunk_size),
+	chunks_queue(std::max(n_threads, 1u)),
+	parsed_queue(std::max(n_threads, 1u) + 2, std::max(n_threads, 1u))
 {
-	qual_header_type type = qual_header_type::empty;
-	total_symb_header += currentLine.size();
-	currentLine.erase(currentLine.begin()); //remove '+'
-	if (currentLine.size() > 0)
+	for (uint32_t i = 0; i < std::max(n_threads, 1u); ++i)
+		parsers.emplace_back([this] {
+			chunk_t chunk;
+			while (chunks_queue.Pop(chunk))
+			{
+				auto parsed = std::make_unique<CParsedReads>();
+				parsed->is_fastq = is_fastq;
+				if (is_bam)
+					parseBamChunk(chunk, *parsed);
+				else if (is_fastq)
+					parseFastqChunk(chunk, *parsed);
+				else
+					parseFastaChunk(chunk, *parsed);
+				chunk.data = std::vector<uint8_t>();
+				parsed_queue.Push(chunk.id, std::move(parsed));
+			}
+			parsed_queue.MarkCompleted();
+		});
+
+	collector = std::thread([this] {
+		std::unique_ptr<CParsedReads> parsed;
+		while (parsed_queue.Pop(parsed))
+			this->consumer(*parsed);
+	});
+}
+
+// ************************************************************************************
+CInputParser::~CInputParser()
+{
+	Finish();
+}
+
+// ************************************************************************************
+// Moves [0, end) of the buffer to the parsers, the rest (incomplete record) is moved to the new buffer
+void CInputParser::pushChunk(size_t end, bool is_last)
+{
+	std::vector<uint8_t> next(is_last ? 0 : std::max(chunk_size, filled - end + chunk_size));
+	std::copy(buff.begin() + end, buff.begin() + filled, next.begin());
+	filled -= end;
+	buff.resize(end);
+	chunks_queue.Push(chunk_t{ chunk_id++, is_last, std::move(buff) });
+	buff = std::move(next);
+	next_search = chunk_size;
+}
+
+// ************************************************************************************
+void CInputParser::Add(const uint8_t* data, size_t size)
+{
+	if (!size)
+		return;
+	if (!format_known)
 	{
-		if (currentLine != last_read_header)
+		if (data[0] != '@' && data[0] != '>' && data[0] != 'B')
 		{
-			std::cerr << "Error: quality header not empty but different than read header\n";
+			std::cerr << "Error: unknown file format\n";
 			exit(1);
 		}
-		type = qual_header_type::eq_read_header;
+		is_bam = data[0] == 'B';
+		is_fastq = data[0] == '@' || is_bam;
+		bam_header_pending = is_bam;
+		format_known = true;
 	}
-	current_header_bytes += last_read_header.size();
 
-	headers.emplace_back(std::move(last_read_header), type);
+	if (buff.size() < filled + size)
+		buff.resize(filled + size);
+	std::copy(data, data + size, buff.begin() + filled);
+	filled += size;
 
-	if (current_header_bytes >= headers_pack_size)
+	if (bam_header_pending && !skipBamHeader())
+		return;
+
+	while (filled >= next_search)
 	{
-		current_header_bytes = 0;
-		headers_queue.Push(std::move(headers));
+		//chunks are cut close to chunk_size, unless a single record is longer
+		size_t limit = std::min(filled, chunk_size);
+		auto find_records_end = is_bam ? findBamRecordsEnd : is_fastq ? findFastqRecordsEnd : findFastaRecordsEnd;
+		size_t end = find_records_end(buff, limit);
+		if (!end && limit < filled)
+			end = find_records_end(buff, filled);
+		if (!end)
+		{
+			next_search = filled + chunk_size;
+			break;
+		}
+		pushChunk(end, false);
 	}
 }
 
-void CInputReads::addQual()
+// ************************************************************************************
+void CInputParser::EndFile()
 {
-	qual_t qual(currentLine.begin(), currentLine.end());
+	if (is_bam)
+	{
+		//the next file starts with its own header
+		if (bam_header_pending || findBamRecordsEnd(buff, filled) != filled)
+		{
+			std::cerr << "Error: truncated BAM file\n";
+			exit(1);
+		}
+		if (filled)
+			pushChunk(filled, false);
+		bam_header_pending = true;
+		return;
+	}
 
-//	quals.emplace_back(std::move(last_read), std::move(currentLine));
-	quals.emplace_back(std::move(last_read), std::move(qual));
-	if(current_reads_bytes == 0) //if reads was just added then qual should be also, because the number of records should be the same for quals and for reads	
-		quals_queue.Push(std::move(quals));
+	//the last line of a file may be not terminated, which would glue it with the first line of the next file
+	if (filled && !is_eol(buff[filled - 1]))
+	{
+		const uint8_t eol = '\n';
+		Add(&eol, 1);
+	}
+}
+
+// ************************************************************************************
+void CInputParser::Finish()
+{
+	if (finished)
+		return;
+	finished = true;
+	if (is_bam && (bam_header_pending ? filled != 0 : findBamRecordsEnd(buff, filled) != filled))
+	{
+		std::cerr << "Error: truncated BAM file\n";
+		exit(1);
+	}
+	if (format_known)
+		pushChunk(filled, true);
+	chunks_queue.MarkCompleted();
+	for (auto& th : parsers)
+		th.join();
+	collector.join();
+}
+
+// ************************************************************************************
+void CInputParser::parseFastaChunk(const chunk_t& chunk, CParsedReads& res) const
+{
+	const uint8_t* data = chunk.data.data();
+	size_t size = chunk.data.size();
+
+	std::string read;
+	bool in_record = false, has_read_line = false;
+
+	auto store_read = [&] {
+		bool hasN;
+		res.reads.emplace_back(false, to_read_t(read.data(), read.size(), hasN));
+		res.reads.back().first = hasN;
+		res.total_bases += read.size();
+		read.clear();
+	};
+
+	for (size_t pos = 0; pos < size; )
+	{
+		auto eol = find_eol(data, pos, size);
+		if (eol == pos)
+		{
+			++pos;
+			continue;
+		}
+		//line starting with '>' is a header unless it directly follows the previous header
+		if (data[pos] == '>' && (!in_record || has_read_line) && eol < size)
+		{
+			if (in_record)
+				store_read();
+			res.total_symb_header += eol - pos;
+			res.headers.emplace_back(std::string(data + pos + 1, data + eol), qual_header_type::empty);
+			in_record = true;
+			has_read_line = false;
+		}
+		else
+		{
+			read.append(data + pos, data + eol);
+			has_read_line = true;
+		}
+		pos = eol + 1;
+	}
+
+	//the next chunk starts with '>' which would be considered a part of the read by sequential reader
+	if (!chunk.is_last && in_record && !has_read_line)
+	{
+		std::cerr << "Only ACGTN symbols supported inside a read\n";
+		exit(1);
+	}
+	if (in_record || chunk.is_last)
+		store_read();
 }
 
-void CInputReads::porcessFastaOrMultiFasta(std::vector<uint8_t>& buff, uint64_t readed, uint32_t buf_size, gzFile gzfile)
+// ************************************************************************************
+// BAM records are converted like samtools fastq does: secondary and supplementary alignments are skipped (as by k-mer counter),
+// reverse strand reads are reverse complemented, missing qualities are replaced by Q1, auxiliary fields are dropped
+void CInputParser::parseBamChunk(const chunk_t& chunk, CParsedReads& res) const
 {
-	enum class FastaReadState { Header, EOLsAfterHeader, Read, EOLsAfterOrInsideRead };
-	FastaReadState fastaReadState = FastaReadState::Header;
-	while (readed)
+	static const int8_t bam_to_bin[16] = { -1, 0, 1, -1, 2, -1, -1, -1, 3, -1, -1, -1, -1, -1, -1, 4 }; //"=ACMGRSVTWYHKDBN"
+
+	const uint8_t* data = chunk.data.data();
+	size_t size = chunk.data.size();
+
+	auto wrong_record = [] {
+		std::cerr << "Error: wrong BAM record\n";
+		exit(1);
+	};
+
+	for (size_t pos = 0; pos < size; )
 	{
-		for(uint32_t pos = 0; pos < readed; ++pos)
+		uint32_t block_size, l_seq;
+		uint16_t n_cigar_op, flag;
+		if (pos + 4 > size)
+			wrong_record();
+		LoadLittleEndian(data + pos, block_size);
+		//fixed-length part of the record must be present before any of its fields is read
+		if (block_size < 32 || pos + 4 + block_size > size)
+			wrong_record();
+		const uint8_t* rec = data + pos + 4;
+		pos += 4ull + block_size;
+
+		uint8_t l_read_name = rec[8];
+		LoadLittleEndian(rec + 12, n_cigar_op);
+		LoadLittleEndian(rec + 14, flag);
+		LoadLittleEndian(rec + 16, l_seq);
+		if (flag & 0x900)
+			continue;
+		bool rev_comp = flag & 0x10;
+
+		uint64_t seq_offset = 32ull + l_read_name + 4ull * n_cigar_op;
+		uint64_t qual_offset = seq_offset + (l_seq + 1ull) / 2;
+		if (qual_offset + l_seq > block_size)
+			wrong_record();
+		const uint8_t* read_name = rec + 32;
+		const uint8_t* seq = rec + seq_offset;
+		const uint8_t* qual = rec + qual_offset;
+
+		read_t read(l_seq + 1ull);
+		bool hasN = false;
+		for (uint32_t i = 0; i < l_seq; ++i)
 		{
-			auto symb = buff[pos];
-			bool is_eol = symb == '\n' || symb == '\r';
-			switch (fastaReadState)
+			int8_t code = bam_to_bin[(seq[i / 2] >> (4 * (1 - i % 2))) & 15];
+			if (code == -1)
 			{
-				case FastaReadState::Header:
-					if (is_eol)
-					{
-						currentLine.shrink_to_fit();
-						addReadHeader();
-						currentLine.clear();
-						fastaReadState = FastaReadState::EOLsAfterHeader;
-					}
-					else
-						currentLine.push_back(symb);
-					break;
-				case FastaReadState::EOLsAfterHeader:
-					if (!is_eol)
-					{
-						currentLine.push_back(symb);
-						fastaReadState = FastaReadState::Read;
-					}
-					break;
-				case FastaReadState::Read:
-					if (is_eol)
-					{
-						fastaReadState = FastaReadState::EOLsAfterOrInsideRead;
-					}
-					else
-						currentLine.push_back(symb);
-					break;
-				case FastaReadState::EOLsAfterOrInsideRead:
-					if (!is_eol)
-					{
-						if (symb == '>')
-						{
-							currentLine.shrink_to_fit();
-							addRead();
-							currentLine.clear();
-							fastaReadState = FastaReadState::Header;
-						}
-						else
-							fastaReadState = FastaReadState::Read;
-						currentLine.push_back(symb);
-					}
-					break;
-				default:
-					break;
+				std::cerr << "Only ACGTN symbols supported inside a read\n";
+				exit(1);
 			}
+			hasN |= code == 4;
+			if (rev_comp)
+				read[l_seq - 1 - i] = code == 4 ? 4 : 3 - code;
+			else
+				read[i] = code;
 		}
-		readed = gzfread(buff.data(), 1, buf_size, gzfile);
-		total_bytes += readed;
+		read[l_seq] = 255; //guard
+
+		qual_t read_qual(l_seq);
+		bool no_qual = l_seq && qual[0] == 0xff;
+		for (uint32_t i = 0; i < l_seq; ++i)
+			read_qual[rev_comp ? l_seq - 1 - i : i] = no_qual ? '"' : qual[i] + 33;
+
+		//read name is null terminated
+		uint32_t name_len = l_read_name ? l_read_name - 1 : 0;
+		res.total_symb_header += name_len + 2; //'@' and '+' lines of FASTQ
+		res.total_bases += l_seq;
+		res.headers.emplace_back(std::string(reinterpret_cast<const char*>(read_name), name_len), qual_header_type::empty);
+		res.quals.emplace_back(read, std::move(read_qual));
+		res.reads.emplace_back(hasN, std::move(read));
 	}
-	currentLine.shrink_to_fit();
-	addRead();
-	currentLine.clear();
 }
 
-void CInputReads::processFastq(std::vector<uint8_t>& buff, uint64_t readed, uint32_t buf_size, gzFile gzfile)
+// ************************************************************************************
+void CInputParser::parseFastqChunk(const chunk_t& chunk, CParsedReads& res) const
 {
 	enum class WhereInRead { read_header, read, qual_header, qual };
 	WhereInRead whereInRead = WhereInRead::read_header;
 
 	uint32_t record_lines = 4; //4 lines form fastq record
 
-	while (readed)
+	const uint8_t* data = chunk.data.data();
+	size_t size = chunk.data.size();
+
+	std::string last_read_header;
+
+	for (size_t pos = 0; pos < size; )
 	{
-		uint32_t pos = 0;
-		while (pos < readed)
+		auto eol = find_eol(data, pos, size);
+		if (eol == size)
+		{
+			std::cerr << "Error: something went wrong during input reading\n";
+			exit(1);
+		}
+		if (eol == pos) //we are skipping windows EOL
+		{
+			++pos;
+			continue;
+		}
+
+		const char* line = reinterpret_cast<const char*>(data + pos);
+		size_t line_len = eol - pos;
+		switch (whereInRead)
+		{
+		case WhereInRead::read_header:
+			res.total_symb_header += line_len;
+			last_read_header.assign(line + 1, line_len - 1); //remove '@'
+			break;
+		case WhereInRead::read:
 		{
-			if (buff[pos] == '\n' || buff[pos] == '\r') // EOL reached
+			bool hasN;
+			res.reads.emplace_back(false, to_read_t(line, line_len, hasN));
+			res.reads.back().first = hasN;
+			res.total_bases += line_len;
+			break;
+		}
+		case WhereInRead::qual_header:
+		{
+			qual_header_type type = qual_header_type::empty;
+			res.total_symb_header += line_len;
+			if (line_len > 1) //not only '+'
 			{
-				if (currentLine.empty()) //we are skipping windows EOL
-					++pos;
-				else
+				if (last_read_header.compare(0, std::string::npos, line + 1, line_len - 1) != 0)
 				{
-					currentLine.shrink_to_fit();
-					switch (whereInRead)
-					{
-					case WhereInRead::read_header:
-						addReadHeader();
-						break;
-					case WhereInRead::read:
-						addRead();
-						break;
-					case WhereInRead::qual_header:
-						addQualHeader();
-						break;
-					case WhereInRead::qual:
-						addQual();
-						break;
-					default:
-						break;
-					}
-					whereInRead = (WhereInRead)(((int)whereInRead + 1) % record_lines);
-					currentLine.clear();
-					++pos;
+					std::cerr << "Error: quality header not empty but different than read header\n";
+					exit(1);
 				}
+				type = qual_header_type::eq_read_header;
 			}
-			else
-				currentLine.push_back(buff[pos++]);
+			res.headers.emplace_back(std::move(last_read_header), type);
+			last_read_header = std::string();
+			break;
+		}
+		case WhereInRead::qual:
+			res.quals.emplace_back(res.reads.back().second, qual_t(data + pos, data + eol));
+			break;
+		default:
+			break;
 		}
-		readed = gzfread(buff.data(), 1, buf_size, gzfile);
-		total_bytes += readed;
+		whereInRead = (WhereInRead)(((int)whereInRead + 1) % record_lines);
+		pos = eol + 1;
 	}
 }
 
-
-CInputReads::CInputReads(bool verbose, const std::string& path, CParallelQueue<read_pack_t>& reads_queue, CParallelQueue<qual_pack_t>& quals_queue, CParallelQueue<header_pack_t>& headers_queue) :
-	stats(verbose),
-	reads_queue(reads_queue),
-	quals_queue(quals_queue),
-	headers_queue(headers_queue)
+// ************************************************************************************
+// Parsed records are regrouped here into packs of exactly the same size as if the input was parsed sequentially
+void CInputReads::addHeader(header_elem_t&& header)
 {
-	auto gzfile = gzopen(path.c_str(), "rb");
-	if (!gzfile)
+	current_header_bytes += header.first.size();
+	headers.emplace_back(std::move(header));
+	if (current_header_bytes >= headers_pack_size)
 	{
-		cerr << "Error: cannot open file: " << path << "\n";
-		exit(1);
+		current_header_bytes = 0;
+		headers_queue.Push(std::move(headers));
 	}
+}
 
-	const uint32_t buf_size = 1ul << 25;
-	std::vector<uint8_t> buff(buf_size);
-
-	uint64_t readed = gzfread(buff.data(), 1, buf_size, gzfile);
-	total_bytes += readed;
-	if (!readed)
-	{
-		int code;
-		auto errmsg = gzerror(gzfile, &code);
-		if (code < 0)
-		{
-			std::cerr << "zblib error: " << errmsg << "\n";
-			exit(1);
-		}
-		std::cerr << "Error: file " << path << " is empty\n";
-		exit(1);
-	}
-	if (buff[0] != '@' && buff[0] != '>')
+void CInputReads::addRead(std::pair<bool, read_t>&& read)
+{
+	current_reads_bytes += read.second.size();
+	stats.LogRead(read_len(read.second));
+	reads.emplace_back(std::move(read));
+	
+	if (current_reads_bytes >= reads_pack_size)
 	{
-		std::cerr << "Error: unknown file format\n";
-		exit(1);
+		current_reads_bytes = 0;
+		reads_queue.Push(std::move(reads));
 	}
-	is_fastq = buff[0] == '@';
+}
 
-	//FASTA or multi-fasta
-	if(!is_fastq)
-		porcessFastaOrMultiFasta(buff, readed, buf_size, gzfile);
-	else
-		processFastq(buff, readed, buf_size, gzfile);
+void CInputReads::addQual(qual_elem_t&& qual)
+{
+	quals.emplace_back(std::move(qual));
+	if(current_reads_bytes == 0) //if reads was just added then qual should be also, because the number of records should be the same for quals and for reads	
+		quals_queue.Push(std::move(quals));
+}
 
-	int code;
-	auto errmsg = gzerror(gzfile, &code);
-	if (code < 0)
-	{
-		std::cerr << "zblib error: " << errmsg << "\n";
-		exit(1);
-	}
+void CInputReads::storeChunk(CParsedReads& chunk)
+{
+	total_bases += chunk.total_bases;
+	total_symb_header += chunk.total_symb_header;
 
-	if (!currentLine.empty())
+	size_t n_records = std::max(chunk.reads.size(), chunk.headers.size());
+	for (size_t i = 0; i < n_records; ++i)
 	{
-		std::cerr << "Error: something went wrong during input reading\n";
-		exit(1);
+		//keep the order in which records were stored by the sequential reader: read header first for FASTA, after read for FASTQ
+		if (!chunk.is_fastq && i < chunk.headers.size())
+			addHeader(std::move(chunk.headers[i]));
+		if (i < chunk.reads.size())
+			addRead(std::move(chunk.reads[i]));
+		if (chunk.is_fastq && i < chunk.headers.size())
+			addHeader(std::move(chunk.headers[i]));
+		if (i < chunk.quals.size())
+			addQual(std::move(chunk.quals[i]));
 	}
-	gzclose(gzfile);
+}
 
-	
+// ************************************************************************************
+void CInputReads::finish()
+{
 	if (reads.size())
 		reads_queue.Push(std::move(reads));
 	if (quals.size())
@@ -295,4 +557,74 @@ CInputReads::CInputReads(bool verbose, const std::string& path, CParallelQueue<r
 	reads_queue.MarkCompleted();
 	quals_queue.MarkCompleted();
 	headers_queue.MarkCompleted();
-}
\ No newline at end of file
+}
+
+// ************************************************************************************
+CInputReads::CInputReads(bool verbose, const std::vector<std::string>& paths, CParallelQueue<read_pack_t>& reads_queue, CParallelQueue<qual_pack_t>& quals_queue, CParallelQueue<header_pack_t>& headers_queue, uint32_t n_threads, uint32_t n_inflate_threads, bool calc_digests) :
+	stats(verbose),
+	reads_queue(reads_queue),
+	quals_queue(quals_queue),
+	headers_queue(headers_queue)
+{
+	CInputParser parser(n_threads, [this](CParsedReads& chunk) { storeChunk(chunk); });
+
+	const uint32_t buf_size = 1ul << 23;
+	std::vector<uint8_t> buff(buf_size);
+
+	for (const auto& path : paths)
+	{
+		CInputFile in(path, n_inflate_threads);
+		CMD5 md5;
+		uint64_t file_bytes = 0;
+		while (uint64_t readed = in.Read(buff.data(), buf_size))
+		{
+			file_bytes += readed;
+			if (calc_digests)
+				md5.Update(buff.data(), readed);
+			parser.Add(buff.data(), readed);
+		}
+		if (!file_bytes)
+		{
+			std::cerr << "Error: file " << path << " is empty\n";
+			exit(1);
+		}
+		parser.EndFile();
+		total_bytes += file_bytes;
+		if (calc_digests)
+			input_digests.push_back(md5.Get());
+	}
+	parser.Finish();
+
+	finish();
+}
+
+// ************************************************************************************
+CInputReads::CInputReads(bool verbose, CInputSpool& spool, CParallelQueue<read_pack_t>& reads_queue, CParallelQueue<qual_pack_t>& quals_queue, CParallelQueue<header_pack_t>& headers_queue) :
+	stats(verbose),
+	reads_queue(reads_queue),
+	quals_queue(quals_queue),
+	headers_queue(headers_queue)
+{
+	total_bytes = spool.GetInputBytes();
+	if (!total_bytes)
+	{
+		std::cerr << "Error: input is empty\n";
+		exit(1);
+	}
+
+	//spooled chunks are decoded in a separate thread
+	CParallelQueue<CParsedReads> chunks_queue(2);
+	std::thread spool_reader([&spool, &chunks_queue] {
+		CParsedReads chunk;
+		while (spool.Read(chunk))
+			chunks_queue.Push(std::move(chunk));
+		chunks_queue.MarkCompleted();
+	});
+
+	CParsedReads chunk;
+	while (chunks_queue.Pop(chunk))
+		storeChunk(chunk);
+	spool_reader.join();
+
+	finish();
+}
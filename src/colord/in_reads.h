@@ -22,10 +22,13 @@
 #include "parallel_queue.h"
 #include "queues_data.h"
 #include "stats_collector.h"
-#include "zlib.h"
+#include "input_file.h"
 #include <string>
 #include <vector>
 #include <cassert>
+#include <functional>
+#include <memory>
+#include <thread>
 
 class CKmerWalker
 {
@@ -74,46 +77,121 @@ public:
 };
 
 
+// Records parsed from a part of the input
+struct CParsedReads
+{
+	bool is_fastq{};
+	read_pack_t reads;
+	qual_pack_t quals;
+	header_pack_t headers;
+	uint64_t total_bases{};
+	uint64_t total_symb_header{};
+};
+
+// Splits the input into chunks at record boundaries, the chunks are parsed in parallel and passed to the consumer in the input order
+class CInputParser
+{
+	// Fragment of the input starting at a record boundary, numbered so that parsed records may be put back in order
+	struct chunk_t
+	{
+		uint32_t id{};
+		bool is_last{};
+		std::vector<uint8_t> data;
+	};
+
+	static constexpr size_t chunk_size = 1ul << 23;
+
+	std::function<void(CParsedReads&)> consumer;
+
+	bool format_known = false;
+	bool is_fastq = false;
+	bool is_bam = false; //BAM records are stored as FASTQ
+	bool bam_header_pending = false; //each BAM file starts with a header, which is skipped
+
+	std::vector<uint8_t> buff;
+	size_t filled{};
+	size_t next_search = chunk_size;
+	uint32_t chunk_id{};
+
+	CParallelQueue<chunk_t> chunks_queue;
+	CParallelPriorityQueue<std::unique_ptr<CParsedReads>> parsed_queue;
+	std::vector<std::thread> parsers;
+	std::thread collector;
+	bool finished = false;
+
+	static read_t to_read_t(const char* str, size_t len, bool& hasN);
+
+	static size_t findFastaRecordsEnd(const std::vector<uint8_t>& buff, size_t size);
+	static size_t findFastqRecordsEnd(const std::vector<uint8_t>& buff, size_t size);
+	static size_t findBamRecordsEnd(const std::vector<uint8_t>& buff, size_t size);
+	static size_t bamHeaderSize(const std::vector<uint8_t>& buff, size_t size);
+
+	bool skipBamHeader();
+
+	void pushChunk(size_t end, bool is_last);
+	void parseFastaChunk(const chunk_t& chunk, CParsedReads& res) const;
+	void parseFastqChunk(const chunk_t& chunk, CParsedReads& res) const;
+	void parseBamChunk(const chunk_t& chunk, CParsedReads& res) const;
+public:
+	CInputParser(uint32_t n_threads, std::function<void(CParsedReads&)> consumer);
+	~CInputParser();
+
+	// Approximate peak memory of the parser: raw chunks in the buffer, the queue and the parsers (2n + 2)
+	// and parsed chunks, about twice as large as raw ones, in the parsers, the queue and the consumer (2n + 3)
+	static uint64_t EstimateMemory(uint32_t n_threads)
+	{
+		uint64_t n = std::max(n_threads, 1u);
+		return (2 * n + 2 + 2 * (2 * n + 3)) * chunk_size;
+	}
+
+	// Data may be split at any position
+	void Add(const uint8_t* data, size_t size);
+
+	// Marks the end of an input file, the next data come from another file
+	void EndFile();
+	void Finish();
+};
+
+class CInputSpool;
+
 class CInputReads
 {
 	CStatsCollector stats;
-	std::vector<std::pair<bool, read_t>> reads;	
-	std::vector<std::pair<read_t, qual_t>> quals;
-	std::vector<std::pair<std::string, qual_header_type>> headers;
+	read_pack_t reads;
+	qual_pack_t quals;
+	header_pack_t headers;
 
 	uint64_t current_reads_bytes{}, current_header_bytes{};
 	
 	CParallelQueue<read_pack_t>& reads_queue;
 	CParallelQueue<qual_pack_t>& quals_queue;
 	CParallelQueue<header_pack_t>& headers_queue;
-	
-	read_t to_read_t(const std::string& str, bool& hasN);
-
-
-	std::string currentLine;
-	read_t last_read;
-	std::string last_read_header;
-
-	bool is_fastq;
 
 	uint64_t total_bytes{};
 	uint64_t total_bases{};
 	uint64_t total_symb_header{};
+	std::vector<std::vector<uint8_t>> input_digests;
 
-	void addReadHeader();
-	void addRead();
-	void addQualHeader();
-	void addQual();
+	void addHeader(header_elem_t&& header);
+	void addRead(std::pair<bool, read_t>&& read);
+	void addQual(qual_elem_t&& qual);
 
-	void porcessFastaOrMultiFasta(std::vector<uint8_t>& buff, uint64_t readed, uint32_t buf_size, gzFile gzfile);
-	void processFastq(std::vector<uint8_t>& buff, uint64_t readed, uint32_t buf_size, gzFile gzfile);
+	void storeChunk(CParsedReads& chunk);
+	void finish();
 public:
-	explicit CInputReads(bool verbose, const std::string& path, CParallelQueue<read_pack_t>& reads_queue, CParallelQueue<qual_pack_t>& quals_queue, CParallelQueue<header_pack_t>& headers_queue);
+	// Input files are read one after another as if they were concatenated, if calc_digests is set md5 of each (decompressed) file is calculated
+	explicit CInputReads(bool verbose, const std::vector<std::string>& paths, CParallelQueue<read_pack_t>& reads_queue, CParallelQueue<qual_pack_t>& quals_queue, CParallelQueue<header_pack_t>& headers_queue, uint32_t n_threads = 1, uint32_t n_inflate_threads = 1, bool calc_digests = false);
+
+	// Reads the input parsed and spooled during the first pass
+	explicit CInputReads(bool verbose, CInputSpool& spool, CParallelQueue<read_pack_t>& reads_queue, CParallelQueue<qual_pack_t>& quals_queue, CParallelQueue<header_pack_t>& headers_queue);
 	void GetStats(uint64_t& total_bytes, uint64_t& total_bases, uint64_t& total_symb_header)
 	{
 		total_bytes = this->total_bytes;
 		total_bases = this->total_bases;
 		total_symb_header = this->total_symb_header;
 	}
+	const std::vector<std::vector<uint8_t>>& GetInputDigests() const
+	{
+		return input_digests;
+	}
 };
-
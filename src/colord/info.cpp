@@ -19,6 +19,7 @@
 #include "info.h"
 #include "utils.h"
 #include "archive.h"
+#include "archive_index.h"
 #include <ctime>
 
 void runInfo(const CInfoParams& params)
@@ -37,6 +38,9 @@ void runInfo(const CInfoParams& params)
 	std::vector<uint8_t> _info;
 	archive.GetPart(s_info, _info, meta);
 	info.Deserialize(_info);
+
+	CArchiveIndex archive_index;
+	bool has_index = archive_index.Load(archive);
 	archive.Close();
 
 	std::cerr << "version major: " << info.version_major << "\n";
@@ -49,5 +53,20 @@ void runInfo(const CInfoParams& params)
 	time_t time = info.time;
 	std::cerr << "time: " << asctime(localtime(&time)) << "\n";
 	std::cerr << "command: " << info.full_command_line<< "\n";
+
+	if (has_index)
+		for (const std::string stream_name : { "dna", "qual", "header" })
+		{
+			auto parts = archive_index.GetParts(stream_name);
+			if (!parts)
+				continue;
+			uint64_t n_symbols{}, n_restarts{};
+			for (const auto& part : *parts)
+			{
+				n_symbols += part.n_symbols;
+				n_restarts += part.restart;
+			}
+			std::cerr << stream_name << " parts: " << parts->size() << ", symbols: " << n_symbols << ", restart points: " << n_restarts << "\n";
+		}
 }
 
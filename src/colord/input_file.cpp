@@ -0,0 +1,252 @@
+/*******************************************************************************
+ 
+ CoLoRd 
+ Copyright (C) 2021, M. Kokot, S. Deorowicz, and A. Gudys
+ https://github.com/refresh-bio/CoLoRd
+
+ This program is free software: you can redistribute it and/or modify it under 
+ the terms of the GNU General Public License as published by the Free Software 
+ Foundation; either version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY 
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR 
+ A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along with this 
+ program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#include "input_file.h"
+#include <iostream>
+#include <cstring>
+#include <filesystem>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+namespace
+{
+	constexpr size_t bgzf_read_size = 1ul << 22;
+	constexpr size_t stdin_head_size = 1ul << 23;
+}
+
+// ************************************************************************************
+bool CInputFile::IsGzip(const uint8_t* data, size_t size)
+{
+	return size >= 2 && data[0] == 0x1f && data[1] == 0x8b;
+}
+
+// ************************************************************************************
+bool CInputFile::IsBgzf(const uint8_t* data, size_t size)
+{
+	return bgzf::IsBgzf(data, size);
+}
+
+// ************************************************************************************
+bool CInputFile::IsBgzfFile(const std::string& path)
+{
+	FILE* f = fopen(path.c_str(), "rb");
+	if (!f)
+		return false;
+	uint8_t header[64];
+	auto readed = fread(header, 1, sizeof(header), f);
+	fclose(f);
+	return IsBgzf(header, readed);
+}
+
+// ************************************************************************************
+CInputFile::CInputFile(const std::string& path, uint32_t n_threads)
+{
+	file = fopen(path.c_str(), "rb");
+	if (file)
+	{
+		setvbuf(file, nullptr, _IONBF, 0);
+		in_buff.resize(bgzf_read_size);
+		in_filled = fread(in_buff.data(), 1, in_buff.size(), file);
+		is_bgzf = IsBgzf(in_buff.data(), in_filled);
+	}
+	if (is_bgzf)
+	{
+		inflater = std::make_unique<bgzf::CInflater>(n_threads ? n_threads : 1);
+		return;
+	}
+
+	if (file)
+	{
+		fclose(file);
+		file = nullptr;
+	}
+	std::vector<uint8_t>().swap(in_buff);
+	in_filled = 0;
+
+	gzfile = gzopen(path.c_str(), "rb");
+	if (!gzfile)
+	{
+		std::cerr << "Error: cannot open file: " << path << "\n";
+		exit(1);
+	}
+}
+
+// ************************************************************************************
+CInputFile::~CInputFile()
+{
+	if (file)
+		fclose(file);
+	if (gzfile)
+		gzclose(gzfile);
+}
+
+// ************************************************************************************
+// Reads more compressed data, returns false at the end of file
+bool CInputFile::fill_in_buff()
+{
+	if (in_pos)
+	{
+		memmove(in_buff.data(), in_buff.data() + in_pos, in_filled - in_pos);
+		in_filled -= in_pos;
+		in_pos = 0;
+	}
+	if (in_buff.size() < in_filled + bgzf_read_size)
+		in_buff.resize(in_filled + bgzf_read_size);
+
+	auto readed = fread(in_buff.data() + in_filled, 1, in_buff.size() - in_filled, file);
+	if (ferror(file))
+	{
+		std::cerr << "Error: cannot read input file\n";
+		exit(1);
+	}
+	in_filled += readed;
+	return readed != 0;
+}
+
+// ************************************************************************************
+// Inflates complete blocks from in_buff (at least one, then as long as the output does not exceed max_out_size),
+// returns false if there is no complete block
+bool CInputFile::inflate_blocks(size_t max_out_size)
+{
+	out_buff.clear();
+	out_pos = 0;
+	size_t consumed = inflater->Inflate(in_buff.data() + in_pos, in_filled - in_pos, out_buff, max_out_size);
+	in_pos += consumed;
+	return consumed != 0;
+}
+
+// ************************************************************************************
+uint64_t CInputFile::Read(uint8_t* buff, uint64_t size)
+{
+	if (gzfile)
+	{
+		auto readed = gzfread(buff, 1, size, gzfile);
+		if (!readed)
+		{
+			int code;
+			auto errmsg = gzerror(gzfile, &code);
+			if (code < 0)
+			{
+				std::cerr << "zblib error: " << errmsg << "\n";
+				exit(1);
+			}
+		}
+		return readed;
+	}
+
+	uint64_t res = 0;
+	while (res < size)
+	{
+		if (out_pos == out_buff.size())
+		{
+			if (inflate_blocks(size - res))
+				continue;
+			if (!fill_in_buff())
+			{
+				if (in_pos != in_filled)
+				{
+					std::cerr << "Error: truncated BGZF file\n";
+					exit(1);
+				}
+				break;
+			}
+			continue;
+		}
+		auto n_copy = std::min<uint64_t>(size - res, out_buff.size() - out_pos);
+		memcpy(buff + res, out_buff.data() + out_pos, n_copy);
+		out_pos += n_copy;
+		res += n_copy;
+	}
+	return res;
+}
+
+// ************************************************************************************
+bool CInputFile::ReadStdinHead(std::vector<uint8_t>& head)
+{
+#ifdef _WIN32
+	_setmode(_fileno(stdin), _O_BINARY);
+#endif
+	head.resize(stdin_head_size);
+	head.resize(fread(head.data(), 1, head.size(), stdin));
+	if (ferror(stdin))
+	{
+		std::cerr << "Error: cannot read standard input\n";
+		exit(1);
+	}
+	if (head.empty())
+	{
+		std::cerr << "Error: standard input is empty\n";
+		exit(1);
+	}
+	return head.size() < stdin_head_size;
+}
+
+// ************************************************************************************
+std::vector<uint8_t> CInputFile::PeekInflated(const std::vector<uint8_t>& data, size_t size)
+{
+	if (!IsGzip(data.data(), data.size()))
+		return std::vector<uint8_t>(data.begin(), data.begin() + std::min(size, data.size()));
+
+	std::vector<uint8_t> res(size);
+	z_stream stream{};
+	if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+		return {};
+	stream.next_in = const_cast<Bytef*>(data.data());
+	stream.avail_in = static_cast<uInt>(data.size());
+	stream.next_out = res.data();
+	stream.avail_out = static_cast<uInt>(size);
+	inflate(&stream, Z_SYNC_FLUSH);
+	res.resize(size - stream.avail_out);
+	inflateEnd(&stream);
+	return res;
+}
+
+// ************************************************************************************
+std::string CInputFile::StoreStdin(const std::string& dir, const std::vector<uint8_t>& head)
+{
+	//k-mer counter recognizes gzipped input by the extension
+	std::string path = (std::filesystem::path(dir) / (IsGzip(head.data(), head.size()) ? "stdin.gz" : "stdin")).string();
+	FILE* out = fopen(path.c_str(), "wb");
+	if (!out)
+	{
+		std::cerr << "Error: cannot open file " << path << "\n";
+		exit(1);
+	}
+	if (fwrite(head.data(), 1, head.size(), out) != head.size())
+	{
+		std::cerr << "Error: cannot write to file " << path << "\n";
+		exit(1);
+	}
+	const size_t buf_size = 1ul << 23;
+	std::vector<uint8_t> buff(buf_size);
+	for (size_t readed; (readed = fread(buff.data(), 1, buf_size, stdin)) != 0; )
+		if (fwrite(buff.data(), 1, readed, out) != readed)
+		{
+			std::cerr << "Error: cannot write to file " << path << "\n";
+			exit(1);
+		}
+	if (ferror(stdin))
+	{
+		std::cerr << "Error: cannot read standard input\n";
+		exit(1);
+	}
+	fclose(out);
+	return path;
+}
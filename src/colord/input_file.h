@@ -0,0 +1,73 @@
+/*******************************************************************************
+ 
+ CoLoRd 
+ Copyright (C) 2021, M. Kokot, S. Deorowicz, and A. Gudys
+ https://github.com/refresh-bio/CoLoRd
+
+ This program is free software: you can redistribute it and/or modify it under 
+ the terms of the GNU General Public License as published by the Free Software 
+ Foundation; either version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY 
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR 
+ A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along with this 
+ program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#pragma once
+
+#include "zlib.h"
+#include "../common/bgzf/bgzf.h"
+#include <cstdio>
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include <memory>
+
+// Input file, gzipped or not. BGZF (blocked gzip) files are inflated block by block in parallel,
+// other files are read through zlib
+class CInputFile
+{
+	gzFile gzfile{};
+	FILE* file{};
+	bool is_bgzf{};
+	std::unique_ptr<bgzf::CInflater> inflater;
+
+	std::vector<uint8_t> in_buff; //compressed BGZF data, the last block may be incomplete
+	size_t in_pos{}, in_filled{};
+	std::vector<uint8_t> out_buff;
+	size_t out_pos{};
+
+	bool inflate_blocks(size_t max_out_size);
+	bool fill_in_buff();
+public:
+	CInputFile(const std::string& path, uint32_t n_threads);
+	~CInputFile();
+	CInputFile(const CInputFile&) = delete;
+	CInputFile& operator=(const CInputFile&) = delete;
+
+	// Returns the number of bytes read, 0 at the end of file
+	uint64_t Read(uint8_t* buff, uint64_t size);
+
+	bool IsBgzf() const
+	{
+		return is_bgzf;
+	}
+
+	static bool IsGzip(const uint8_t* data, size_t size);
+	// Checks if data start with BGZF block header (gzip header with BC extra subfield)
+	static bool IsBgzf(const uint8_t* data, size_t size);
+	static bool IsBgzfFile(const std::string& path);
+
+	// Reads the beginning of the standard input (to recognize its format), returns true if it is the whole input
+	static bool ReadStdinHead(std::vector<uint8_t>& head);
+	// Returns at most size first bytes of the data, inflated if the data are gzipped (they may be truncated)
+	static std::vector<uint8_t> PeekInflated(const std::vector<uint8_t>& data, size_t size);
+
+	// Stores standard input as it is (gzipped or not), starting with its already read head, in a file in the given directory,
+	// the path of the file is returned. It is needed if the input is read more than once (without the spool k-mer counting
+	// and compression read it separately), so it cannot be read from a pipe directly
+	static std::string StoreStdin(const std::string& dir, const std::vector<uint8_t>& head);
+};
@@ -0,0 +1,302 @@
+/*******************************************************************************
+ 
+ CoLoRd 
+ Copyright (C) 2021, M. Kokot, S. Deorowicz, and A. Gudys
+ https://github.com/refresh-bio/CoLoRd
+
+ This program is free software: you can redistribute it and/or modify it under 
+ the terms of the GNU General Public License as published by the Free Software 
+ Foundation; either version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY 
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR 
+ A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along with this 
+ program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#include "input_spool.h"
+#include <iostream>
+#include <filesystem>
+#include <cstring>
+
+using namespace std;
+
+// ************************************************************************************
+void CInputSpool::serialize(const CParsedReads& chunk, std::vector<uint8_t>& out)
+{
+	out.clear();
+	out.push_back(chunk.is_fastq);
+	StoreLittleEndian(out, static_cast<uint64_t>(chunk.reads.size()));
+	StoreLittleEndian(out, static_cast<uint64_t>(chunk.quals.size()));
+	StoreLittleEndian(out, static_cast<uint64_t>(chunk.headers.size()));
+	StoreLittleEndian(out, chunk.total_bases);
+	StoreLittleEndian(out, chunk.total_symb_header);
+
+	uint64_t n_bases = 0;
+	for (const auto& read : chunk.reads)
+	{
+		StoreLittleEndian(out, static_cast<uint32_t>(read_len(read.second)));
+		out.push_back(read.first);
+		n_bases += read_len(read.second);
+	}
+
+	//runs of N as (start, len) pairs
+	for (const auto& read : chunk.reads)
+	{
+		if (!read.first)
+			continue;
+		auto len = read_len(read.second);
+		std::vector<std::pair<uint32_t, uint32_t>> runs;
+		for (uint32_t i = 0; i < len; )
+		{
+			if (read.second[i] != 4)
+			{
+				++i;
+				continue;
+			}
+			uint32_t start = i;
+			while (i < len && read.second[i] == 4)
+				++i;
+			runs.emplace_back(start, i - start);
+		}
+		StoreLittleEndian(out, static_cast<uint32_t>(runs.size()));
+		for (const auto& run : runs)
+		{
+			StoreLittleEndian(out, run.first);
+			StoreLittleEndian(out, run.second);
+		}
+	}
+
+	//bases of all reads packed 2 bits per symbol, N stored as A
+	size_t packed_pos = out.size();
+	out.resize(packed_pos + (n_bases + 3) / 4);
+	uint8_t* packed = out.data() + packed_pos;
+	uint64_t base_pos = 0;
+	for (const auto& read : chunk.reads)
+	{
+		auto len = read_len(read.second);
+		for (uint32_t i = 0; i < len; ++i, ++base_pos)
+			packed[base_pos / 4] |= (read.second[i] & 3) << (2 * (base_pos % 4));
+	}
+
+	for (const auto& qual : chunk.quals)
+	{
+		StoreLittleEndian(out, static_cast<uint32_t>(qual.second.size()));
+		out.insert(out.end(), qual.second.begin(), qual.second.end());
+	}
+
+	for (const auto& header : chunk.headers)
+	{
+		out.push_back(static_cast<uint8_t>(header.second));
+		StoreLittleEndian(out, static_cast<uint32_t>(header.first.size()));
+		out.insert(out.end(), header.first.begin(), header.first.end());
+	}
+}
+
+// ************************************************************************************
+// Every length is checked against the remaining data, so a damaged spool file is reported instead of being read out of bounds
+void CInputSpool::deserialize(const std::vector<uint8_t>& in, CParsedReads& chunk)
+{
+	const uint8_t* ptr = in.data();
+	const uint8_t* end = ptr + in.size();
+	uint64_t n_reads, n_quals, n_headers;
+
+	auto corrupted = [] {
+		std::cerr << "Error: corrupted input spool\n";
+		exit(1);
+	};
+	auto require = [&end, &corrupted](const uint8_t* p, uint64_t n_bytes) {
+		if (static_cast<uint64_t>(end - p) < n_bytes)
+			corrupted();
+	};
+
+	require(ptr, 1 + 5 * 8);
+	chunk.is_fastq = *ptr++;
+	LoadLittleEndian(ptr, n_reads); ptr += 8;
+	LoadLittleEndian(ptr, n_quals); ptr += 8;
+	LoadLittleEndian(ptr, n_headers); ptr += 8;
+	LoadLittleEndian(ptr, chunk.total_bases); ptr += 8;
+	LoadLittleEndian(ptr, chunk.total_symb_header); ptr += 8;
+
+	//each read takes at least 5 bytes (length and N flag), so the count is checked before the reads are allocated
+	require(ptr, n_reads > in.size() / 5 ? UINT64_MAX : 5 * n_reads);
+	chunk.reads.clear();
+	chunk.reads.resize(n_reads);
+	uint64_t n_bases = 0;
+	for (auto& read : chunk.reads)
+	{
+		uint32_t len;
+		LoadLittleEndian(ptr, len); ptr += 4;
+		read.first = *ptr++;
+		n_bases += len;
+		require(ptr, (n_bases + 3) / 4); //packed bases follow, so they bound the size of the reads
+		read.second.resize(len + 1ull);
+		read.second[len] = 255; //guard
+	}
+
+	const uint8_t* runs_ptr = ptr;
+	for (const auto& read : chunk.reads)
+	{
+		if (!read.first)
+			continue;
+		uint32_t n_runs;
+		require(ptr, 4);
+		LoadLittleEndian(ptr, n_runs);
+		require(ptr, 4 + 8ull * n_runs);
+		ptr += 4 + 8ull * n_runs;
+	}
+
+	require(ptr, (n_bases + 3) / 4);
+	const uint8_t* packed = ptr;
+	uint64_t base_pos = 0;
+	for (auto& read : chunk.reads)
+	{
+		auto len = read_len(read.second);
+		for (uint32_t i = 0; i < len; ++i, ++base_pos)
+			read.second[i] = (packed[base_pos / 4] >> (2 * (base_pos % 4))) & 3;
+	}
+	ptr += (base_pos + 3) / 4;
+
+	for (auto& read : chunk.reads)
+	{
+		if (!read.first)
+			continue;
+		uint32_t n_runs;
+		LoadLittleEndian(runs_ptr, n_runs); runs_ptr += 4;
+		for (uint32_t r = 0; r < n_runs; ++r)
+		{
+			uint32_t start, len;
+			LoadLittleEndian(runs_ptr, start); runs_ptr += 4;
+			LoadLittleEndian(runs_ptr, len); runs_ptr += 4;
+			if (static_cast<uint64_t>(start) + len > read_len(read.second))
+				corrupted();
+			memset(read.second.data() + start, 4, len);
+		}
+	}
+
+	require(ptr, n_quals > in.size() / 4 ? UINT64_MAX : 4 * n_quals);
+	chunk.quals.clear();
+	chunk.quals.resize(n_quals);
+	for (uint64_t i = 0; i < n_quals; ++i)
+	{
+		uint32_t len;
+		require(ptr, 4);
+		LoadLittleEndian(ptr, len); ptr += 4;
+		require(ptr, len);
+		if (i < n_reads)
+			chunk.quals[i].first = chunk.reads[i].second;
+		chunk.quals[i].second.assign(ptr, ptr + len);
+		ptr += len;
+	}
+
+	require(ptr, n_headers > in.size() / 5 ? UINT64_MAX : 5 * n_headers);
+	chunk.headers.clear();
+	chunk.headers.resize(n_headers);
+	for (auto& header : chunk.headers)
+	{
+		require(ptr, 5);
+		header.second = static_cast<qual_header_type>(*ptr++);
+		uint32_t len;
+		LoadLittleEndian(ptr, len); ptr += 4;
+		require(ptr, len);
+		header.first.assign(reinterpret_cast<const char*>(ptr), len);
+		ptr += len;
+	}
+}
+
+// ************************************************************************************
+CInputSpool::CInputSpool(bool in_memory, const std::string& tmp_dir) :
+	in_memory(in_memory)
+{
+	if (in_memory)
+		return;
+
+	file_path = (std::filesystem::path(tmp_dir) / "input.spool").string();
+	file = fopen(file_path.c_str(), "w+b");
+	if (!file)
+	{
+		std::cerr << "Error: cannot open file " << file_path << "\n";
+		exit(1);
+	}
+	setvbuf(file, nullptr, _IOFBF, 1ul << 23);
+}
+
+// ************************************************************************************
+CInputSpool::~CInputSpool()
+{
+	if (file)
+	{
+		fclose(file);
+		std::error_code ec;
+		std::filesystem::remove(file_path, ec);
+	}
+}
+
+// ************************************************************************************
+void CInputSpool::Write(const CParsedReads& chunk)
+{
+	if (in_memory)
+	{
+		mem_chunks.emplace_back();
+		serialize(chunk, mem_chunks.back());
+		mem_chunks.back().shrink_to_fit();
+		spool_bytes += mem_chunks.back().size();
+		return;
+	}
+
+	serialize(chunk, io_buff);
+	uint8_t size_buff[8];
+	StoreLittleEndian(size_buff, static_cast<uint64_t>(io_buff.size()));
+	if (fwrite(size_buff, 1, 8, file) != 8 || fwrite(io_buff.data(), 1, io_buff.size(), file) != io_buff.size())
+	{
+		std::cerr << "Error: cannot write to file " << file_path << "\n";
+		exit(1);
+	}
+	spool_bytes += 8 + io_buff.size();
+}
+
+// ************************************************************************************
+void CInputSpool::FinishWriting()
+{
+	writing_finished = true;
+	if (file)
+	{
+		fflush(file);
+		rewind(file);
+	}
+}
+
+// ************************************************************************************
+bool CInputSpool::Read(CParsedReads& chunk)
+{
+	if (!writing_finished)
+	{
+		std::cerr << "Internal error: spool read before writing is finished\n";
+		exit(1);
+	}
+	if (in_memory)
+	{
+		if (mem_read_pos == mem_chunks.size())
+			return false;
+		deserialize(mem_chunks[mem_read_pos], chunk);
+		std::vector<uint8_t>().swap(mem_chunks[mem_read_pos++]); //the chunk will not be needed any more
+		return true;
+	}
+
+	uint8_t size_buff[8];
+	size_t readed = fread(size_buff, 1, 8, file);
+	if (readed == 0)
+		return false;
+	uint64_t size;
+	LoadLittleEndian(size_buff, size);
+	io_buff.resize(size);
+	if (readed != 8 || fread(io_buff.data(), 1, size, file) != size)
+	{
+		std::cerr << "Error: cannot read from file " << file_path << "\n";
+		exit(1);
+	}
+	deserialize(io_buff, chunk);
+	return true;
+}
@@ -0,0 +1,75 @@
+/*******************************************************************************
+ 
+ CoLoRd 
+ Copyright (C) 2021, M. Kokot, S. Deorowicz, and A. Gudys
+ https://github.com/refresh-bio/CoLoRd
+
+ This program is free software: you can redistribute it and/or modify it under 
+ the terms of the GNU General Public License as published by the Free Software 
+ Foundation; either version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY 
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR 
+ A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along with this 
+ program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#pragma once
+
+#include "in_reads.h"
+#include <cstdio>
+#include <cinttypes>
+#include <string>
+#include <vector>
+
+// Records parsed during the first pass over the input (while k-mers are counted), so that the second pass does not need to read and parse the input again.
+// Bases are packed 2 bits per symbol (N runs are stored separately), qualities and headers are stored as they are.
+// Chunks are kept in memory or in a temporary file.
+class CInputSpool
+{
+	bool in_memory;
+	std::string file_path;
+	FILE* file{};
+
+	std::vector<std::vector<uint8_t>> mem_chunks;
+	size_t mem_read_pos{};
+
+	uint64_t input_bytes{};
+	uint64_t spool_bytes{};
+	bool writing_finished = false;
+
+	std::vector<uint8_t> io_buff;
+
+	static void serialize(const CParsedReads& chunk, std::vector<uint8_t>& out);
+	static void deserialize(const std::vector<uint8_t>& in, CParsedReads& chunk);
+public:
+	CInputSpool(bool in_memory, const std::string& tmp_dir);
+	~CInputSpool();
+	CInputSpool(const CInputSpool&) = delete;
+	CInputSpool& operator=(const CInputSpool&) = delete;
+
+	// Chunks must be written in the input order
+	void Write(const CParsedReads& chunk);
+	
+	// Number of bytes of the (decompressed) input represented by the spool
+	void AddInputBytes(uint64_t size)
+	{
+		input_bytes += size;
+	}
+	void FinishWriting();
+
+	// Returns false if there are no more chunks
+	bool Read(CParsedReads& chunk);
+
+	uint64_t GetInputBytes() const
+	{
+		return input_bytes;
+	}
+
+	uint64_t GetSize() const
+	{
+		return spool_bytes;
+	}
+};
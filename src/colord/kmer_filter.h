@@ -21,65 +21,113 @@
 #include <string>
 #include <iostream>
 #include <limits>
+#include <vector>
+#include <functional>
+#include <cstring>
 
-//#include <unordered_map>
-#include "hs.h"
-#include "murmur64_hash.h"
 #include "../common/libs/libdivide/libdivide.h"
 
+class CFilteredKmersBins;
+
+// Static set of k-mers: k-mers are sorted and split into buckets by their highest bits, for each bucket only its start is stored
+// (relative to the start of its group of buckets) and for each k-mer only its remaining (lowest) bits are stored, bit-packed.
+// The set is built in parallel and only queried afterwards.
 class CCompactedKmers
 {
-	using hash_set_t = hash_set_lp<uint32_t, std::equal_to<uint32_t>, MurMur32Hash>;
-	uint32_t suffix_len_bits = 31;
+public:
+	// Calls add(kmer, count) for all k-mers of the given part, parts are disjoint and may be read concurrently, each part is read twice
+	using source_t = std::function<void(uint32_t part, const std::function<void(kmer_type kmer, uint32_t count)>& add)>;
+
+private:
+	static constexpr uint32_t prefix_suffix_len_bits = 31; // the same split as in k-mers to reads index, used to estimate its size
+	static constexpr uint32_t max_residual_bits = 56; // each residual must be readable with a single unaligned 64-bit load
+	static constexpr uint64_t linear_search_threshold = 16;
+	static constexpr uint32_t bucket_group_bits = 16;
+
+	uint32_t kmer_len_bits;
 	uint32_t prefix_len_bits;
-	uint64_t suffix_mask = (1ull << suffix_len_bits) - 1;
-	mutable std::vector<hash_set_t> hash_tables;
+	uint32_t bucket_bits{};
+	uint32_t residual_bits{};
+	uint64_t residual_mask{};
+	uint64_t n_kmers{};
+	uint64_t total_count{};
+
+	std::vector<uint64_t> bucket_group_starts;
+	std::vector<uint32_t> bucket_starts;
+	std::vector<uint64_t> residuals;
 
 #ifdef ESTIMATE_MEMORY_WITH_COUNTS_PER_PREFIX
 	std::vector<uint64_t> counts_per_prefix;
 #endif
 
+	uint64_t get_bucket_start(uint64_t bucket) const
+	{
+		return bucket_group_starts[bucket >> bucket_group_bits] + bucket_starts[bucket];
+	}
+
+	uint64_t get_residual(uint64_t pos) const
+	{
+		uint64_t bit_pos = pos * residual_bits;
+		uint64_t word;
+		memcpy(&word, reinterpret_cast<const uint8_t*>(residuals.data()) + bit_pos / 8, sizeof(word));
+		return (word >> (bit_pos % 8)) & residual_mask;
+	}
+
+	void set_residual(uint64_t pos, uint64_t residual)
+	{
+		uint64_t bit_pos = pos * residual_bits;
+		uint32_t offset = bit_pos % 64;
+		residuals[bit_pos / 64] |= residual << offset;
+		if (offset + residual_bits > 64)
+			residuals[bit_pos / 64 + 1] |= residual >> (64 - offset);
+	}
+
 public:
-	CCompactedKmers(uint32_t kmer_len, uint64_t total_kmers, double fill_factor_filtered_kmers)
+	explicit CCompactedKmers(uint32_t kmer_len)
 	{
-		uint32_t kmer_len_bits = kmer_len * 2;
-		if (kmer_len_bits > suffix_len_bits)
-			prefix_len_bits = kmer_len_bits - suffix_len_bits;
+		kmer_len_bits = kmer_len * 2;
+		if (kmer_len_bits > prefix_suffix_len_bits)
+			prefix_len_bits = kmer_len_bits - prefix_suffix_len_bits;
 		else
 			prefix_len_bits = 0;
-
-		uint32_t n_hash_tables = 1ul << prefix_len_bits;
-		uint64_t expected_sinle_ht_elems = total_kmers / n_hash_tables;
-		if (!expected_sinle_ht_elems)
-			expected_sinle_ht_elems = 16;
-		hash_tables.assign(n_hash_tables, hash_set_t(std::numeric_limits<uint32_t>::max(), static_cast<size_t>(expected_sinle_ht_elems / fill_factor_filtered_kmers), fill_factor_filtered_kmers, std::equal_to<uint32_t>{}, MurMur32Hash{}));
-#ifdef ESTIMATE_MEMORY_WITH_COUNTS_PER_PREFIX
-		counts_per_prefix.resize(n_hash_tables);
-#endif
 	}
-	void insert(kmer_type kmer
-#ifdef ESTIMATE_MEMORY_WITH_COUNTS_PER_PREFIX
-		, uint32_t count
-#endif
-	)
+
+	void Build(uint32_t n_threads, uint32_t n_parts, const source_t& source);
+
+	void Serialize(std::ostream& out) const;
+
+	// Loads the set stored with Serialize, returns false if the data are corrupted or were stored for a different k-mer length
+	bool Load(std::istream& in);
+
+	bool check(kmer_type kmer) const
 	{
-		uint32_t prefix = static_cast<uint32_t>(kmer >> suffix_len_bits);
-		uint32_t suffix = static_cast<uint32_t>(kmer & suffix_mask);
-//		hash_tables[prefix].insert(suffix);
-		hash_tables[prefix].insert_fast(suffix);
-#ifdef ESTIMATE_MEMORY_WITH_COUNTS_PER_PREFIX
-		counts_per_prefix[prefix] += count;
-#endif
+		uint64_t bucket = kmer >> residual_bits;
+		uint64_t residual = kmer & residual_mask;
+		uint64_t lo = get_bucket_start(bucket);
+		uint64_t hi = get_bucket_start(bucket + 1);
+
+		while (hi - lo > linear_search_threshold)
+		{
+			uint64_t mid = lo + (hi - lo) / 2;
+			if (get_residual(mid) < residual)
+				lo = mid + 1;
+			else
+				hi = mid + 1;
+		}
+		for (; lo < hi; ++lo)
+		{
+			auto x = get_residual(lo);
+			if (x >= residual)
+				return x == residual;
+		}
+		return false;
 	}
 
-	auto check(kmer_type kmer) const
+	uint64_t GetTotalCount() const
 	{
-		uint32_t prefix = static_cast<uint32_t>(kmer >> suffix_len_bits);
-		uint32_t suffix = static_cast<uint32_t>(kmer & suffix_mask);
-		return hash_tables[prefix].check(suffix);
+		return total_count;
 	}
 
-
 #ifdef ESTIMATE_MEMORY_WITH_COUNTS_PER_PREFIX
 	uint64_t GetCountPerPrefix(uint32_t prefix) const
 	{
@@ -94,12 +142,7 @@ public:
 
 	uint64_t GetMemoryUsage() const
 	{
-		uint32_t prefix = 0;
-		uint32_t n_prefixes = 1ul << prefix_len_bits;
-		uint64_t tot_size_bytes{};
-		for (; prefix < n_prefixes; ++prefix)
-			tot_size_bytes += hash_tables[prefix].allocated_size() * sizeof(hash_set_t::key_type);
-		return tot_size_bytes + sizeof(std::vector<hash_set_t>) * hash_tables.size();
+		return (bucket_group_starts.size() + residuals.size()) * sizeof(uint64_t) + bucket_starts.size() * sizeof(uint32_t);
 	}
 
 	void PrintMemoryUsage() const
@@ -107,24 +150,27 @@ public:
 		std::cerr << "Filtered k-mers memory usage: " << (GetMemoryUsage() / 1024 / 1024) << "MiB\n";
 	}
 
-	uint32_t GetNHashTables() const
+	uint32_t GetNPrefixes() const
 	{
-		return hash_tables.size();
+		return 1ul << prefix_len_bits;
 	}
-
 };
 
 class CKmerFilter
 {
 	kmer_type hash_mm(kmer_type x) const;
 	CCompactedKmers kmers;
-	uint64_t total_count_filtered{};
 	uint32_t modulo;
 	libdivide::divider<uint64_t> div;
 
 
 public:
-	explicit CKmerFilter(const std::string& kmcDbPath, uint32_t modulo, uint32_t kmer_len, uint64_t tot_uniqe_kmers, double fill_factor_filtered_kmers, bool verbose);
+	explicit CKmerFilter(const std::string& kmcDbPath, uint32_t modulo, uint32_t kmer_len, uint32_t n_threads, bool verbose);
+	explicit CKmerFilter(const CFilteredKmersBins& kmersBins, uint32_t modulo, uint32_t kmer_len, uint32_t n_threads, bool verbose);
+	// Loads k-mers stored with Serialize
+	explicit CKmerFilter(std::istream& in, uint32_t modulo, uint32_t kmer_len, bool verbose);
+
+	void Serialize(std::ostream& out) const;
 
 	bool Possible(kmer_type kmer) const
 	{
@@ -168,7 +214,7 @@ public:
 	
 	uint64_t GetTotalKmers() const
 	{
-		return total_count_filtered;
+		return kmers.GetTotalCount();
 	}
 
 #ifdef ESTIMATE_MEMORY_WITH_COUNTS_PER_PREFIX
@@ -192,8 +238,8 @@ public:
 		kmers.PrintMemoryUsage();
 	}
 
-	uint32_t GetNHashTables() const
+	uint32_t GetNPrefixes() const
 	{
-		return kmers.GetNHashTables();
+		return kmers.GetNPrefixes();
 	}
 };
@@ -1,6 +1,23 @@
 #pragma once
 #include <cinttypes>
 #include <string>
+#include <functional>
+#include <vector>
+
+// Part of a bin of filtered k-mers, the same data as stored in the kmc database:
+// records are k-mers suffixes (big endian) followed by counters (little endian), sorted within a bin,
+// lut contains the numbers of records for consecutive prefixes (of lutPrefixLen symbols) of a bin
+struct CFilteredKmersPack
+{
+	int32_t binId;
+	uint32_t lutPrefixLen;
+	uint32_t counterSize;
+	const uint8_t* records;
+	uint64_t recordsSize; // in bytes
+	const uint64_t* lut; // continues the lut of the previous pack of the same bin
+	uint64_t lutSize; // in elements
+	bool endOfBin;
+};
 
 struct CFilteringParams
 {
@@ -14,5 +31,10 @@ struct CFilteringParams
 	std::string tmpPath;	
 	std::string statsFile;
 	bool is_fasta;
+	bool is_bam = false;
+	uint32_t maxRamGB = 0; // 0 - KMC default, otherwise the limit is strict
+	std::function<void(const uint8_t* data, uint64_t size, bool end_of_file)> inputObserver; // if set, receives the whole (decompressed) input in order, the end of each input file is marked
+	std::function<void(const CFilteredKmersPack& pack)> kmersObserver; // if set, receives filtered k-mers (from a single thread) instead of storing them in the kmc database
+	std::vector<uint8_t> stdinHead; // if an input file is "-" the standard input is read, these are its first bytes already read by the caller (e.g. to recognize the format)
 };
 int run_filtering_kmc(const CFilteringParams& params);
@@ -0,0 +1,248 @@
+/*******************************************************************************
+ 
+ CoLoRd 
+ Copyright (C) 2021, M. Kokot, S. Deorowicz, and A. Gudys
+ https://github.com/refresh-bio/CoLoRd
+
+ This program is free software: you can redistribute it and/or modify it under 
+ the terms of the GNU General Public License as published by the Free Software 
+ Foundation; either version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY 
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR 
+ A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along with this 
+ program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#pragma once
+#include "utils.h"
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Reads packed 2 bits per symbol, 4 symbols per byte with the first one in the most significant bits.
+// The packed read is followed by a byte with the number of symbols in the last (partially filled) byte (0 if it is full).
+inline read_t pack_read(const read_t& read)
+{
+	auto in_len = read_len(read);
+	size_t out_len = (in_len + 3) / 4 + 1; //one for number of symbols in last byte
+	read_t res(out_len);
+
+	auto full_bytes = in_len / 4; //number of fully filled bytes in output
+	uint8_t symbols_in_last_byte = in_len % 4;
+
+	uint32_t in_pos = 0;
+	for (uint32_t i = 0; i < full_bytes; ++i)
+	{
+		res[i] = read[in_pos++] << 6;
+		res[i] += read[in_pos++] << 4;
+		res[i] += read[in_pos++] << 2;
+		res[i] += read[in_pos++];
+	}
+
+	switch (symbols_in_last_byte)
+	{
+	case 3:
+		res[out_len - 2] += read[in_pos++] << 6;
+		res[out_len - 2] += read[in_pos++] << 4;
+		res[out_len - 2] += read[in_pos++] << 2;
+		break;
+	case 2:
+		res[out_len - 2] += read[in_pos++] << 6;
+		res[out_len - 2] += read[in_pos++] << 4;
+		break;
+	case 1:
+		res[out_len - 2] += read[in_pos++] << 6;
+		break;
+	}
+	assert(in_pos == in_len);
+	res[out_len - 1] = symbols_in_last_byte;
+
+	return res;
+}
+
+inline uint32_t packed_read_len(const read_t& packed)
+{
+	auto symbols_in_last_byte = packed.back();
+	auto full_bytes = packed.size() - 2 + !symbols_in_last_byte;
+	return static_cast<uint32_t>(full_bytes * 4 + symbols_in_last_byte);
+}
+
+// Read-only view of a packed read (see pack_read) or of its reverse complement, used to analyse the candidates without decompacting them
+class packed_read_view
+{
+	const uint8_t* _data;
+	uint32_t len;
+	uint32_t n_bytes;
+	bool rev_comp;
+
+	static uint64_t bswap(uint64_t x)
+	{
+#ifdef _MSC_VER
+		return _byteswap_uint64(x);
+#else
+		return __builtin_bswap64(x);
+#endif
+	}
+
+	// reverses the order of 2-bit symbols
+	static uint64_t reverse_symbols(uint64_t x)
+	{
+		x = bswap(x);
+		x = ((x >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((x & 0x0F0F0F0F0F0F0F0Full) << 4);
+		return ((x >> 2) & 0x3333333333333333ull) | ((x & 0x3333333333333333ull) << 2);
+	}
+
+	// 32 symbols of the stored read starting at pos (pos may be negative), the symbols outside the read are zeros
+	uint64_t dir_word(int64_t pos) const
+	{
+		int64_t byte_pos = pos >= 0 ? pos / 4 : -((3 - pos) / 4);
+		uint32_t shift = static_cast<uint32_t>(pos - byte_pos * 4) * 2;
+
+		uint64_t hi;
+		uint8_t lo;
+		if (byte_pos >= 0 && byte_pos + 9 <= n_bytes)
+		{
+			memcpy(&hi, _data + byte_pos, 8);
+			hi = bswap(hi);
+			lo = _data[byte_pos + 8];
+		}
+		else
+		{
+			hi = 0;
+			for (int64_t i = byte_pos; i < byte_pos + 8; ++i)
+				hi = (hi << 8) | (i >= 0 && i < n_bytes ? _data[i] : 0u);
+			lo = byte_pos + 8 >= 0 && byte_pos + 8 < n_bytes ? _data[byte_pos + 8] : 0u;
+		}
+		return shift ? (hi << shift) | (lo >> (8 - shift)) : hi;
+	}
+
+public:
+	packed_read_view(const read_t& packed, bool rev_comp = false) :
+		_data(packed.data()),
+		len(packed_read_len(packed)),
+		n_bytes((len + 3) / 4),
+		rev_comp(rev_comp)
+	{
+	}
+
+	uint32_t size() const
+	{
+		return len;
+	}
+
+	uint8_t operator[](uint32_t idx) const
+	{
+		if (rev_comp)
+			idx = len - 1 - idx;
+		uint8_t symb = (_data[idx / 4] >> (6 - 2 * (idx % 4))) & 3;
+		return rev_comp ? 3 - symb : symb;
+	}
+
+	// Symbols [pos, pos + 32) of the view, the first one in the most significant bits, the symbols past the end of the view are unspecified
+	uint64_t Word(uint32_t pos) const
+	{
+		if (!rev_comp)
+			return dir_word(pos);
+		return ~reverse_symbols(dir_word(static_cast<int64_t>(len) - pos - 32));
+	}
+
+	// Calls f(mmer, pos) for all m-mers (m <= 32) in the order of positions, 32 symbols are fetched at once
+	template<typename F>
+	void ForEachMmer(uint32_t m, F&& f) const
+	{
+		if (len < m)
+			return;
+		uint64_t mask = m == 32 ? ~0ull : (1ull << (2 * m)) - 1;
+		uint64_t mmer{};
+		for (uint32_t start = 0; start < len; start += 32)
+		{
+			uint64_t w = Word(start);
+			uint32_t end = std::min(start + 32, len);
+			for (uint32_t pos = start; pos < end; ++pos, w <<= 2)
+			{
+				mmer = ((mmer << 2) | (w >> 62)) & mask;
+				if (pos + 1 >= m)
+					f(mmer, pos + 1 - m);
+			}
+		}
+	}
+
+	// As ForEachMmer, but f(mmer, canonical, pos) gets also the canonical m-mer
+	template<typename F>
+	void ForEachMmerWithCanonical(uint32_t m, F&& f) const
+	{
+		uint32_t rev_shift = 2 * (m - 1);
+		uint64_t rev{};
+		if (len < m)
+			return;
+		uint64_t mask = m == 32 ? ~0ull : (1ull << (2 * m)) - 1;
+		uint64_t mmer{};
+		for (uint32_t start = 0; start < len; start += 32)
+		{
+			uint64_t w = Word(start);
+			uint32_t end = std::min(start + 32, len);
+			for (uint32_t pos = start; pos < end; ++pos, w <<= 2)
+			{
+				uint64_t symb = w >> 62;
+				mmer = ((mmer << 2) | symb) & mask;
+				rev = (rev >> 2) | ((3 - symb) << rev_shift);
+				if (pos + 1 >= m)
+					f(mmer, mmer < rev ? mmer : rev, pos + 1 - m);
+			}
+		}
+	}
+};
+
+// Number of equal symbols of a and b starting at pos_a and pos_b going to the right (at most max_len), compares 32 symbols at once
+inline uint32_t packed_match_right(const packed_read_view& a, uint32_t pos_a, const packed_read_view& b, uint32_t pos_b, uint32_t max_len)
+{
+	uint32_t res = 0;
+	while (res < max_len)
+	{
+		uint32_t n = std::min(32u, max_len - res);
+		uint64_t x = a.Word(pos_a + res) ^ b.Word(pos_b + res);
+		if (n < 32)
+			x &= ~(~0ull >> (2 * n));
+		if (x)
+		{
+#ifdef _MSC_VER
+			unsigned long idx;
+			_BitScanReverse64(&idx, x);
+			return res + (63 - idx) / 2;
+#else
+			return res + __builtin_clzll(x) / 2;
+#endif
+		}
+		res += n;
+	}
+	return res;
+}
+
+// Number of equal symbols of a and b ending at pos_a - 1 and pos_b - 1 going to the left (at most max_len), compares 32 symbols at once
+inline uint32_t packed_match_left(const packed_read_view& a, uint32_t pos_a, const packed_read_view& b, uint32_t pos_b, uint32_t max_len)
+{
+	uint32_t res = 0;
+	while (res < max_len)
+	{
+		uint32_t n = std::min(32u, max_len - res);
+		uint64_t x = a.Word(pos_a - res - n) ^ b.Word(pos_b - res - n);
+		x >>= 64 - 2 * n;
+		if (x)
+		{
+#ifdef _MSC_VER
+			unsigned long idx;
+			_BitScanForward64(&idx, x);
+			return res + idx / 2;
+#else
+			return res + __builtin_ctzll(x) / 2;
+#endif
+		}
+		res += n;
+	}
+	return res;
+}
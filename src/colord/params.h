@@ -19,6 +19,7 @@
 #pragma once
 
 #include <cctype>
+#include <cstdint>
 #include <string>
 #include <thread>
 #include <vector>
@@ -44,14 +45,16 @@ enum class QualityComprMode {
 enum class HeaderComprMode { Original, Main, None };
 enum class ReferenceReadsMode { All, Sparse }; //All - all reads (except containing N) are kept as reference, Sparse - only some part of reads is kept as reference
 enum class DataSource {ONT, PBRaw, PBHiFi};
-enum class CompressionPriority { Ratio, Balanced, Memory };
+enum class CompressionPriority { Ratio, Balanced, Memory, Speed };
+enum class InputSpoolMode { Auto, None, Disk, Memory }; //Auto - Disk for gzipped input, None otherwise
 struct CCompressorParams
 {
 	DataSource dataSource = DataSource::ONT;
 	CompressionPriority priority = CompressionPriority::Balanced;
 
-	std::string inputFilePath;
-	std::string outputFilePath;
+	std::vector<std::string> inputFilePaths; // "-" for standard input
+	std::string outputFilePath; // "-" for standard output
+	std::string tmpDirPath; // if empty, directory of the output file (system temporary directory for standard output)
 	uint32_t kmerLen = 0;
 	uint32_t anchorLen = 0;
 	int32_t compressionLevel = 2;
@@ -59,13 +62,16 @@ struct CCompressorParams
 	uint32_t maxKmerCount = 100;
 	uint32_t filterHashModulo = 9;
 	uint32_t maxCandidates = 8;
+	uint32_t minimizerWindow = 1; // if > 1 only minimizers of windows of this number of k-mers are used to find similar reads
 	double editScriptCostMultiplier = 1.0;
 	uint32_t maxRecurence = 5;
 	uint32_t minPartLenToConsiderAltRead = 48; // minimum length of encoding part to consider using alternative read
 	double minFractionOfMmersInEncode = 0.5; // if A is set of m-mers in encode read R then read is refused from encoding if |A| < minFractionOfMmersInEncode * len(R)
 	double minFractionOfMmersInEncodeToAlwaysEncode = 0.9; // if A is set of m-mers in encode read R then read is accepted to encoding always if |A| > minFractionOfMmersInEncodeToAlwaysEncode * len(R)
 	double maxMatchesMultiplier = 10; // if the number of matches between encode read R and reference read is r, then read is refused from encoding if r > maxMatchesMultiplier * len(R)
+	double maxEncodeEffort = 2000; // if nonzero, the work spent on encoding read R (scanned candidate symbols and alignment words) is limited to maxEncodeEffort * len(R), the remainder of R is stored plain
 	uint32_t nThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	double maxMemory = 0; // in GB, 0 - no limit, otherwise the settings are adjusted to fit in the limit (or compression is refused)
 	QualityComprMode qualityComprMode = QualityComprMode::QuadThreshold;
 	//int qualityThreshold = 7;
 	std::vector<uint32_t> qualityFwdThresholds;
@@ -80,17 +86,26 @@ struct CCompressorParams
 
 	bool verbose = false;
 
-	double fillFactorFilteredKmers = 0.75;
 	double fillFactorKmersToReads = 0.8;
 
 	std::string refGenomePath;
 	bool storeRefGenome = false;
 
+	uint32_t dnaBlockSize = 0; // if nonzero DNA stream is split into independently decodable blocks of (at least) this number of reads
+	uint32_t qualBlockSize = 0; // if nonzero quality stream is split into independently decodable blocks of (at least) this number of reads
+
+	InputSpoolMode inputSpoolMode = InputSpoolMode::Auto; // records parsed while counting k-mers may be kept, so the input is read and parsed only once
+
+	std::string saveIndexPath; // if set, the filtered k-mers and the input stats are stored, so the next compression of the same input may skip k-mer counting
+	std::string loadIndexPath; // if set, the filtered k-mers and the input stats are loaded instead of counting k-mers
+
 	struct {
 		std::string qual_mode;
 		std::string header_mode;
 		std::string reference_mode;
 		std::string priority;
+		std::string spool_mode;
+		double fill_factor_filtered_kmers = 0; // deprecated, accepted for compatibility only
 	} internal; //for parsing
 };
 
@@ -99,6 +114,9 @@ std::string compressionPriorityToString(CompressionPriority compressionPriority)
 
 std::string dataSourceToString(DataSource dataSource);
 
+InputSpoolMode inputSpoolModeFromString(const std::string& str);
+std::string inputSpoolModeToString(InputSpoolMode inputSpoolMode);
+
 HeaderComprMode headerComprModeFromString(const std::string& str);
 std::string headerComprModeToString(HeaderComprMode headerComprMode);
 
@@ -117,6 +135,14 @@ struct CDecompressorParams
 
 	std::string refGenomePath;
 	bool verbose = false;
+	uint32_t nThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	uint64_t readsFrom = 0; // range of reads to decompress [readsFrom, readsTo), numbered from 0
+	uint64_t readsTo = UINT64_MAX;
+
+	struct {
+		std::string reads_range;
+	} internal; //for parsing
 };
 
 struct CInfoParams
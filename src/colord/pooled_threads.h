@@ -26,9 +26,10 @@ namespace pooled_threads
 	class thread
 	{
 		bool _joinable = false;
-		ThreadPoolTask* task;
+		ThreadPoolTask* task = nullptr;
 		void Create(std::function<void()>&& f);
 	public:
+		thread() = default;
 		thread(const thread&) = delete;
 		thread& operator=(const thread&) = delete;
 
@@ -34,7 +34,7 @@ void CQualityCoder::Init(bool _is_compressing, QualityComprMode _quality_mode, D
 	compression_level = _compression_level;
 	input_stream_size = _input_stream_size;
 
-	v_vios_io = new CVectorIOStream(v_io);
+	v_vios_io = new CVectorIOStream(v_io, &in_view);
 
 	CBasicRangeCoder<CVectorIOStream>* rc;
 
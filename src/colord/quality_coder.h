@@ -161,11 +161,11 @@ public:
 	{
 		if(verbose)
 		{
-			cout << "Quality quality_binary size  : " << m_quality_binary_rc.get_size() << endl;
-			cout << "Quality quality_quad size    : " << m_quality_quad_rc.get_size() << endl;
-			cout << "Quality quality_quinary size : " << m_quality_quinary_rc.get_size() << endl;
-			cout << "Quality quality_original size: " << m_quality_original_rc.get_size() << endl;
-			cout << "Quality quality_byte size    : " << m_quality_byte_rc.get_size() << endl;
+			cerr << "Quality quality_binary size  : " << m_quality_binary_rc.get_size() << endl;
+			cerr << "Quality quality_quad size    : " << m_quality_quad_rc.get_size() << endl;
+			cerr << "Quality quality_quinary size : " << m_quality_quinary_rc.get_size() << endl;
+			cerr << "Quality quality_original size: " << m_quality_original_rc.get_size() << endl;
+			cerr << "Quality quality_byte size    : " << m_quality_byte_rc.get_size() << endl;
 		}
 
 		delete tpl_quality_binary_rc;
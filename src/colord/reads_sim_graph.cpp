@@ -20,14 +20,84 @@
 #include <unordered_set>
 #include <algorithm>
 #include <iostream>
-#include <unordered_map>
 #include <map>
 #include <iterator>
+#include <atomic>
+#include <thread>
+#include <deque>
 
 #include "pooled_threads.h"
 #include "timer.h"
+#include "candidates_counter.h"
 
 
+// Stores distinct k-mers of the read accepted by the filter.
+// If minimizer_window > 1 only minimizers are stored, i.e., k-mers of the lowest hash in any window of minimizer_window consecutive accepted k-mers
+// (the single lowest one if the read contains fewer accepted k-mers). Whether a k-mer is accepted depends only on the k-mer, so reads sharing
+// a fragment containing a whole window share its minimizer; there are about (minimizer_window + 1) / 2 times less k-mers to insert and query
+static void extractAcceptedKmers(const read_t& read, uint32_t kmer_len, uint32_t minimizer_window, const CKmerFilter& filteredKmers, std::vector<kmer_type>& accepted_kmers)
+{
+	if (read_len(read) < kmer_len)
+		return;
+
+	kmer_type kmer;
+	CKmerWalker kmerWalker(read, kmer_len, kmer);
+	uint32_t kmers_in_read = static_cast<uint32_t>(read_len(read)) - kmer_len + 1;
+	hash_set_t already_processed_kmers(~0ull, static_cast<size_t>(kmers_in_read / 0.4), 0.4, std::equal_to<uint64_t>{}, MurMur64Hash{});
+
+	if (minimizer_window <= 1)
+	{
+		while (kmerWalker.NextKmer())
+		{
+//			if (auto it = already_processed_kmers.insert(kmer); !it.second) //skip already processed k-mer
+			if (!filteredKmers.Possible(kmer) || !already_processed_kmers.insert_fast(kmer)) //skip already processed k-mer
+				continue;
+
+			if (filteredKmers.Check(kmer))
+				accepted_kmers.push_back(kmer);
+		}
+		return;
+	}
+
+	struct candidate_t
+	{
+		uint32_t no;	//among accepted k-mers of the read
+		uint64_t order;
+		kmer_type kmer;
+	};
+
+	//candidates of the current window in increasing numbers and (strictly) increasing order, the first one is the minimizer
+	std::deque<candidate_t> window;
+	uint32_t last_minimizer_no = std::numeric_limits<uint32_t>::max();
+
+	auto add_minimizer = [&] {
+		if (window.empty() || window.front().no == last_minimizer_no)
+			return;
+		last_minimizer_no = window.front().no;
+		if (already_processed_kmers.insert_fast(window.front().kmer))
+			accepted_kmers.push_back(window.front().kmer);
+	};
+
+	uint32_t no = 0;
+	while (kmerWalker.NextKmer())
+	{
+		if (!filteredKmers.Possible(kmer) || !filteredKmers.Check(kmer))
+			continue;
+
+		//the filter already uses MurMur64Hash of k-mer, so a different key is hashed to make the order independent of it
+		uint64_t order = MurMur64Hash{}(kmer ^ 0x9e3779b97f4a7c15ull);
+		while (!window.empty() && window.back().order > order)
+			window.pop_back();
+		window.push_back(candidate_t{ no, order, kmer });
+		if (window.front().no + minimizer_window <= no)
+			window.pop_front();
+		if (++no >= minimizer_window)
+			add_minimizer();
+	}
+	if (no < minimizer_window)
+		add_minimizer();
+}
+
 #ifdef USE_BETTER_PARALLELIZATION_IN_GRAPH
 class GetAcceptedKmersQueue
 {
@@ -106,10 +176,11 @@ class CReadsSimilarityGraphInternalThreads
 #endif
 	GetAcceptedKmersQueue Q;
 	uint32_t kmer_len;
+	uint32_t minimizer_window;
 	const CKmerFilter& filteredKmers;
 	CParallelQueuePopWaiting<CCompressPack>& compress_queue;
 	const read_pack_t* reads_pack;
-	std::vector<std::pair<read_t*, std::vector<kmer_type>>>* accepted_kmers;
+	accepted_kmers_t* accepted_kmers;
 public:
 #ifdef MEASURE_THREADS_TIMES
 	std::vector<double>& GetTwTimes()
@@ -117,8 +188,9 @@ public:
 		return twTimes;
 	}
 #endif
-	CReadsSimilarityGraphInternalThreads(uint32_t maxRunning, uint32_t _kmer_len, const CKmerFilter& _filteredKmers, CParallelQueuePopWaiting<CCompressPack>& _compress_queue) :
+	CReadsSimilarityGraphInternalThreads(uint32_t maxRunning, uint32_t _kmer_len, uint32_t _minimizer_window, const CKmerFilter& _filteredKmers, CParallelQueuePopWaiting<CCompressPack>& _compress_queue) :
 		kmer_len(_kmer_len),
+		minimizer_window(_minimizer_window),
 		filteredKmers(_filteredKmers),
 		compress_queue(_compress_queue)
 	{
@@ -142,23 +214,7 @@ public:
 					if (hasN)
 						continue;
 
-					if (read_len(read) < kmer_len)
-						continue;
-
-					kmer_type kmer;
-					CKmerWalker kmerWalker(read, kmer_len, kmer);
-					uint32_t kmers_in_read = static_cast<uint32_t>(read_len(read)) - kmer_len + 1;
-					hash_set_t already_processed_kmers(~0ull, static_cast<size_t>(kmers_in_read / 0.4), 0.4, std::equal_to<uint64_t>{}, MurMur64Hash{});
-
-					while (kmerWalker.NextKmer())
-					{
-//						if (auto it = already_processed_kmers.insert(kmer); !it.second) //skip already processed k-mer
-						if (!filteredKmers.Possible(kmer) || !already_processed_kmers.insert_fast(kmer)) //skip already processed k-mer
-							continue;
-
-						if (filteredKmers.Check(kmer))
-							(*accepted_kmers)[i].second.push_back(kmer);
-					}
+					extractAcceptedKmers(read, kmer_len, minimizer_window, filteredKmers, (*accepted_kmers)[i].second);
 				}
 				Q.NotifyTaskCompleted(compress_queue.GetNWaitingOnPop() + 1);
 			}
@@ -169,7 +225,7 @@ public:
 		});
 	}
 
-	void Run(const read_pack_t* reads_pack, std::vector<std::pair<read_t*, std::vector<kmer_type>>>* accepted_kmers)
+	void Run(const read_pack_t* reads_pack, accepted_kmers_t* accepted_kmers)
 	{
 		this->reads_pack = reads_pack;
 		this->accepted_kmers = accepted_kmers;
@@ -218,9 +274,9 @@ public:
 };
 
 
-std::vector<std::pair<read_t*, std::vector<kmer_type>>> CReadsSimilarityGraph::getAcceptedKmers(const read_pack_t& reads_pack)
+accepted_kmers_t CReadsSimilarityGraph::getAcceptedKmers(const read_pack_t& reads_pack)
 {
-	std::vector<std::pair<read_t*, std::vector<kmer_type>>> accepted_kmers(reads_pack.size());
+	accepted_kmers_t accepted_kmers(reads_pack.size());
 
 	internalThreads->Run(&reads_pack, &accepted_kmers);
 
@@ -228,10 +284,10 @@ std::vector<std::pair<read_t*, std::vector<kmer_type>>> CReadsSimilarityGraph::g
 }
 #else
 
-std::vector<std::pair<read_t*, std::vector<kmer_type>>> CReadsSimilarityGraph::getAcceptedKmers(const read_pack_t& reads_pack)
+accepted_kmers_t CReadsSimilarityGraph::getAcceptedKmers(const read_pack_t& reads_pack)
 {
-	std::vector<std::pair<read_t*, std::vector<kmer_type>>> accepted_kmers(reads_pack.size());
-	uint32_t n_threads = 1 + compress_queue.GetNWaitingOnPop();
+	accepted_kmers_t accepted_kmers(reads_pack.size());
+	uint32_t n_threads = getNStageThreads(true);
 	std::vector<pooled_threads::thread> threads;
 	uint32_t per_threads = static_cast<uint32_t>(reads_pack.size()) / n_threads;
 
@@ -260,23 +316,7 @@ std::vector<std::pair<read_t*, std::vector<kmer_type>>> CReadsSimilarityGraph::g
 				if (hasN)
 					continue;
 
-				if (read_len(read) < kmer_len)
-					continue;
-
-				kmer_type kmer;
-				CKmerWalker kmerWalker(read, kmer_len, kmer);
-				uint32_t kmers_in_read = static_cast<uint32_t>(read_len(read)) - kmer_len + 1;
-				hash_set_t already_processed_kmers(~0ull, static_cast<size_t>(kmers_in_read / 0.4), 0.4, std::equal_to<uint64_t>{}, MurMur64Hash{});
-
-				while (kmerWalker.NextKmer())
-				{
-//					if (auto it = already_processed_kmers.insert(kmer); !it.second) //skip already processed k-mer
-					if (!already_processed_kmers.insert_fast(kmer)) //skip already processed k-mer
-						continue;
-
-					if (filteredKmers.Check(kmer))
-						accepted_kmers[i].second.push_back(kmer);
-				}
+				extractAcceptedKmers(read, kmer_len, minimizer_window, filteredKmers, accepted_kmers[i].second);
 			}
 #ifdef MEASURE_THREADS_TIMES
 			tw.stopTimer();
@@ -321,208 +361,274 @@ void CReadsSimilarityGraph::processReferenceGenome(CReferenceGenome* reference_g
 	reference_genome->Release();
 }
 
-void CReadsSimilarityGraph::processReadsPack(const read_pack_t& reads_pack)
+namespace
 {
-	auto accepted_kmers = getAcceptedKmers(reads_pack);
-
-	std::vector<std::pair<uint32_t, uint32_t>> neighbours;
-	std::unordered_map<uint32_t, uint32_t> m;
-
-	m.max_load_factor(1.0);
+	// Runs body(tno) for tno in [0, n_threads), the calling thread runs body(0)
+	template<typename BODY>
+	void runInThreads(uint32_t n_threads, const BODY& body)
+	{
+		std::vector<pooled_threads::thread> threads;
+		for (uint32_t tno = 1; tno < n_threads; ++tno)
+			threads.emplace_back([&body, tno] { body(tno); });
+		body(0);
+		for (auto& th : threads)
+			th.join();
+	}
 
-	assert(reads_pack.size() == accepted_kmers.size());
-	for(size_t i = 0 ; i < reads_pack.size() ; ++i)
+	// Thread joined when it goes out of scope, also if the scope is left by an exception
+	class CJoiningThread
 	{
-		auto& [read, read_kmers] = accepted_kmers[i];
-		bool hasN = reads_pack[i].first;
-		
-		bool acceptRefRead = !hasN;
-		if (referenceReadsMode == ReferenceReadsMode::Sparse)
-			acceptRefRead &= ref_reads_accepter.ShouldAddToReference(current_read_id);
+		std::thread th;
+	public:
+		template<typename CALLABLE>
+		explicit CJoiningThread(CALLABLE&& f) : th(std::forward<CALLABLE>(f)) {}
+		CJoiningThread(const CJoiningThread&) = delete;
+		CJoiningThread& operator=(const CJoiningThread&) = delete;
+
+		void join()
+		{
+			if (th.joinable())
+				th.join();
+		}
 
-		if (acceptRefRead)
+		~CJoiningThread()
 		{
-			reference_reads.Add(*read);
-			++id_in_reference;
+			join();
 		}
+	};
+}
 
-//		std::unordered_map<uint32_t, uint32_t> m;
+// K-mers extraction and hits search run concurrently, each in its own thread. One idle encoder is taken by the extra thread,
+// the remaining ones are shared between the stages, so together they do not run more threads than the idle encoders
+uint32_t CReadsSimilarityGraph::getNStageThreads(bool kmers_extraction) const
+{
+	uint32_t n_idle = compress_queue.GetNWaitingOnPop();
+	uint32_t n_helpers = n_idle ? n_idle - 1 : 0;
+	return 1 + (kmers_extraction ? n_helpers / 2 : n_helpers - n_helpers / 2);
+}
 
-/*		for (auto& kmer : read_kmers)
-		{
-			auto [localit, loc_end] = kmers.find(kmer);
-			uint32_t kmer_card = 0;
+void CReadsSimilarityGraph::assignReferenceIds(const read_pack_t& reads_pack, const accepted_kmers_t& accepted_kmers)
+{
+	pack_ref_ids.resize(reads_pack.size());
+	pack_first_kmer.resize(reads_pack.size() + 1);
+	pack_first_kmer[0] = 0;
 
-			for (; localit != loc_end; ++localit)
-			{
-				++m[localit->second];
-				++kmer_card;
-			}
+	for (size_t i = 0; i < reads_pack.size(); ++i)
+	{
+		bool acceptRefRead = !reads_pack[i].first;
+		if (referenceReadsMode == ReferenceReadsMode::Sparse)
+			acceptRefRead &= ref_reads_accepter.ShouldAddToReference(current_read_id + static_cast<uint32_t>(i));
 
-			if (acceptRefRead && kmer_card < maxKmerCount)
-			{
-				kmers.insert(kmer, id_in_reference - 1);
-			}
-		}*/
+		pack_ref_ids[i] = acceptRefRead ? id_in_reference++ : not_in_reference;
+		pack_first_kmer[i + 1] = pack_first_kmer[i] + static_cast<uint32_t>(accepted_kmers[i].second.size());
+	}
+}
+
+// For each k-mer of the pack finds the reference reads containing it and adds the k-mer of reads accepted to the reference set.
+// Shards of k-mers are processed in parallel, but within a shard the reads are processed in order, so each read sees
+// exactly the reads preceding it (as in sequential processing) and the result does not depend on the number of threads
+void CReadsSimilarityGraph::findKmersHits(const accepted_kmers_t& accepted_kmers, uint32_t n_threads)
+{
+	uint32_t n_shards = kmers.GetNShards();
+	uint32_t n_reads = static_cast<uint32_t>(accepted_kmers.size());
+	uint32_t tot_kmers = pack_first_kmer.back();
+
+	//split k-mers occurrences into shards, ranges of reads of similar number of k-mers are processed in parallel
+	std::vector<uint32_t> range_first_read(n_threads + 1, n_reads);
+	range_first_read[0] = 0;
+	for (uint32_t i = 0, range = 1; i < n_reads && range < n_threads; ++i)
+		if (pack_first_kmer[i] >= static_cast<uint64_t>(tot_kmers) * range / n_threads)
+			range_first_read[range++] = i;
+
+	shard_kmers.resize(n_threads);
+	for (auto& x : shard_kmers)
+	{
+		x.resize(n_shards);
+		for (auto& y : x)
+			y.clear();
+	}
+
+	runInThreads(n_threads, [&](uint32_t tno) {
+		auto& range_kmers = shard_kmers[tno];
+		for (uint32_t i = range_first_read[tno]; i < range_first_read[tno + 1]; ++i)
+		{
+			const auto& read_kmers = accepted_kmers[i].second;
+			for (uint32_t j = 0; j < read_kmers.size(); ++j)
+				range_kmers[kmers.GetShard(read_kmers[j])].push_back(kmer_occurrence_t{ read_kmers[j], i, pack_first_kmer[i] + j });
+		}
+	});
 
-		m.clear();
+	shard_hits.resize(n_shards);
+	kmers_hits.resize(tot_kmers);
+	std::atomic<uint32_t> next_shard{};
 
+	runInThreads(n_threads, [&](uint32_t) {
 		const uint32_t pf_prefix_offset = 2;
 		const uint32_t pf_suffix_offset = 4;
 
-		uint32_t read_kmers_size = static_cast<uint32_t>(read_kmers.size());
-		for (uint32_t i = 0; i < read_kmers_size; ++i)
+		for (uint32_t shard; (shard = next_shard.fetch_add(1)) < n_shards; )
 		{
-			if(i + pf_prefix_offset < read_kmers_size)
-				kmers.prefetch_prefix(read_kmers[i + pf_prefix_offset]);
-			if(i + pf_suffix_offset < read_kmers_size)
-				kmers.prefetch_suffix(read_kmers[i + pf_suffix_offset]);
-
-			auto [localit, loc_end] = kmers.find(read_kmers[i]);
-			uint32_t kmer_card = 0;
+			auto& hits = shard_hits[shard];
+			hits.clear();
 
-			for (; localit != loc_end; ++localit)
+			for (uint32_t range = 0; range < n_threads; ++range)
 			{
-				++m[localit->second];
-				++kmer_card;
-			}
+				const auto& occs = shard_kmers[range][shard];
+				uint32_t n_occs = static_cast<uint32_t>(occs.size());
+				for (uint32_t i = 0; i < n_occs; ++i)
+				{
+					if (i + pf_prefix_offset < n_occs)
+						kmers.prefetch_prefix(occs[i + pf_prefix_offset].kmer);
+					if (i + pf_suffix_offset < n_occs)
+						kmers.prefetch_suffix(occs[i + pf_suffix_offset].kmer);
 
-			if (acceptRefRead && kmer_card < maxKmerCount)
-			{
-				kmers.insert(read_kmers[i], id_in_reference - 1);
-			}
+					uint32_t first_hit = static_cast<uint32_t>(hits.size());
 
-		}
+					if (genome_kmers)
+						for (auto [localit, loc_end] = genome_kmers->find(occs[i].kmer); localit != loc_end; ++localit)
+							hits.push_back(localit->second);
 
-		current_out_queue_elem.data.emplace_back();
-		current_out_queue_elem.data.back().read_id = current_read_id;
-		current_out_queue_elem.data.back().hasN = hasN;
-		current_out_queue_elem.data.back().read = move(*read);
+					for (auto [localit, loc_end] = kmers.find(occs[i].kmer); localit != loc_end; ++localit)
+						hits.push_back(localit->second);
 
-		neighbours.clear();
-		neighbours.reserve(m.size());
+					uint32_t kmer_card = static_cast<uint32_t>(hits.size()) - first_hit;
+					kmers_hits[occs[i].kmer_no] = std::make_pair(first_hit, kmer_card);
 
-		for (const auto& e : m)
-			neighbours.emplace_back(e);
+					uint32_t ref_id = pack_ref_ids[occs[i].read_no];
+					if (ref_id != not_in_reference && kmer_card < maxKmerCount)
+						kmers.insert(occs[i].kmer, ref_id);
+				}
+			}
+		}
+	});
+}
 
-		auto min_iter = std::begin(neighbours);
-		min_iter += std::min(max_candidates, (uint32_t) neighbours.size());
+void CReadsSimilarityGraph::processReadsPack(const read_pack_t& reads_pack, accepted_kmers_t& accepted_kmers)
+{
+	assert(reads_pack.size() == accepted_kmers.size());
 
-		std::partial_sort(std::begin(neighbours), min_iter, std::end(neighbours), [](const auto& e1, const auto& e2) {
-			if (e1.second != e2.second)
-				return e1.second > e2.second;
-			return e1.first < e2.first;
-		});
+	uint32_t n_threads = getNStageThreads(false);
+	assignReferenceIds(reads_pack, accepted_kmers);
+	findKmersHits(accepted_kmers, n_threads);
 
-		if (neighbours.size() > max_candidates)
-			neighbours.resize(max_candidates);
+	size_t out_first = current_out_queue_elem.data.size();
+	current_out_queue_elem.data.resize(out_first + reads_pack.size());
+	std::atomic<uint32_t> next_read{};
 
-		for (const auto&  elem : neighbours)
-			current_out_queue_elem.data.back().ref_reads.push_back(elem.first);
+	runInThreads(n_threads, [&](uint32_t) {
+		CCandidatesCounter counter;
+		std::vector<uint32_t> top;
 
-		++current_read_id;
-	}
-
-	//kmers.PrintMemoryUsage();
-}
+		for (uint32_t i; (i = next_read.fetch_add(1)) < reads_pack.size(); )
+		{
+			auto& [read, read_kmers] = accepted_kmers[i];
+			bool hasN = reads_pack[i].first;
 
-void CReadsSimilarityGraph::processReadsPackHiFi(const read_pack_t& reads_pack)
-{
-	auto accepted_kmers = getAcceptedKmers(reads_pack);
+			if (pack_ref_ids[i] != not_in_reference)
+				reference_reads.Set(pack_ref_ids[i], *read);
 
-	std::vector<std::pair<uint32_t, std::pair<uint32_t, kmer_type>>> neighbours;
+			counter.Clear();
 
-	std::vector<std::vector<kmer_type>> common_kmers;
-	std::unordered_map<uint32_t, std::pair<uint32_t, uint32_t>> m; //maps reads id to (number of commont k-mers with current read, id in commont k-mers container)
+			uint32_t read_kmers_size = static_cast<uint32_t>(read_kmers.size());
+			for (uint32_t j = 0; j < read_kmers_size; ++j)
+			{
+				auto [first_hit, n_hits] = kmers_hits[pack_first_kmer[i] + j];
+				const uint32_t* hits = shard_hits[kmers.GetShard(read_kmers[j])].data() + first_hit;
+				for (uint32_t k = 0; k < n_hits; ++k)
+					counter.Add(hits[k]);
+			}
 
-	m.max_load_factor(1.0);
+			auto& out = current_out_queue_elem.data[out_first + i];
+			out.read_id = current_read_id + i;
+			out.hasN = hasN;
+			out.read = move(*read);
 
-	assert(reads_pack.size() == accepted_kmers.size());
-	for(size_t i = 0 ; i < reads_pack.size() ; ++i)
-	{
-		auto& [read, read_kmers] = accepted_kmers[i];
-		bool hasN = reads_pack[i].first;
-		
-		bool acceptRefRead = !hasN;
-		if (referenceReadsMode == ReferenceReadsMode::Sparse)
-			acceptRefRead &= ref_reads_accepter.ShouldAddToReference(current_read_id);
+			counter.GetTop(max_candidates, top);
+			const auto& candidates = counter.GetCandidates();
 
-		if (acceptRefRead)
-		{
-			reference_reads.Add(*read);
-			++id_in_reference;
+			out.ref_reads.reserve(top.size());
+			for (auto cand_id : top)
+				out.ref_reads.push_back(candidates[cand_id].first);
 		}
-		
-		m.clear();
-		common_kmers.clear();
+	});
 
-		const uint32_t pf_prefix_offset = 2;
-		const uint32_t pf_suffix_offset = 4;
+	current_read_id += static_cast<uint32_t>(reads_pack.size());
 
-		uint32_t read_kmers_size = static_cast<uint32_t>(read_kmers.size());
-		for (uint32_t i = 0; i < read_kmers_size; ++i)
-		{
-			if(i + pf_prefix_offset < read_kmers_size)
-				kmers.prefetch_prefix(read_kmers[i + pf_prefix_offset]);
-			if(i + pf_suffix_offset < read_kmers_size)
-				kmers.prefetch_suffix(read_kmers[i + pf_suffix_offset]);
+	//kmers.PrintMemoryUsage();
+}
 
-			auto [localit, loc_end] = kmers.find(read_kmers[i]);
-			uint32_t kmer_card = 0;
+void CReadsSimilarityGraph::processReadsPackHiFi(const read_pack_t& reads_pack, accepted_kmers_t& accepted_kmers)
+{
+	assert(reads_pack.size() == accepted_kmers.size());
 
-			for (; localit != loc_end; ++localit)
-			{
-				auto& info = m[localit->second];
-				++info.first;
-				if (info.first == 1)
-				{
-					common_kmers.emplace_back();
-					info.second = static_cast<uint32_t>(common_kmers.size()) - 1;
-				}
-				common_kmers[info.second].push_back(read_kmers[i]);
+	uint32_t n_threads = getNStageThreads(false);
+	assignReferenceIds(reads_pack, accepted_kmers);
+	findKmersHits(accepted_kmers, n_threads);
 
-				++m[localit->second].first;
-				++kmer_card;
-			}
+	size_t out_first = current_out_queue_elem.data.size();
+	current_out_queue_elem.data.resize(out_first + reads_pack.size());
+	std::atomic<uint32_t> next_read{};
 
-			if (acceptRefRead && kmer_card < maxKmerCount)
-			{
-				kmers.insert(read_kmers[i], id_in_reference - 1);
-			}
+	runInThreads(n_threads, [&](uint32_t) {
+		CCandidatesCounter counter;
+		std::vector<uint32_t> top;
+		std::vector<uint32_t> hits_cand_ids;	//position in candidates of each hit
+		std::vector<uint32_t> cand_rank;		//position in top of each candidate
+		const uint32_t not_selected = std::numeric_limits<uint32_t>::max();
 
-		}
+		for (uint32_t i; (i = next_read.fetch_add(1)) < reads_pack.size(); )
+		{
+			auto& [read, read_kmers] = accepted_kmers[i];
+			bool hasN = reads_pack[i].first;
 
-		current_out_queue_elem.data.emplace_back();
-		current_out_queue_elem.data.back().read_id = current_read_id;
-		current_out_queue_elem.data.back().hasN = hasN;
-		current_out_queue_elem.data.back().read = move(*read);
+			if (pack_ref_ids[i] != not_in_reference)
+				reference_reads.Set(pack_ref_ids[i], *read);
 
-		neighbours.clear();
-		neighbours.reserve(m.size());
+			counter.Clear();
+			hits_cand_ids.clear();
 
-		for (const auto& e : m)
-			neighbours.emplace_back(e);
+			uint32_t read_kmers_size = static_cast<uint32_t>(read_kmers.size());
+			for (uint32_t j = 0; j < read_kmers_size; ++j)
+			{
+				auto [first_hit, n_hits] = kmers_hits[pack_first_kmer[i] + j];
+				const uint32_t* hits = shard_hits[kmers.GetShard(read_kmers[j])].data() + first_hit;
+				for (uint32_t k = 0; k < n_hits; ++k)
+					hits_cand_ids.push_back(counter.Add(hits[k]));
+			}
 
-		auto min_iter = std::begin(neighbours);
-		min_iter += std::min(max_candidates, (uint32_t) neighbours.size());
+			auto& out = current_out_queue_elem.data[out_first + i];
+			out.read_id = current_read_id + i;
+			out.hasN = hasN;
+			out.read = move(*read);
 
-		std::partial_sort(std::begin(neighbours), min_iter, std::end(neighbours), [](const auto& e1, const auto& e2) {
-			if (e1.second.first != e2.second.first)
-				return e1.second.first > e2.second.first;
-			return e1.first < e2.first;
-		});
+			counter.GetTop(max_candidates, top);
+			if (top.empty())
+				continue;
 
-		if (neighbours.size() > max_candidates)
-			neighbours.resize(max_candidates);
+			const auto& candidates = counter.GetCandidates();
+			cand_rank.assign(candidates.size(), not_selected);
+			out.ref_reads.reserve(top.size());
+			out.common_kmers.resize(top.size());
+			for (uint32_t r = 0; r < top.size(); ++r)
+			{
+				cand_rank[top[r]] = r;
+				out.ref_reads.push_back(candidates[top[r]].first);
+				out.common_kmers[r].reserve(candidates[top[r]].second);
+			}
 
-		for (const auto& elem : neighbours)
-		{
-			current_out_queue_elem.data.back().ref_reads.push_back(elem.first);
-			current_out_queue_elem.data.back().common_kmers.emplace_back(std::move(common_kmers[elem.second.second]));
+			//common k-mers of the selected candidates, in the order of k-mers in the read
+			const uint32_t* hit_cand_id = hits_cand_ids.data();
+			for (uint32_t j = 0; j < read_kmers_size; ++j)
+			{
+				uint32_t n_hits = kmers_hits[pack_first_kmer[i] + j].second;
+				for (uint32_t k = 0; k < n_hits; ++k)
+					if (uint32_t r = cand_rank[*hit_cand_id++]; r != not_selected)
+						out.common_kmers[r].push_back(read_kmers[j]);
+			}
 		}
+	});
 
-		++current_read_id;
-	}
+	current_read_id += static_cast<uint32_t>(reads_pack.size());
 
 	//kmers.PrintMemoryUsage();
 }
@@ -531,40 +637,68 @@ CReadsSimilarityGraph::CReadsSimilarityGraph(CParallelQueue<read_pack_t>& reads_
 	CParallelQueuePopWaiting<CCompressPack>& compress_queue,
 	CReferenceReads& reference_reads,
 	CReferenceGenome* reference_genome,
-	const CKmerFilter& filteredKmers, uint32_t kmer_len, uint32_t max_candidates, uint32_t maxKmerCount, ReferenceReadsMode referenceReadsMode, CRefReadsAccepter& ref_reads_accepter,
+	const CKmerFilter& filteredKmers, uint32_t kmer_len, uint32_t minimizer_window, uint32_t max_candidates, uint32_t maxKmerCount, ReferenceReadsMode referenceReadsMode, CRefReadsAccepter& ref_reads_accepter,
 	double refReadsFraction,
 	int n_compression_threads,
 	DataSource dataSource,
 	double fill_factor_kmers_to_reads,
+	uint32_t dnaBlockSize,
 	bool verbose):
 	compress_queue(compress_queue),
 	reference_reads(reference_reads),
 	filteredKmers(filteredKmers),
 	kmer_len(kmer_len),
+	minimizer_window(minimizer_window),
 	max_candidates(max_candidates),
 	maxKmerCount(maxKmerCount),
-	kmers(kmer_len, static_cast<uint32_t>(filteredKmers.GetTotalKmers() * refReadsFraction), fill_factor_kmers_to_reads),
+	//a few shards per thread, so the threads are balanced even if some shards are larger
+	kmers(kmer_len, 8 * (n_compression_threads + 1), fill_factor_kmers_to_reads),
 	referenceReadsMode(referenceReadsMode),
 	ref_reads_accepter(ref_reads_accepter),
 	n_compression_threads(n_compression_threads),
-	dataSource(dataSource)
+	dataSource(dataSource),
+	dna_block_splitter(dnaBlockSize)
 #ifdef USE_BETTER_PARALLELIZATION_IN_GRAPH
 	,
-	internalThreads(std::make_unique<CReadsSimilarityGraphInternalThreads>(n_compression_threads + 1, kmer_len, filteredKmers, compress_queue))
+	internalThreads(std::make_unique<CReadsSimilarityGraphInternalThreads>(n_compression_threads + 1, kmer_len, minimizer_window, filteredKmers, compress_queue))
 #endif // USE_BETTER_PARALLELIZATION_IN_GRAPH
 {
 	processReferenceGenome(reference_genome);
-	read_pack_t reads_pack;
-	while (reads_queue.Pop(reads_pack))
+	n_ref_genome_pseudo_reads = id_in_reference;
+	if (dna_block_splitter.IsEnabled() && n_ref_genome_pseudo_reads)
+	{
+		genome_kmers = std::make_unique<CKmersToReads>(kmer_len, 8 * (n_compression_threads + 1), fill_factor_kmers_to_reads);
+		std::swap(*genome_kmers, kmers);
+	}
+
+	//k-mers of the next packs are extracted while the current pack is processed, accepted k-mers point to reads, so they are passed together
+	CParallelQueue<std::pair<read_pack_t, accepted_kmers_t>> accepted_kmers_queue(accepted_kmers_queue_size);
+	CJoiningThread kmers_extractor([this, &reads_queue, &accepted_kmers_queue] {
+		read_pack_t reads_pack;
+		while (reads_queue.Pop(reads_pack))
+		{
+			auto accepted_kmers = getAcceptedKmers(reads_pack);
+			accepted_kmers_queue.Push(std::make_pair(std::move(reads_pack), std::move(accepted_kmers)));
+		}
+		accepted_kmers_queue.MarkCompleted();
+	});
+
+	std::pair<read_pack_t, accepted_kmers_t> pack;
+	while (accepted_kmers_queue.Pop(pack))
 	{
+		auto& [reads_pack, accepted_kmers] = pack;
+		if (dna_block_splitter.NextPack(reads_pack.size()) && dna_block_splitter.IsEnabled())
+			kmers.Clear();
+
 		if(dataSource == DataSource::PBHiFi)
-			processReadsPackHiFi(reads_pack);
+			processReadsPackHiFi(reads_pack, accepted_kmers);
 		else
-			processReadsPack(reads_pack);
+			processReadsPack(reads_pack, accepted_kmers);
 
 		current_out_queue_elem.id = current_out_elem_id++;
 		compress_queue.Push(std::move(current_out_queue_elem));
 	}
+	kmers_extractor.join();
 
 	if(verbose)
 		kmers.PrintMemoryUsage();
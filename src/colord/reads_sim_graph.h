@@ -25,6 +25,7 @@
 #include "queues_data.h"
 #include "params.h"
 #include "ref_reads_accepter.h"
+#include "block_splitter.h"
 #include "hm.h"
 #include "hm_compact.h"
 #include "hs.h"
@@ -42,6 +43,9 @@ using kmers_to_reads_compacted_t = hash_map_lp<uint32_t, uint32_t, std::equal_to
 
 using hash_set_t = hash_set_lp<uint64_t, std::equal_to<uint64_t>, MurMur64Hash>;
 
+//for each read of a pack: the read and its k-mers accepted by the filter
+using accepted_kmers_t = std::vector<std::pair<read_t*, std::vector<kmer_type>>>;
+
 class CKmersToReads
 {
 #ifdef USE_CINT_HM
@@ -51,9 +55,36 @@ class CKmersToReads
 #endif
 	uint32_t prefix_len_bits;
 	uint64_t suffix_mask = (1ull << suffix_len_bits) - 1;
+	uint32_t hash_bits{};	//bits of the k-mer hash appended to the prefix if there are too few prefixes for the shards
+	uint32_t shard_bits{};
+	double fill_factor_kmers_to_reads;
 	std::vector<kmers_to_reads_compacted_t> hash_tables;
+
+	kmers_to_reads_compacted_t empty_hash_table() const
+	{
+#ifdef USE_CINT_HM
+		uint64_t expected_single_ht_elems = 32; //TODO: in some experiments (joi dataset) it turn out that memory requirements are lower if 16 is set, but it should be inspected 
+		return kmers_to_reads_compacted_t(static_cast<size_t>(expected_single_ht_elems / fill_factor_kmers_to_reads), fill_factor_kmers_to_reads, MurMur32Hash{});
+#else
+		uint64_t expected_single_ht_elems = 16; //TODO: in some experiments (joi dataset) it turn out that memory requirements are lower if 16 is set, but it should be inspected 
+		return kmers_to_reads_compacted_t(std::numeric_limits<uint32_t>::max(), static_cast<size_t>(expected_single_ht_elems / fill_factor_kmers_to_reads), fill_factor_kmers_to_reads, std::equal_to<uint32_t>{}, MurMur32Hash{});
+#endif
+	}
+
+	//the prefix selects the hash table, the suffix is its key
+	uint32_t table_id(kmer_type kmer) const
+	{
+		uint32_t prefix = static_cast<uint32_t>(kmer >> suffix_len_bits);
+		if (!hash_bits)
+			return prefix;
+		return (prefix << hash_bits) | static_cast<uint32_t>(MurMur64Hash{}(kmer) >> (64 - hash_bits));
+	}
 public:
-	CKmersToReads(uint32_t kmer_len, uint64_t total_kmers, double fill_factor_kmers_to_reads)
+	// K-mers are split into n_shards shards (rounded up to a power of 2), k-mers from different shards are stored in different
+	// hash tables, so each shard may be searched and updated by a different thread. Shards are given by the lowest bits of
+	// prefixes, for short k-mers the prefixes are extended with bits of the k-mer hash
+	CKmersToReads(uint32_t kmer_len, uint32_t n_shards, double fill_factor_kmers_to_reads) :
+		fill_factor_kmers_to_reads(fill_factor_kmers_to_reads)
 	{
 		uint32_t kmer_len_bits = kmer_len * 2;
 		if (kmer_len_bits > suffix_len_bits)
@@ -61,26 +92,38 @@ public:
 		else
 			prefix_len_bits = 0;
 
-		uint32_t n_hash_tables = 1ul << prefix_len_bits;
-		uint64_t expected_single_ht_elems = total_kmers / n_hash_tables;
-#ifdef USE_CINT_HM
-		expected_single_ht_elems = 32; //TODO: in some experiments (joi dataset) it turn out that memory requirements are lower if 16 is set, but it should be inspected 
-		hash_tables.assign(n_hash_tables, kmers_to_reads_compacted_t(static_cast<size_t>(expected_single_ht_elems / fill_factor_kmers_to_reads), fill_factor_kmers_to_reads, MurMur32Hash{}));
-#else
-		expected_single_ht_elems = 16; //TODO: in some experiments (joi dataset) it turn out that memory requirements are lower if 16 is set, but it should be inspected 
-		hash_tables.assign(n_hash_tables, kmers_to_reads_compacted_t(std::numeric_limits<uint32_t>::max(), static_cast<size_t>(expected_single_ht_elems / fill_factor_kmers_to_reads), fill_factor_kmers_to_reads, std::equal_to<uint32_t>{}, MurMur32Hash{}));
-#endif
+		while ((1u << shard_bits) < n_shards)
+			++shard_bits;
+		if (shard_bits > prefix_len_bits)
+			hash_bits = shard_bits - prefix_len_bits;
+
+		hash_tables.assign(1ul << (prefix_len_bits + hash_bits), empty_hash_table());
+	}
+
+	// Removes all k-mers, the memory of the hash tables is released
+	void Clear()
+	{
+		hash_tables.assign(hash_tables.size(), empty_hash_table());
+	}
+	uint32_t GetNShards() const
+	{
+		return 1u << shard_bits;
 	}
+
+	uint32_t GetShard(kmer_type kmer) const
+	{
+		return table_id(kmer) & ((1u << shard_bits) - 1);
+	}
+
 	void insert(kmer_type kmer, uint32_t val)
 	{
-		uint32_t prefix = static_cast<uint32_t>(kmer >> suffix_len_bits);
 		uint32_t suffix = static_cast<uint32_t>(kmer & suffix_mask);
-		hash_tables[prefix].insert_fast(std::make_pair(suffix, val));
+		hash_tables[table_id(kmer)].insert_fast(std::make_pair(suffix, val));
 	}
 
 	void prefetch_prefix(kmer_type kmer)
 	{
-		uint32_t prefix = static_cast<uint32_t>(kmer >> suffix_len_bits);
+		uint32_t prefix = table_id(kmer);
 
 #ifdef _WIN32
 		_mm_prefetch((const char*)(hash_tables.data() + prefix), _MM_HINT_T0);
@@ -91,7 +134,7 @@ public:
 
 	void prefetch_suffix(kmer_type kmer)
 	{
-		uint32_t prefix = static_cast<uint32_t>(kmer >> suffix_len_bits);
+		uint32_t prefix = table_id(kmer);
 		uint32_t suffix = static_cast<uint32_t>(kmer & suffix_mask);
 
 		hash_tables[prefix].prefetch(suffix);
@@ -99,7 +142,7 @@ public:
 
 	auto find(kmer_type kmer)
 	{
-		uint32_t prefix = static_cast<uint32_t>(kmer >> suffix_len_bits);
+		uint32_t prefix = table_id(kmer);
 		uint32_t suffix = static_cast<uint32_t>(kmer & suffix_mask);
 
 #ifdef USE_CINT_HM
@@ -112,7 +155,7 @@ public:
 	void PrintMemoryUsage()
 	{
 		uint32_t prefix = 0;
-		uint32_t n_prefixes = 1ul << prefix_len_bits;
+		uint32_t n_prefixes = static_cast<uint32_t>(hash_tables.size());
 		uint64_t tot_size_bytes{};
 		for (; prefix < n_prefixes; ++prefix)
 			tot_size_bytes += hash_tables[prefix].allocated_size() * sizeof(kmers_to_reads_compacted_t::value_type);
@@ -131,20 +174,44 @@ class CReadsSimilarityGraph
 	CReferenceReads& reference_reads;	
 	const CKmerFilter& filteredKmers;
 	uint32_t kmer_len;
+	uint32_t minimizer_window; //if > 1 only minimizers of reads are inserted and queried
 	uint32_t max_candidates;
 	uint32_t maxKmerCount;
 	uint32_t current_read_id{};
 
 	//kmers_to_reads_t kmers; 
 	CKmersToReads kmers;
+	//in DNA blocks mode kmers holds only reads of the current block (it is cleared at each block start), so reads of
+	//the previous blocks do not take the maxKmerCount places, k-mers of the reference genome are kept here for all blocks
+	std::unique_ptr<CKmersToReads> genome_kmers;
 
 	uint32_t current_out_elem_id{};	
 	CCompressPack current_out_queue_elem;
 
-	std::vector<std::pair<read_t*, std::vector<kmer_type>>> getAcceptedKmers(const read_pack_t& reads_pack);
+	accepted_kmers_t getAcceptedKmers(const read_pack_t& reads_pack);
+
+	static constexpr uint32_t not_in_reference = std::numeric_limits<uint32_t>::max();
+
+	struct kmer_occurrence_t
+	{
+		kmer_type kmer;
+		uint32_t read_no;	//in current pack
+		uint32_t kmer_no;	//in current pack
+	};
+
+	//buffers of the sharded search, kept between packs
+	std::vector<uint32_t> pack_ref_ids;						//id in reference set for each read of the pack (not_in_reference if not added)
+	std::vector<uint32_t> pack_first_kmer;					//number of accepted k-mers in preceding reads of the pack
+	std::vector<std::vector<std::vector<kmer_occurrence_t>>> shard_kmers;	//k-mers occurrences for each range of reads and each shard
+	std::vector<std::vector<uint32_t>> shard_hits;			//reference reads containing k-mers of each shard
+	std::vector<std::pair<uint32_t, uint32_t>> kmers_hits;	//for each k-mer of the pack: position of its hits in shard_hits and their number
 
-	void processReadsPack(const read_pack_t& reads_pack);
-	void processReadsPackHiFi(const read_pack_t& reads_pack);
+	void assignReferenceIds(const read_pack_t& reads_pack, const accepted_kmers_t& accepted_kmers);
+	void findKmersHits(const accepted_kmers_t& accepted_kmers, uint32_t n_threads);
+	uint32_t getNStageThreads(bool kmers_extraction) const;
+
+	void processReadsPack(const read_pack_t& reads_pack, accepted_kmers_t& accepted_kmers);
+	void processReadsPackHiFi(const read_pack_t& reads_pack, accepted_kmers_t& accepted_kmers);
 
 	void processReferenceGenome(CReferenceGenome* ref_genome);
 
@@ -157,6 +224,9 @@ class CReadsSimilarityGraph
 	int n_compression_threads;
 	DataSource dataSource;
 
+	CBlockSplitter dna_block_splitter;
+	uint32_t n_ref_genome_pseudo_reads{};
+
 #ifdef USE_BETTER_PARALLELIZATION_IN_GRAPH
 	std::unique_ptr<CReadsSimilarityGraphInternalThreads> internalThreads;
 #else
@@ -171,13 +241,14 @@ public:
 		CParallelQueuePopWaiting<CCompressPack>& compress_queue,
 		CReferenceReads& reference_reads,
 		CReferenceGenome* reference_genome,
-		const CKmerFilter& filteredKmers, uint32_t kmer_len, uint32_t max_candidates, uint32_t maxKmerCount,
+		const CKmerFilter& filteredKmers, uint32_t kmer_len, uint32_t minimizer_window, uint32_t max_candidates, uint32_t maxKmerCount,
 		ReferenceReadsMode referenceReadsMode,
 		CRefReadsAccepter& ref_reads_accepter,
 		double refReadsFraction,
 		int n_compression_threads,
 		DataSource dataSource,
 		double fill_factor_kmers_to_reads,
+		uint32_t dnaBlockSize,
 		bool verbose);
 
 #ifdef MEASURE_THREADS_TIMES
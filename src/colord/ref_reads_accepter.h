@@ -18,6 +18,7 @@
 ******************************************************************************/
 #pragma once
 #include "defs.h"
+#include "murmur64_hash.h"
 #include <random>
 
 class CRefReadsAccepter
@@ -29,19 +30,28 @@ class CRefReadsAccepter
 	std::uniform_real_distribution<double> dist;
 
 	uint32_t n_pseudoreads_form_reference;
+
+	// In stateless mode the decision for a read depends only on its index, so it may be taken independently in each block of reads
+	bool stateless;
+
+	double stateless_rand(uint32_t idx) const
+	{
+		return (MurMur64Hash{}(idx) >> 11) * (1.0 / (1ull << 53));
+	}
 public:
-	explicit CRefReadsAccepter(uint32_t range, double exponent, uint32_t n_pseudoreads_form_reference) :
+	explicit CRefReadsAccepter(uint32_t range, double exponent, uint32_t n_pseudoreads_form_reference, bool stateless = false) :
 		range(range),
 		exponent(exponent),
 		dist(0.0, 1.0),
-		n_pseudoreads_form_reference(n_pseudoreads_form_reference)
+		n_pseudoreads_form_reference(n_pseudoreads_form_reference),
+		stateless(stateless)
 	{
 
 	}
 
 	uint32_t GetNAccepted(uint32_t n_reads) const
 	{
-		CRefReadsAccepter cp(range, exponent, n_pseudoreads_form_reference);
+		CRefReadsAccepter cp(range, exponent, n_pseudoreads_form_reference, stateless);
 		uint32_t res{};
 		for (uint32_t i = 0; i < n_reads + n_pseudoreads_form_reference; ++i)
 			res += cp.ShouldAddToReference(i);
@@ -54,6 +64,6 @@ public:
 			return true;
 		uint32_t range_no = (idx - n_pseudoreads_form_reference) / range;
 		double accept_prob = pow(1.0 / (range_no + 1ul), exponent);
-		return dist(mt) <= accept_prob;
+		return (stateless ? stateless_rand(idx) : dist(mt)) <= accept_prob;
 	}
 };
\ No newline at end of file
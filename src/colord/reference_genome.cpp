@@ -22,6 +22,7 @@
 #include "dna_coder.h"
 #include "utils.h"
 #include "md5_wrapper.h"
+#include "../common/bgzf/bgzf.h"
 #include <cassert>
 #include <iostream>
 #include <fstream>
@@ -322,6 +323,64 @@ void CReferenceGenome::Store(const std::string& path, bool as_fastq)
 	}
 }
 
+void CReferenceGenome::StoreBam(const std::string& path)
+{
+	Timer timer;
+	timer.Start();
+	if (verbose)
+		std::cerr << "Store reference sequences as BAM records in file " << path << "...";
+	std::ofstream out(path, std::ios::binary);
+	if (!out)
+	{
+		std::cerr << "Error: cannot open file: " << path << "\n";
+		exit(1);
+	}
+
+	bgzf::CWriter writer(out);
+	std::vector<uint8_t> record;
+
+	//magic, empty SAM header text, no references
+	const uint8_t header[] = { 'B', 'A', 'M', 1, 0, 0, 0, 0, 0, 0, 0, 0 };
+	writer.Write(header, sizeof(header));
+
+	for (const auto& _seq : sequences)
+	{
+		auto seq = unpackSeq(_seq);
+		uint32_t l_seq = static_cast<uint32_t>(seq.size());
+		const uint8_t read_name[] = { '*', 0 };
+
+		record.clear();
+		StoreLittleEndian(record, static_cast<uint32_t>(32 + sizeof(read_name) + (l_seq + 1) / 2 + l_seq)); //block_size
+		StoreLittleEndian(record, static_cast<int32_t>(-1)); //refID
+		StoreLittleEndian(record, static_cast<int32_t>(-1)); //pos
+		record.push_back(sizeof(read_name)); //l_read_name
+		record.push_back(255); //mapq
+		StoreLittleEndian(record, static_cast<uint16_t>(4680)); //bin
+		StoreLittleEndian(record, static_cast<uint16_t>(0)); //n_cigar_op
+		StoreLittleEndian(record, static_cast<uint16_t>(4)); //flag: unmapped
+		StoreLittleEndian(record, l_seq);
+		StoreLittleEndian(record, static_cast<int32_t>(-1)); //next_refID
+		StoreLittleEndian(record, static_cast<int32_t>(-1)); //next_pos
+		StoreLittleEndian(record, static_cast<int32_t>(0)); //tlen
+		record.insert(record.end(), std::begin(read_name), std::end(read_name));
+
+		//4-bit codes of "=ACMGRSVTWYHKDBN"
+		const uint8_t codes[] = { 1, 2, 4, 8 };
+		for (uint32_t i = 0; i < l_seq; i += 2)
+			record.push_back((codes[seq[i]] << 4) | (i + 1 < l_seq ? codes[seq[i + 1]] : 0));
+		record.insert(record.end(), l_seq, 0xff); //no qualities
+
+		writer.Write(record.data(), record.size());
+	}
+	writer.Close();
+
+	if (verbose)
+	{
+		std::cerr << "Done.\n";
+		std::cerr << "Time: " << timer.GetTimeInSec() << "\n";
+	}
+}
+
 void CReferenceGenome::Store(CArchive& archive)
 {	
 	Timer timer;
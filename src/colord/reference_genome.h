@@ -60,6 +60,9 @@ public:
 
 	void Store(const std::string& path, bool as_fastq);
 
+	// Stores sequences as unaligned BAM records (for k-mer counting together with BAM input)
+	void StoreBam(const std::string& path);
+
 	void Store(CArchive& archive);
 
 	uint64_t GetTotSeqsLen() const
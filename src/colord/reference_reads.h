@@ -18,6 +18,7 @@
 ******************************************************************************/
 #pragma once
 #include "utils.h"
+#include "packed_read.h"
 #include <vector>
 #include <mutex>
 #include <cstring>
@@ -32,45 +33,6 @@ class CReferenceReads
 	uint8_t decompact_dir_lookup[256][4];
 	uint8_t decompact_rc_lookup[256][4];
 
-	read_t compact(const read_t& read) const
-	{
-		auto in_len = read_len(read);
-		size_t out_len = (in_len + 3) / 4 + 1; //one for number of symbols in last byte
-		read_t res(out_len);
-
-		auto full_bytes = in_len / 4; //number of fully filled bytes in output
-		uint8_t symbols_in_last_byte = in_len % 4;
-
-		uint32_t in_pos = 0;
-		for (uint32_t i = 0; i < full_bytes; ++i)
-		{
-			res[i] = read[in_pos++] << 6;
-			res[i] += read[in_pos++] << 4;
-			res[i] += read[in_pos++] << 2;
-			res[i] += read[in_pos++];
-		}
-
-		switch (symbols_in_last_byte)
-		{
-		case 3:
-			res[out_len - 2] += read[in_pos++] << 6;
-			res[out_len - 2] += read[in_pos++] << 4;
-			res[out_len - 2] += read[in_pos++] << 2;
-			break;
-		case 2:
-			res[out_len - 2] += read[in_pos++] << 6;
-			res[out_len - 2] += read[in_pos++] << 4;
-			break;
-		case 1:
-			res[out_len - 2] += read[in_pos++] << 6;
-			break;
-		}
-		assert(in_pos == in_len);
-		res[out_len - 1] = symbols_in_last_byte;
-
-		return res;
-	}
-
 	read_t decompact_dir(const read_t& read) const
 	{
 		auto symbols_in_last_byte = read.back();
@@ -226,7 +188,20 @@ public:
 
 	void Add(const read_t& ref_read)
 	{
-		ref_reads[cur_read_pos++] = compact(ref_read);
+		ref_reads[cur_read_pos++] = pack_read(ref_read);
+	}
+
+	// Stores read at given position, reads at different positions may be set concurrently
+	void Set(uint32_t id, const read_t& ref_read)
+	{
+		ref_reads[id] = pack_read(ref_read);
+	}
+
+	// Frees reads [from, to), they must not be referenced any more
+	void Release(uint32_t from, uint32_t to)
+	{
+		for (uint32_t i = from; i < to; ++i)
+			read_t().swap(ref_reads[i]);
 	}
 	read_t GetRefRead(uint32_t id) const
 	{
@@ -241,13 +216,15 @@ public:
 			return decompact_dir(ref_reads[id]);
 	}
 
-	uint32_t GetRefReadLen(uint32_t id) const
+	// The read stays packed, the view is valid until the read is released
+	packed_read_view GetPackedRefRead(uint32_t id, bool rev_comp) const
 	{
-		auto symbols_in_last_byte = ref_reads[id].back();
-		auto full_bytes = ref_reads[id].size() - 2 + !symbols_in_last_byte;
-		auto out_len = full_bytes * 4 + symbols_in_last_byte + 1;
+		return packed_read_view(ref_reads[id], rev_comp);
+	}
 
-		return static_cast<uint32_t>(out_len) - 1;
+	uint32_t GetRefReadLen(uint32_t id) const
+	{
+		return packed_read_len(ref_reads[id]);
 	}
 
 	void PrintMemoryUsage() const
@@ -275,6 +252,17 @@ public:
 	{				
 		ref_reads[cur_read_pos++] = ref_read;
 	}
+
+	void Set(uint32_t id, const read_t& ref_read)
+	{
+		ref_reads[id] = ref_read;
+	}
+
+	void Release(uint32_t from, uint32_t to)
+	{
+		for (uint32_t i = from; i < to; ++i)
+			read_t().swap(ref_reads[i]);
+	}
 	const read_t& GetRefRead(uint32_t id) const
 	{		
 		return ref_reads[id];		
@@ -93,6 +93,15 @@ public:
 
 		stats.n_non_rev_choosen += thread_stats.stats.n_non_rev_choosen;
 		stats.n_rev_choosen += thread_stats.stats.n_rev_choosen;
+
+		//effort budget
+		stats.n_effort_exceeded_reads += thread_stats.stats.n_effort_exceeded_reads;
+		stats.n_effort_skipped_candidates += thread_stats.stats.n_effort_skipped_candidates;
+		stats.n_effort_plain_symb += thread_stats.stats.n_effort_plain_symb;
+
+		//banded alignment
+		stats.n_banded_alignments += thread_stats.stats.n_banded_alignments;
+		stats.n_band_exceeded += thread_stats.stats.n_band_exceeded;
 	}
 
 	~CGlobalStatsCollector()
@@ -111,6 +120,15 @@ public:
 		summary << "# not enough uniq mmers in enc : " << stats.n_not_enough_unique_mmers_in_enc_read << "\n";
 		summary << "# too many matches             : " << stats.n_too_many_matches << "\n";
 		summary << "# too low anchors              : " << stats.n_too_low_anchors << "\n";
+
+		summary << " * * * * * * * * EFFORT BUDGET STATS * * * * * * * * \n";
+		summary << "# reads exceeding budget       : " << stats.n_effort_exceeded_reads << "\n";
+		summary << "# skipped candidates           : " << stats.n_effort_skipped_candidates << "\n";
+		summary << "# symb plain (reason: budget)  : " << stats.n_effort_plain_symb << "\n";
+
+		summary << " * * * * * * * * BANDED ALIGNMENT STATS * * * * * * * * \n";
+		summary << "# banded alignments            : " << stats.n_banded_alignments << "\n";
+		summary << "# band exceeded (full align)   : " << stats.n_band_exceeded << "\n";
 		
 		summary << " * * * * * * * * COMPRESSION STATS * * * * * * * * \n";
 		summary << "# plain reads                  : " << stats.n_plain_reads_tot << "\n";
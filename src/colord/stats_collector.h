@@ -72,6 +72,15 @@ class CStatsCollector
 
 		uint32_t n_non_rev_choosen{};
 		uint32_t n_rev_choosen{};
+
+		//effort budget
+		uint64_t n_effort_exceeded_reads{};
+		uint64_t n_effort_skipped_candidates{};
+		uint64_t n_effort_plain_symb{};
+
+		//banded alignment
+		uint64_t n_banded_alignments{};
+		uint64_t n_band_exceeded{};
 	};
 
 	StatsDetail stats;
@@ -125,5 +134,30 @@ public:
 	{
 		++stats.n_too_low_anchors;
 	}
+
+	void LogEffortExceeded()
+	{
+		++stats.n_effort_exceeded_reads;
+	}
+
+	void LogEffortSkippedCandidates(uint64_t n_candidates)
+	{
+		stats.n_effort_skipped_candidates += n_candidates;
+	}
+
+	void LogEffortPlainSymb(uint64_t n_symb)
+	{
+		stats.n_effort_plain_symb += n_symb;
+	}
+
+	void LogBandedAlignment()
+	{
+		++stats.n_banded_alignments;
+	}
+
+	void LogBandExceeded()
+	{
+		++stats.n_band_exceeded;
+	}
 	~CStatsCollector();
 };
@@ -75,6 +75,20 @@ bool isFastq(const std::string& path)
 	return c == '@';
 }
 
+bool isBam(const std::string& path)
+{
+	auto f = gzopen(path.c_str(), "rb");
+	if (!f)
+	{
+		std::cerr << "Error: cannot open file " << path << "\n";
+		exit(1);
+	}
+	char magic[4];
+	auto readed = gzread(f, magic, 4);
+	gzclose(f);
+	return readed == 4 && magic[0] == 'B' && magic[1] == 'A' && magic[2] == 'M' && magic[3] == 1;
+}
+
 bool izGzipFile(const std::string& path)
 {
 	auto in = inOpenOrDie(path, std::ios::binary);
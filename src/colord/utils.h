@@ -582,6 +582,9 @@ std::ofstream outOpenOrDie(const std::string& path, std::ios_base::openmode mode
 
 bool isFastq(const std::string& path);
 
+// BAM (unaligned or not), the reads are compressed as FASTQ
+bool isBam(const std::string& path);
+
 bool izGzipFile(const std::string& path);
 
 bool fileExists(const std::string& path);
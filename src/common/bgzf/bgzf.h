@@ -0,0 +1,330 @@
+/*******************************************************************************
+ 
+ CoLoRd 
+ Copyright (C) 2021, M. Kokot, S. Deorowicz, and A. Gudys
+ https://github.com/refresh-bio/CoLoRd
+
+ This program is free software: you can redistribute it and/or modify it under 
+ the terms of the GNU General Public License as published by the Free Software 
+ Foundation; either version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY 
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR 
+ A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License along with this 
+ program. If not, see https://www.gnu.org/licenses/.
+
+******************************************************************************/
+#pragma once
+
+#include "zlib.h"
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <iostream>
+#include <ostream>
+#include <algorithm>
+#include <iterator>
+
+// BGZF (blocked gzip) support shared by CoLoRd and its k-mer counter: block header parsing, parallel inflating and writing.
+// The code is kept in C++11, because the k-mer counter is compiled with it.
+namespace bgzf
+{
+	enum class HeaderStatus { ok, incomplete, invalid };
+
+	inline uint32_t load_uint16(const uint8_t* p)
+	{
+		return (uint32_t)p[0] | ((uint32_t)p[1] << 8);
+	}
+
+	inline uint32_t load_uint32(const uint8_t* p)
+	{
+		return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+	}
+
+	inline void store_uint16(uint8_t* p, uint32_t x)
+	{
+		p[0] = x & 0xff;
+		p[1] = (x >> 8) & 0xff;
+	}
+
+	inline void store_uint32(uint8_t* p, uint32_t x)
+	{
+		for (int i = 0; i < 4; ++i)
+			p[i] = (x >> (8 * i)) & 0xff;
+	}
+
+	// Checks if data start with BGZF block header (gzip header with BC extra subfield), on success block_size is set to the total size of the block
+	inline HeaderStatus ReadBlockHeader(const uint8_t* data, size_t size, uint32_t& block_size)
+	{
+		if (size < 12)
+			return HeaderStatus::incomplete;
+		if (data[0] != 0x1f || data[1] != 0x8b || data[2] != 8 || !(data[3] & 4)) //FLG.FEXTRA must be set
+			return HeaderStatus::invalid;
+		uint32_t xlen = load_uint16(data + 10);
+		if (size < 12 + xlen)
+			return HeaderStatus::incomplete;
+
+		for (uint32_t pos = 12; pos + 4 <= 12 + xlen; )
+		{
+			uint32_t slen = load_uint16(data + pos + 2);
+			if (data[pos] == 'B' && data[pos + 1] == 'C' && slen == 2 && pos + 6 <= 12 + xlen)
+			{
+				block_size = load_uint16(data + pos + 4) + 1; //BSIZE is the total block size minus one
+				return block_size < 12 + xlen + 8 ? HeaderStatus::invalid : HeaderStatus::ok;
+			}
+			pos += 4 + slen;
+		}
+		return HeaderStatus::invalid;
+	}
+
+	inline bool IsBgzf(const uint8_t* data, size_t size)
+	{
+		uint32_t block_size;
+		return ReadBlockHeader(data, size, block_size) == HeaderStatus::ok;
+	}
+
+	// Inflates batches of BGZF blocks, the blocks are independent, so they are inflated in parallel by the calling thread and n_threads - 1 workers.
+	// The workers live as long as the inflater and wait for the next batch between the calls.
+	class CInflater
+	{
+		struct block_t
+		{
+			size_t in_pos;
+			size_t out_pos;
+			uint32_t in_size;
+			uint32_t out_size;
+		};
+
+		std::vector<block_t> blocks;
+		const uint8_t* in_data = nullptr;
+		uint8_t* out_data = nullptr;
+		std::atomic<size_t> next_block{ 0 };
+
+		std::vector<std::thread> workers;
+		std::mutex mtx;
+		std::condition_variable cv_start, cv_done;
+		uint64_t batch_no = 0;
+		uint32_t n_busy = 0;
+		bool finished = false;
+
+		void inflate_blocks(z_stream& stream)
+		{
+			size_t i;
+			while ((i = next_block.fetch_add(1)) < blocks.size())
+			{
+				const block_t& b = blocks[i];
+				if (!b.out_size)
+					continue;
+				const uint8_t* block = in_data + b.in_pos;
+				uint32_t header_size = 12 + load_uint16(block + 10);
+
+				inflateReset(&stream);
+				stream.next_in = const_cast<uint8_t*>(block + header_size);
+				stream.avail_in = b.in_size - header_size - 8;
+				stream.next_out = out_data + b.out_pos;
+				stream.avail_out = b.out_size;
+
+				if (inflate(&stream, Z_FINISH) != Z_STREAM_END || stream.avail_out ||
+					crc32(0L, out_data + b.out_pos, b.out_size) != load_uint32(block + b.in_size - 8))
+				{
+					std::cerr << "Error: corrupted BGZF block\n";
+					exit(1);
+				}
+			}
+		}
+
+		static void init_stream(z_stream& stream)
+		{
+			stream.zalloc = Z_NULL;
+			stream.zfree = Z_NULL;
+			stream.opaque = Z_NULL;
+			stream.avail_in = 0;
+			stream.next_in = Z_NULL;
+			if (inflateInit2(&stream, -15) != Z_OK)
+			{
+				std::cerr << "Error: cannot initialize zlib\n";
+				exit(1);
+			}
+		}
+
+		void worker()
+		{
+			z_stream stream;
+			init_stream(stream);
+			uint64_t seen_batch_no = 0;
+			while (true)
+			{
+				{
+					std::unique_lock<std::mutex> lck(mtx);
+					cv_start.wait(lck, [&] { return finished || batch_no != seen_batch_no; });
+					if (finished)
+						break;
+					seen_batch_no = batch_no;
+				}
+				inflate_blocks(stream);
+				std::lock_guard<std::mutex> lck(mtx);
+				if (--n_busy == 0)
+					cv_done.notify_one();
+			}
+			inflateEnd(&stream);
+		}
+
+		z_stream own_stream;
+
+	public:
+		explicit CInflater(uint32_t n_threads)
+		{
+			init_stream(own_stream);
+			for (uint32_t i = 1; i < n_threads; ++i)
+				workers.push_back(std::thread(&CInflater::worker, this));
+		}
+
+		CInflater(const CInflater&) = delete;
+		CInflater& operator=(const CInflater&) = delete;
+
+		~CInflater()
+		{
+			{
+				std::lock_guard<std::mutex> lck(mtx);
+				finished = true;
+			}
+			cv_start.notify_all();
+			for (auto& th : workers)
+				th.join();
+			inflateEnd(&own_stream);
+		}
+
+		uint32_t NThreads() const
+		{
+			return static_cast<uint32_t>(workers.size() + 1);
+		}
+
+		// Inflates complete blocks from the beginning of data (at least one block if there is any, then as long as the output does not exceed max_out_size)
+		// The output is appended to out, the number of consumed bytes is returned (0 if there is no complete block)
+		size_t Inflate(const uint8_t* data, size_t size, std::vector<uint8_t>& out, size_t max_out_size)
+		{
+			blocks.clear();
+			size_t in_pos = 0;
+			size_t out_pos = out.size();
+			uint32_t block_size;
+			while (in_pos < size)
+			{
+				HeaderStatus status = ReadBlockHeader(data + in_pos, size - in_pos, block_size);
+				if (status == HeaderStatus::invalid)
+				{
+					std::cerr << "Error: wrong BGZF block header\n";
+					exit(1);
+				}
+				if (status == HeaderStatus::incomplete || in_pos + block_size > size)
+					break;
+				uint32_t out_size = load_uint32(data + in_pos + block_size - 4);
+				if (!blocks.empty() && out_pos + out_size - out.size() > max_out_size)
+					break;
+				blocks.push_back(block_t{ in_pos, out_pos, block_size, out_size });
+				in_pos += block_size;
+				out_pos += out_size;
+			}
+			if (blocks.empty())
+				return 0;
+
+			out.resize(out_pos);
+			in_data = data;
+			out_data = out.data();
+			next_block = 0;
+
+			bool use_workers = !workers.empty() && blocks.size() > 1;
+			if (use_workers)
+			{
+				{
+					std::lock_guard<std::mutex> lck(mtx);
+					n_busy = static_cast<uint32_t>(workers.size());
+					++batch_no;
+				}
+				cv_start.notify_all();
+			}
+			inflate_blocks(own_stream);
+			if (use_workers)
+			{
+				std::unique_lock<std::mutex> lck(mtx);
+				cv_done.wait(lck, [&] { return n_busy == 0; });
+			}
+
+			return in_pos;
+		}
+	};
+
+	// Writes data as BGZF blocks to a stream
+	class CWriter
+	{
+		static const size_t max_block_data = 0xff00;
+		std::ostream& out;
+		std::vector<uint8_t> data;
+		std::vector<uint8_t> block;
+
+		void write_block(const uint8_t* in, size_t size)
+		{
+			const uint32_t header_size = 18, footer_size = 8;
+			block.resize(header_size + compressBound((uLong)size) + 16 + footer_size);
+
+			z_stream stream;
+			//stored (level 0) block always fits if compressed data do not
+			for (int level : { 1, 0 })
+			{
+				stream.zalloc = Z_NULL;
+				stream.zfree = Z_NULL;
+				stream.opaque = Z_NULL;
+				if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+				{
+					std::cerr << "Error: cannot initialize zlib\n";
+					exit(1);
+				}
+				stream.next_in = const_cast<uint8_t*>(in);
+				stream.avail_in = (uInt)size;
+				stream.next_out = block.data() + header_size;
+				stream.avail_out = (uInt)(block.size() - header_size - footer_size);
+				int res = deflate(&stream, Z_FINISH);
+				deflateEnd(&stream);
+				if (res == Z_STREAM_END && header_size + stream.total_out + footer_size <= 0x10000)
+					break;
+			}
+
+			uint32_t block_size = header_size + (uint32_t)stream.total_out + footer_size;
+			const uint8_t header[] = { 0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0 };
+			std::copy(std::begin(header), std::end(header), block.begin());
+			store_uint16(block.data() + 16, block_size - 1);
+			store_uint32(block.data() + block_size - 8, (uint32_t)crc32(0L, in, (uInt)size));
+			store_uint32(block.data() + block_size - 4, (uint32_t)size);
+			out.write(reinterpret_cast<const char*>(block.data()), block_size);
+		}
+
+	public:
+		explicit CWriter(std::ostream& out) : out(out)
+		{
+		}
+
+		void Write(const uint8_t* in, size_t size)
+		{
+			data.insert(data.end(), in, in + size);
+			size_t pos = 0;
+			for (; data.size() - pos >= max_block_data; pos += max_block_data)
+				write_block(data.data() + pos, max_block_data);
+			data.erase(data.begin(), data.begin() + pos);
+		}
+
+		// Writes the rest of data and the end-of-file marker (empty block)
+		void Close()
+		{
+			if (data.size())
+				write_block(data.data(), data.size());
+			data.clear();
+			write_block(nullptr, 0);
+		}
+	};
+}
@@ -18,6 +18,68 @@ Date   : 2019-05-19
 #include "bam_utils.h"
 #include <sys/stat.h>
 
+// Standard input given as the input file "-". It can be read only once, but stage 0 (signatures statistics) reads
+// the beginning of the input before stage 1, so the data read in stage 0 are kept and read again in stage 1.
+// The beginning of the input may have been read already by the caller (to recognize the format), it is read first
+class CStdinInput
+{
+	vector<uchar> head;	// data read from the standard input and not yet read again
+	uint64 head_pos = 0;
+	bool keep = false;
+public:
+	explicit CStdinInput(vector<uchar>&& _head) : head(std::move(_head))
+	{
+	}
+
+	static CompressionType GetCompressionType(const uchar* data, uint64 size)
+	{
+		if (size >= 2 && data[0] == 0x1f && data[1] == 0x8b)
+			return CompressionType::gzip;
+		else if (size >= 3 && data[0] == 'B' && data[1] == 'Z' && data[2] == 'h')
+			return CompressionType::bzip2;
+		else
+			return CompressionType::plain;
+	}
+
+	CompressionType GetCompressionType() const
+	{
+		return GetCompressionType(head.data(), head.size());
+	}
+
+	// Starts reading from the beginning of the input, if _keep is set the data read from the standard input are kept to be read again
+	void Rewind(bool _keep)
+	{
+		head_pos = 0;
+		keep = _keep;
+	}
+
+	uint64 Read(uchar* buff, uint64 size)
+	{
+		uint64 readed = MIN(size, head.size() - head_pos);
+		if (readed)
+		{
+			memcpy(buff, head.data() + head_pos, readed);
+			head_pos += readed;
+			if (!keep && head_pos == head.size()) //no longer needed
+			{
+				vector<uchar>().swap(head);
+				head_pos = 0;
+			}
+		}
+		if (readed < size)
+		{
+			uint64 from_stdin = fread(buff + readed, 1, size - readed, stdin);
+			if (keep)
+			{
+				head.insert(head.end(), buff + readed, buff + readed + from_stdin);
+				head_pos += from_stdin;
+			}
+			readed += from_stdin;
+		}
+		return readed;
+	}
+};
+
 class CBinaryFilesReader
 {
 	bool is_file(const char* path)
@@ -39,6 +101,8 @@ class CBinaryFilesReader
 	CMemoryPool *pmm_binary_file_reader;
 	vector<CBinaryPackQueue*> binary_pack_queues;
 	CBamTaskManager* bam_task_manager = nullptr;
+	CStdinInput* stdin_input = nullptr;
+	bool keep_stdin;
 	uint64 total_size;
 	uint64 predicted_size;	
 	CPercentProgress percent_progress;
@@ -61,6 +125,13 @@ class CBinaryFilesReader
 
 	void OpenFile(const string& file_name, FILE* &f, CompressionType& mode)
 	{
+		if (file_name == "-")
+		{
+			f = stdin;
+			mode = stdin_input->GetCompressionType();
+			stdin_input->Rewind(keep_stdin);
+			return;
+		}
 		f = fopen(file_name.c_str(), "rb");
 		if (!f)
 		{
@@ -74,6 +145,19 @@ class CBinaryFilesReader
 		mode = get_compression_type(file_name);
 	}
 
+	uint64 ReadFile(FILE* f, uchar* buff, uint64 size)
+	{
+		if (f == stdin)
+			return stdin_input->Read(buff, size);
+		return fread(buff, 1, size, f);
+	}
+
+	void CloseFile(FILE* f)
+	{
+		if (f != stdin)
+			fclose(f);
+	}
+
 	uint64_t skipSingleBGZFBlock(uchar* buff)
 	{
 		uint64_t pos = 0;
@@ -220,8 +304,9 @@ class CBinaryFilesReader
 	}
 
 public:
-	CBinaryFilesReader(CKMCParams &Params, CKMCQueues &Queues, bool _show_progress)
+	CBinaryFilesReader(CKMCParams &Params, CKMCQueues &Queues, bool _show_progress, bool _keep_stdin)
 		:
+		keep_stdin(_keep_stdin),
 		percent_progress("Stage 1: ", _show_progress)
 	{
 		part_size = (uint32)Params.mem_part_pmm_binary_file_reader;
@@ -229,6 +314,7 @@ public:
 		pmm_binary_file_reader = Queues.pmm_binary_file_reader;
 		binary_pack_queues = Queues.binary_pack_queues;		
 		bam_task_manager = Queues.bam_task_manager;
+		stdin_input = Queues.stdin_input;
 		auto files_copy = input_files_queue->GetCopy();		
 		total_size = 0;
 		predicted_size = 0;
@@ -237,6 +323,16 @@ public:
 		while (!files_copy.empty())
 		{
 			string& f_name = files_copy.front();
+			if (f_name == "-") //size of the standard input is unknown
+			{
+				if (bam_input)
+				{
+					cerr << "Error: BAM input cannot be read from the standard input\n";
+					exit(1);
+				}
+				files_copy.pop();
+				continue;
+			}
 			FILE* f = fopen(f_name.c_str(), "rb");
 			if(!is_file(f_name.c_str()))
 			{
@@ -309,12 +405,12 @@ public:
 			OpenFile(file_name, f, mode);
 			files.push_back(make_tuple(f, q, mode));
 			pmm_binary_file_reader->reserve(part);
-			uint64 readed = fread(part, 1, part_size, f);
+			uint64 readed = ReadFile(f, part, part_size);
 			notify_readed(readed);
 			if (!q->push(part, readed, FilePart::Begin, mode))
 			{
 				pmm_binary_file_reader->free(part);
-				fclose(f);
+				CloseFile(f);
 				get<0>(files.back()) = nullptr;
 				++completed;
 			}
@@ -330,7 +426,7 @@ public:
 					continue;
 
 				pmm_binary_file_reader->reserve(part);				
-				uint64 readed = fread(part, 1, part_size, get<0>(f));				
+				uint64 readed = ReadFile(get<0>(f), part, part_size);				
 				notify_readed(readed);
 				if (readed == 0) //end of file, need to open next one if exists
 				{
@@ -340,13 +436,13 @@ public:
 						forced_to_finish = true;
 						break;
 					}
-					fclose(get<0>(f));
+					CloseFile(get<0>(f));
 
 					if (input_files_queue->pop(file_name))
 					{
 						OpenFile(file_name, get<0>(f), get<2>(f));
 						pmm_binary_file_reader->reserve(part);
-						readed = fread(part, 1, part_size, get<0>(f));
+						readed = ReadFile(get<0>(f), part, part_size);
 						notify_readed(readed);
 						if (!get<1>(f)->push(part, readed, FilePart::Begin, get<2>(f)))
 						{
@@ -378,7 +474,7 @@ public:
 		{
 			if (get<0>(f))
 			{
-				fclose(get<0>(f));
+				CloseFile(get<0>(f));
 				get<0>(f) = nullptr;
 			}
 		}
@@ -394,9 +490,9 @@ class CWBinaryFilesReader
 {
 	CBinaryFilesReader *reader;
 public:
-	CWBinaryFilesReader(CKMCParams &Params, CKMCQueues &Queues, bool show_progress = true)
+	CWBinaryFilesReader(CKMCParams &Params, CKMCQueues &Queues, bool show_progress = true, bool keep_stdin = false)
 	{
-		reader = new CBinaryFilesReader(Params, Queues, show_progress);
+		reader = new CBinaryFilesReader(Params, Queues, show_progress, keep_stdin);
 	}
 
 	uint64 GetPredictedSize()
@@ -919,6 +919,19 @@ void CFastqReaderDataSrc::init_stream()
 		}
 		stream.avail_in = (uint32)in_data_size;
 		stream.next_in = in_data;
+
+		bgzf = bgzf::IsBgzf(in_data, in_data_size);
+		if (bgzf)
+		{
+			if (!bgzf_inflater)
+				bgzf_inflater.reset(new bgzf::CInflater(n_bgzf_threads));
+			bgzf_in.assign(in_data, in_data + in_data_size);
+			bgzf_in_pos = 0;
+			bgzf_out.clear();
+			bgzf_out_pos = 0;
+			pmm_binary_file_reader->free(in_data);
+			in_data = nullptr;
+		}
 		break;
 	case CompressionType::bzip2:
 		_bz_stram.bzalloc = nullptr;
@@ -952,8 +965,66 @@ bool CFastqReaderDataSrc::Finished()
 	return end_reached;
 }
 
+//----------------------------------------------------------------------------------
+// Reading of BGZF file, the blocks are inflated in batches of about the requested size
+uint64 CFastqReaderDataSrc::read_bgzf(uchar* buff, uint64 size, bool& last_in_file)
+{
+	uint64 out_pos = 0;
+	while (out_pos < size)
+	{
+		if (bgzf_out_pos == bgzf_out.size())
+		{
+			bgzf_out.clear();
+			bgzf_out_pos = 0;
+			uint64 consumed = bgzf_inflater->Inflate(bgzf_in.data() + bgzf_in_pos, bgzf_in.size() - bgzf_in_pos, bgzf_out, size - out_pos);
+			bgzf_in_pos += consumed;
+			if (consumed)
+				continue;
+
+			//more compressed data needed
+			bgzf_in.erase(bgzf_in.begin(), bgzf_in.begin() + bgzf_in_pos);
+			bgzf_in_pos = 0;
+			//may be false even if file_part != FilePart::End in stats mode
+			auto pop_res = binary_pack_queue->pop(in_data, in_data_size, file_part, compression_type);
+			if (!pop_res || file_part == FilePart::End)
+			{
+				if (pop_res && bgzf_in.size())
+				{
+					cerr << "Some error while reading gzip file\n";
+					exit(1);
+				}
+				in_data = nullptr;
+				bgzf_in.clear();
+				inflateEnd(&stream);
+				in_progress = false;
+				bgzf = false;
+				last_in_file = true;
+				break;
+			}
+			bgzf_in.insert(bgzf_in.end(), in_data, in_data + in_data_size);
+			pmm_binary_file_reader->free(in_data);
+			in_data = nullptr;
+			continue;
+		}
+		uint64 n_copy = MIN(size - out_pos, bgzf_out.size() - bgzf_out_pos);
+		memcpy(buff + out_pos, bgzf_out.data() + bgzf_out_pos, n_copy);
+		bgzf_out_pos += n_copy;
+		out_pos += n_copy;
+	}
+	return out_pos;
+}
+
 //----------------------------------------------------------------------------------
 uint64 CFastqReaderDataSrc::read(uchar* buff, uint64 size, bool& last_in_file)
+{
+	uint64 readed = read_data(buff, size, last_in_file);
+	if (input_observer && (readed || last_in_file))
+		input_observer(buff, readed, last_in_file);
+	return readed;
+}
+
+//----------------------------------------------------------------------------------
+uint64 CFastqReaderDataSrc::read_data(uchar* buff, uint64 size, bool& last_in_file)
 {
 	last_in_file = false;
 	if (!in_progress)
@@ -968,7 +1039,9 @@ uint64 CFastqReaderDataSrc::read(uchar* buff, uint64 size, bool& last_in_file)
 	}
 
 	//reading
-	if (compression_type == CompressionType::gzip)
+	if (compression_type == CompressionType::gzip && bgzf)
+		return read_bgzf(buff, size, last_in_file);
+	else if (compression_type == CompressionType::gzip)
 	{
 		stream.next_out = buff;
 		stream.avail_out = (uint32)size;
@@ -1185,6 +1258,8 @@ CWFastqReader::CWFastqReader(CKMCParams &Params, CKMCQueues &Queues, CBinaryPack
 	part_queue = Queues.part_queue;
 	file_type = Params.file_type;
 	kmer_len = Params.p_k;
+	n_bgzf_threads = Params.n_bgzf_threads;
+	input_observer = Params.p_input_observer;
 
 
 	fqr = nullptr;
@@ -1203,6 +1278,8 @@ void CWFastqReader::operator()()
 
 	fqr = new CFastqReader(mm, pmm_fastq, file_type, kmer_len, binary_pack_queue, pmm_binary_file_reader, bam_task_manager, part_queue, nullptr, missingEOL_at_EOF_counter);
 	fqr->SetPartSize(part_size);
+	fqr->SetBgzfThreads(n_bgzf_threads);
+	fqr->SetInputObserver(input_observer);
 	if (file_type == bam)
 	{
 		fqr->ProcessBam();
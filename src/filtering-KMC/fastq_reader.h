@@ -18,6 +18,8 @@
 
 #include "zlib.h"
 #include "libs/bzlib.h"
+#include "../common/bgzf/bgzf.h"
+#include <memory>
 
 using namespace std;
 
@@ -38,9 +40,31 @@ class CFastqReaderDataSrc
 	uchar* in_data;
 	uint64 in_data_size;
 	uint64 in_data_pos; //for plain
+
+	//BGZF is detected in gzip files, its blocks are inflated in parallel, the inflater (and its threads) is created with the first BGZF file
+	bool bgzf = false;
+	uint32 n_bgzf_threads = 1;
+	std::unique_ptr<bgzf::CInflater> bgzf_inflater;
+	std::vector<uchar> bgzf_in; //not yet inflated data, the last block may be incomplete
+	uint64 bgzf_in_pos = 0;
+	std::vector<uchar> bgzf_out;
+	uint64 bgzf_out_pos = 0;
+
+	std::function<void(const uchar*, uint64, bool)> input_observer;
+
 	void init_stream();
+	uint64 read_bgzf(uchar* buff, uint64 size, bool& last_in_file);
+	uint64 read_data(uchar* buff, uint64 size, bool& last_in_file);
 public:
 	inline void SetQueue(CBinaryPackQueue* _binary_pack_queue, CMemoryPool *_pmm_binary_file_reader);
+	void SetBgzfThreads(uint32 n_threads)
+	{
+		n_bgzf_threads = MAX(1u, n_threads);
+	}
+	void SetInputObserver(const std::function<void(const uchar*, uint64, bool)>& _input_observer)
+	{
+		input_observer = _input_observer;
+	}
 	inline bool Finished();
 	uint64 read(uchar* buff, uint64 size, bool& last_in_file);
 	void IgnoreRest()
@@ -147,6 +171,16 @@ public:
 		data_src.IgnoreRest();
 	}
 
+	void SetBgzfThreads(uint32 n_threads)
+	{
+		data_src.SetBgzfThreads(n_threads);
+	}
+
+	void SetInputObserver(const std::function<void(const uchar*, uint64, bool)>& input_observer)
+	{
+		data_src.SetInputObserver(input_observer);
+	}
+
 };
 
 //************************************************************************************************************
@@ -166,6 +200,8 @@ class CWFastqReader {
 
 	input_type file_type;	
 	int kmer_len;
+	uint32 n_bgzf_threads;
+	std::function<void(const uchar*, uint64, bool)> input_observer;
 
 	CMissingEOL_at_EOF_counter* missingEOL_at_EOF_counter;
 
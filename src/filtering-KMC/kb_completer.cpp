@@ -47,7 +47,8 @@ CKmerBinCompleter::CKmerBinCompleter(CKMCParams &Params, CKMCQueues &Queues)
 	counter_max    = (uint32)Params.counter_max;
 	lut_prefix_len = Params.lut_prefix_len;
 	both_strands   = Params.both_strands;
-	without_output = Params.without_output;
+	kmers_observer = Params.p_kmers_observer;
+	without_output = Params.without_output || kmers_observer; //k-mers passed to the observer are not stored
 
 	kmer_t_size    = Params.KMER_T_size;
 		
@@ -154,6 +155,13 @@ void CKmerBinCompleter::ProcessBinsFirstStage()
 			}
 		}
 
+		if (kmers_observer)
+		{
+			for (auto& e : data_packs)
+				pass_to_observer(bin_id, data + e.first, e.second - e.first, nullptr, 0, false);
+			pass_to_observer(bin_id, nullptr, 0, lut, lut_size, true);
+		}
+
 		memory_bins->free(bin_id, CMemoryBins::mba_suffix);
 
 		if (!without_output)
@@ -201,6 +209,8 @@ void CKmerBinCompleter::ProcessBinsSecondStage()
 		bool last_in_bin = false;
 		while (bbkpq->pop(bin_id, data, data_size, lut, lut_size, _n_unique, _n_cutoff_min, _n_cutoff_max, _n_total, last_in_bin))
 		{
+			if (kmers_observer)
+				pass_to_observer(bin_id, data, data_size, lut, lut_size, last_in_bin);
 			if (data_size)
 			{
 				if(!without_output)
@@ -305,6 +315,22 @@ bool CKmerBinCompleter::store_uint(FILE *out, uint64 x, uint32 size)
 	return true;
 }
 
+//----------------------------------------------------------------------------------
+// Pass a part of a bin to the observer, lut contains the numbers of records for prefixes (lut_size is in bytes)
+void CKmerBinCompleter::pass_to_observer(int32 bin_id, const uchar* records, uint64 records_size, const uchar* lut, uint64 lut_size, bool end_of_bin)
+{
+	CFilteredKmersPack pack;
+	pack.binId = bin_id;
+	pack.lutPrefixLen = lut_prefix_len;
+	pack.counterSize = (uint32)counter_size;
+	pack.records = records;
+	pack.recordsSize = records_size;
+	pack.lut = (const uint64_t*)lut;
+	pack.lutSize = lut_size / sizeof(uint64);
+	pack.endOfBin = end_of_bin;
+	kmers_observer(pack);
+}
+
 //----------------------------------------------------------------------------------
 //Init memory pools for 2nd stage
 void CKmerBinCompleter::InitStage2(CKMCParams& /*Params*/, CKMCQueues& Queues)
@@ -55,7 +55,9 @@ class CKmerBinCompleter {
 	int32 signature_len;	
 	bool both_strands;
 	bool without_output;
+	std::function<void(const CFilteredKmersPack&)> kmers_observer;
 	bool store_uint(FILE *out, uint64 x, uint32 size);	
+	void pass_to_observer(int32 bin_id, const uchar* records, uint64 records_size, const uchar* lut, uint64 lut_size, bool end_of_bin);
 
 public:
 	CKmerBinCompleter(CKMCParams &Params, CKMCQueues &Queues);
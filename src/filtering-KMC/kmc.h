@@ -113,6 +113,7 @@ template <unsigned SIZE> CKMC<SIZE>::CKMC()
 	initialized   = false;
 	Params.kmer_len      = 0;
 	Params.n_readers     = 1;
+	Params.n_bgzf_threads = 1;
 	Params.n_splitters   = 1;
 	Params.n_sorters     = 1;	
 	Queues.s_mapper = nullptr;
@@ -121,6 +122,7 @@ template <unsigned SIZE> CKMC<SIZE>::CKMC()
 //----------------------------------------------------------------------------------
 template <unsigned SIZE> CKMC<SIZE>::~CKMC()
 {
+	delete Queues.stdin_input;
 }
 
 //----------------------------------------------------------------------------------
@@ -195,10 +197,19 @@ template <unsigned SIZE> void CKMC<SIZE>::SetThreads1Stage()
 	{
 		int cores = Params.n_threads;
 		bool gz_bz2 = false;
+		bool bgzf_input = false;
 		vector<uint64> file_sizes;
 		
 		for (auto& p : Params.input_file_names)
 		{
+			if (p == "-") //standard input is recognized by its beginning
+			{
+				const auto& head = Params.p_stdin_head;
+				gz_bz2 |= CStdinInput::GetCompressionType(head.data(), head.size()) != CompressionType::plain;
+				bgzf_input |= bgzf::IsBgzf(head.data(), head.size());
+				file_sizes.push_back(head.size());
+				continue;
+			}
 			if (p.size() > 3 && string(p.end() - 3, p.end()) == ".gz")
 				gz_bz2 = true;
 			else if (p.size() > 4 && string(p.end() - 4, p.end()) == ".bz2")
@@ -210,6 +221,8 @@ template <unsigned SIZE> void CKMC<SIZE>::SetThreads1Stage()
 				cerr << "Error: cannot open file: " << p.c_str();
 				exit(1);
 			}
+			uchar header[64];
+			bgzf_input |= bgzf::IsBgzf(header, fread(header, 1, sizeof(header), tmp));
 			my_fseek(tmp, 0, SEEK_END);
 			file_sizes.push_back(my_ftell(tmp));
 			fclose(tmp);
@@ -223,6 +236,9 @@ template <unsigned SIZE> void CKMC<SIZE>::SetThreads1Stage()
 			if (p > file_size_threshold)
 				++n_allowed_files;
 			Params.n_readers = MIN(n_allowed_files, MAX(1, cores / 2));
+			//BGZF blocks are inflated in parallel, splitters would otherwise wait for the readers
+			if (bgzf_input)
+				Params.n_bgzf_threads = MAX(1, cores / (2 * Params.n_readers));
 		}
 		else if (Params.file_type == bam)
 		{
@@ -230,8 +246,12 @@ template <unsigned SIZE> void CKMC<SIZE>::SetThreads1Stage()
 		}
 		else
 			Params.n_readers = 1;
-		Params.n_splitters = MAX(1, cores - Params.n_readers);
+		//each reader inflates BGZF blocks with n_bgzf_threads threads (including itself)
+		Params.n_splitters = MAX(1, cores - Params.n_readers * Params.n_bgzf_threads);
 	}
+	//input observer must see the input in order
+	if (Params.p_input_observer && Params.file_type != bam)
+		Params.n_readers = 1;
 }
 //----------------------------------------------------------------------------------
 template<unsigned SIZE> void CKMC<SIZE>::SetThreads2Stage()
@@ -799,6 +819,9 @@ template <unsigned SIZE> bool CKMC<SIZE>::Process()
 
 	CHashModuloFilter moduloFilter(Params.modulo);
 
+	if (find(Params.input_file_names.begin(), Params.input_file_names.end(), "-") != Params.input_file_names.end())
+		Queues.stdin_input = new CStdinInput(std::move(Params.p_stdin_head));
+
 	was_small_k_opt = false;
 	if (AdjustMemoryLimitsSmallK())
 	{
@@ -861,7 +884,8 @@ template <unsigned SIZE> bool CKMC<SIZE>::Process()
 	{
 		Queues.bam_task_manager = new CBamTaskManager;
 	}
-	w_bin_file_reader = new CWBinaryFilesReader(Params, Queues, false);
+	//stage 0 reads only the beginning of the input, the standard input is kept to be read again in stage 1
+	w_bin_file_reader = new CWBinaryFilesReader(Params, Queues, false, true);
 	Queues.stats_part_queue = new CStatsPartQueue(Params.n_readers, MAX(STATS_FASTQ_SIZE, w_bin_file_reader->GetPredictedSize() / 100));
 
 	Queues.s_mapper = new CSignatureMapper(Queues.pmm_stats, Params.signature_len, Params.n_bins		
@@ -395,7 +395,8 @@ bool parse_parameters(int argc, char *argv[])
 				Params.input_file_names.push_back(s);
 
 		in.close();
-		random_shuffle(Params.input_file_names.begin(), Params.input_file_names.end());
+		if (!Params.p_input_observer) //the observer must get the files in the given order
+			random_shuffle(Params.input_file_names.begin(), Params.input_file_names.end());
 	}
 
 	if (Params.p_t > Params.p_m * 64)
@@ -425,7 +426,7 @@ bool parse_parameters(int argc, char *argv[])
 	}
 
 	//Check if output files may be created and if it is possible to create file in specified tmp location
-	if(!Params.p_without_output)
+	if(!Params.p_without_output && !Params.p_kmers_observer)
 	{
 		string pre_file_name = Params.output_file_name + ".kmc_pre";
 		string suff_file_name = Params.output_file_name + ".kmc_suf";
@@ -581,12 +582,20 @@ int run_filtering_kmc(const CFilteringParams& params)
 
 	regOpt("-t" + std::to_string(params.nThreads));
 
+	if (params.maxRamGB)
+	{
+		regOpt("-m" + std::to_string(params.maxRamGB));
+		regOpt("-sm");
+	}
+
 	regOpt("-f" + std::to_string(params.modulo));
 
 	regOpt("-j" + params.statsFile);
 
 
-	if (params.is_fasta)
+	if (params.is_bam)
+		regOpt("-fbam");
+	else if (params.is_fasta)
 		regOpt("-fm");
 
 	regOpt(params.inputPath);
@@ -597,6 +606,10 @@ int run_filtering_kmc(const CFilteringParams& params)
 
 	optsToArgvs();
 
+	Params.p_input_observer = params.inputObserver;
+	Params.p_kmers_observer = params.kmersObserver;
+	Params.p_stdin_head = params.stdinHead;
+
 	return old_main(argv.size(), argv.data());
 }
 
@@ -14,13 +14,17 @@
 #include "defs.h"
 #include "queues.h"
 #include "s_mapper.h"
+#include "filtering_kmc.h"
 #include <vector>
 #include <string>
+#include <functional>
 
 typedef enum {fasta, fastq, multiline_fasta, bam} input_type;
 
 using namespace std;
 
+class CStdinInput;
+
 // Structure for passing KMC parameters
 struct CKMCParams {
 	
@@ -40,6 +44,9 @@ struct CKMCParams {
 	input_type p_file_type;				// input in FASTA format
 	bool p_verbose;						// verbose mode
 	bool p_without_output = false;		// do not create output files 
+	std::function<void(const uchar*, uint64, bool)> p_input_observer; // receives the whole (decompressed) input in order, a single FASTQ reader is used then
+	std::function<void(const CFilteredKmersPack&)> p_kmers_observer; // receives filtered k-mers instead of the output files
+	vector<uchar> p_stdin_head;			// beginning of the standard input (input file "-") already read by the caller
 #ifdef DEVELOP_MODE
 	bool p_verbose_log = false;         // verbose log
 #endif
@@ -109,6 +116,7 @@ struct CKMCParams {
 
 	int n_threads;			// number of cores
 	int n_readers;			// number of FASTQ readers; default: 1
+	int n_bgzf_threads;		// number of threads inflating BGZF blocks per FASTQ reader; default: 1
 	int n_splitters;		// number of splitters; default: 1
 	int n_sorters;			// number of sorters; default: 1
 	vector<int> n_sorting_threads;// number of OMP threads per sorters
@@ -207,6 +215,8 @@ struct CKMCQueues
 	
 	CCompletedBinsCollector* sm_cbc;
 	CSortersManager* sorters_manager = nullptr;
+
+	CStdinInput* stdin_input = nullptr; // if one of the input files is "-", kept between the stages
 };
 
 #endif
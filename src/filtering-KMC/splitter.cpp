@@ -90,6 +90,89 @@ bool CSplitter::GetSeqLongRead(char *seq, uint32 &seq_size, uchar header_marker)
 
 
 
+//----------------------------------------------------------------------------------
+// Return a single record (or its fragment) from BAM data, records longer than the reads buffer are returned
+// in several overlapping fragments (as long reads in FASTA/FASTQ)
+bool CSplitter::GetSeqBam(char *seq, uint32 &seq_size)
+{
+	//"=ACMGRSVTWYHKDBN"
+	static const char maping[] = { -1, 0, 1, -1, 2, -1, -1, -1, 3, -1, -1, -1, -1, -1, -1, -1 };
+	static const char rev_maping[] = { -1, 3, 2, -1, 1, -1, -1, -1, 0, -1, -1, -1, -1, -1, -1, -1 };
+
+	while (!bam_rec_end)
+	{
+		if (part_pos >= part_size)
+			return false;
+
+		int32_t block_size;
+		read_int32_t(block_size, part, part_pos);
+
+		uint64_t start_pos = part_pos;
+
+		part_pos += 8;
+
+		uint32_t bin_mq_nl;
+		read_uint32_t(bin_mq_nl, part, part_pos);
+
+		uint32_t l_read_name = (bin_mq_nl & ((1 << 8) - 1));
+		uint32_t flag_nc;
+		read_uint32_t(flag_nc, part, part_pos);
+		uint32_t n_cigar_op = flag_nc & ((1ul << 16) - 1);
+		int32_t l_seq;
+		read_int32_t(l_seq, part, part_pos);
+
+		part_pos += 12;
+
+		uint32_t flags = flag_nc >> 16;
+
+		bool exclude_read = ((flags >> 8) & 1) || ((flags >> 11) & 1); //TODO: I think that is the way samtools filter out some reads (secondary and supplementary)
+
+		part_pos += l_read_name; // skip read name
+
+		part_pos += 4 * n_cigar_op;
+
+		if (exclude_read)
+		{
+			part_pos = start_pos + block_size;
+			continue;
+		}
+
+		++n_reads;
+		bam_rec_end = start_pos + block_size;
+		bam_seq_start = part_pos;
+		bam_l_seq = l_seq;
+		bam_seq_done = 0;
+		//if read is reversed and kmc was run to count all (not only canonical) kmers read must be transformed back
+		bam_rev_comp = !both_strands && ((flags >> 4) & 1);
+	}
+
+	uint32 n_symbols = (uint32)MIN((uint64)(bam_l_seq - bam_seq_done), (uint64)mem_part_pmm_reads);
+	const uchar* packed = part + bam_seq_start;
+	if (bam_rev_comp)
+		for (uint32 i = 0; i < n_symbols; ++i)
+		{
+			uint32 in_pos = bam_l_seq - 1 - (bam_seq_done + i);
+			seq[i] = rev_maping[(in_pos & 1) ? (packed[in_pos / 2] & 15) : (packed[in_pos / 2] >> 4)];
+		}
+	else
+		for (uint32 i = 0; i < n_symbols; ++i)
+		{
+			uint32 in_pos = bam_seq_done + i;
+			seq[i] = maping[(in_pos & 1) ? (packed[in_pos / 2] & 15) : (packed[in_pos / 2] >> 4)];
+		}
+	seq_size = n_symbols;
+
+	if (bam_seq_done + n_symbols == bam_l_seq)
+	{
+		part_pos = bam_rec_end;
+		bam_rec_end = 0;
+	}
+	else
+		bam_seq_done += n_symbols - (kmer_len - 1); //need to copy last k-1 kmers
+
+	return true;
+}
+
 //----------------------------------------------------------------------------------
 // Return a single record from FASTA/FASTQ data
 bool CSplitter::GetSeq(char *seq, uint32 &seq_size, ReadType read_type)
@@ -325,99 +408,7 @@ bool CSplitter::GetSeq(char *seq, uint32 &seq_size, ReadType read_type)
 
 	}
 	else if (file_type == bam)
-	{
-		while (true)
-		{
-			if (part_pos >= part_size)
-				return false;
-
-			int32_t block_size;
-			read_int32_t(block_size, part, part_pos);
-
-			uint64_t start_pos = part_pos;
-
-			part_pos += 8;
-
-			uint32_t bin_mq_nl;
-			read_uint32_t(bin_mq_nl, part, part_pos);
-
-			uint32_t l_read_name = (bin_mq_nl & ((1 << 8) - 1));
-			uint32_t flag_nc;
-			read_uint32_t(flag_nc, part, part_pos);
-			uint32_t n_cigar_op = flag_nc & ((1ul << 16) - 1);
-			int32_t l_seq;
-			read_int32_t(l_seq, part, part_pos);
-
-			part_pos += 12;
-
-			uint32_t flags = flag_nc >> 16;
-
-			bool exclude_read = ((flags >> 8) & 1) || ((flags >> 11) & 1); //TODO: I think that is the way samtools filter out some reads (secondary and supplementary)
-
-			part_pos += l_read_name; // skip read name
-
-			part_pos += 4 * n_cigar_op;
-			if (!exclude_read)
-			{
-				bool is_rev_comp = (flags >> 4) & 1;
-
-				if (!both_strands && is_rev_comp) //if read is reversed and kmc was run to count all (not only canonical) kmers read must be transformed back
-				{
-					//static const char rev_maping[] = "=TGMCRSVAWYHKDBN";
-					static const char rev_maping[] = { -1, 3, 2, -1, 1, -1, -1, -1, 0, -1, -1, -1, -1, -1, -1, -1 };// "=TGMCRSVAWYHKDBN";
-					uint32 n_bytes = l_seq / 2;
-					uint64_t pos_after = pos + l_seq;
-					pos = pos_after;
-					for (uint32_t ii = 0; ii < n_bytes; ++ii)
-					{
-						unsigned char byte = part[part_pos++];
-						seq[--pos_after] = rev_maping[byte >> 4];
-						seq[--pos_after] = rev_maping[byte & 15];
-					}
-
-					if (l_seq & 1) //odd
-					{
-						unsigned char byte = part[part_pos++];
-						seq[--pos_after] = rev_maping[byte >> 4];
-					}
-				}
-				else
-				{
-					static const char maping[] = { -1, 0, 1, -1, 2, -1, -1, -1, 3, -1, -1, -1, -1, -1, -1, -1 };//"=ACMGRSVTWYHKDBN";
-					uint32 n_bytes = l_seq / 2;
-					for (uint32_t ii = 0; ii < n_bytes; ++ii)
-					{
-						unsigned char byte = part[part_pos++];
-						seq[pos++] = maping[byte >> 4];
-						seq[pos++] = maping[byte & 15];
-					}
-
-					if (l_seq & 1) //odd
-					{
-						unsigned char byte = part[part_pos++];
-						seq[pos++] = maping[byte >> 4];
-					}
-				}
-				seq_size = pos;
-			}
-			else
-			{
-				part_pos += (l_seq + 1) / 2;
-			}
-
-			//move to next record
-			uint64_t readed = part_pos - start_pos;
-			uint64_t remaining = block_size - readed;
-			part_pos += remaining;
-
-			if (!exclude_read) //if readed successfuly return		
-			{
-				++n_reads;
-				return true;
-			}
-		}
-
-	}
+		return GetSeqBam(seq, seq_size);
 	return (c == '\n' || c == '\r');
 }
 
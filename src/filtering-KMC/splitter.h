@@ -53,11 +53,19 @@ class CSplitter {
 	uint32 n_bins;	
 	uint64 n_reads;//for multifasta its a sequences counter	
 
+	//state of the BAM record being currently returned in fragments (bam_rec_end == 0 if none)
+	uint64_t bam_rec_end = 0;
+	uint64_t bam_seq_start = 0;
+	uint32_t bam_l_seq = 0;
+	uint32_t bam_seq_done = 0;
+	bool bam_rev_comp = false;
+
 	CSignatureMapper* s_mapper;
 
 	bool homopolymer_compressed;
 
 	bool GetSeqLongRead(char *seq, uint32 &seq_size, uchar header_marker);
+	bool GetSeqBam(char *seq, uint32 &seq_size);
 
 	bool GetSeq(char *seq, uint32 &seq_size, ReadType read_type);
 